@@ -18,6 +18,7 @@ static std::string g_type;
 static std::string g_config;
 static std::string g_token;
 static std::string g_operation;
+static std::string g_path;
 static unsigned    g_provider_id;
 static std::string g_log_level = "info";
 
@@ -51,6 +52,18 @@ int main(int argc, char** argv) {
             admin.destroyPhonebook(g_address, g_provider_id,
                 yp::UUID::from_string(g_phonebook.c_str()), g_token);
             spdlog::info("Destroyed phonebook {}", g_phonebook);
+        } else if(g_operation == "snapshot") {
+            admin.snapshotPhonebook(g_address, g_provider_id,
+                yp::UUID::from_string(g_phonebook.c_str()), g_path, g_token);
+            spdlog::info("Wrote phonebook {} to {}", g_phonebook, g_path);
+        } else if(g_operation == "restore") {
+            admin.restorePhonebook(g_address, g_provider_id,
+                yp::UUID::from_string(g_phonebook.c_str()), g_path, g_token);
+            spdlog::info("Restored phonebook {} from {}", g_phonebook, g_path);
+        } else if(g_operation == "checkpoint") {
+            admin.checkpointPhonebook(g_address, g_provider_id,
+                yp::UUID::from_string(g_phonebook.c_str()), g_path, g_token);
+            spdlog::info("Checkpointed phonebook {} in {}", g_phonebook, g_path);
         }
 
         // Any of the above functions may throw a yp::Exception
@@ -71,8 +84,9 @@ void parse_command_line(int argc, char** argv) {
         TCLAP::ValueArg<std::string> typeArg("t","type","Phonebook type", false,"dummy","string");
         TCLAP::ValueArg<std::string> phonebookArg("r","phonebook","Phonebook id", false, yp::UUID().to_string(),"string");
         TCLAP::ValueArg<std::string> configArg("c","config","Phonebook configuration", false,"","string");
+        TCLAP::ValueArg<std::string> pathArg("f","file","Snapshot file or checkpoint directory on the server", false,"","string");
         TCLAP::ValueArg<std::string> logLevel("v","verbose", "Log level (trace, debug, info, warning, error, critical, off)", false, "info", "string");
-        std::vector<std::string> options = { "create", "open", "close", "destroy" };
+        std::vector<std::string> options = { "create", "open", "close", "destroy", "snapshot", "restore", "checkpoint" };
         TCLAP::ValuesConstraint<std::string> allowedOptions(options);
         TCLAP::ValueArg<std::string> operationArg("x","exec","Operation to execute",true,"create",&allowedOptions);
         cmd.add(addressArg);
@@ -81,6 +95,7 @@ void parse_command_line(int argc, char** argv) {
         cmd.add(tokenArg);
         cmd.add(configArg);
         cmd.add(phonebookArg);
+        cmd.add(pathArg);
         cmd.add(logLevel);
         cmd.add(operationArg);
         cmd.parse(argc, argv);
@@ -90,6 +105,7 @@ void parse_command_line(int argc, char** argv) {
         g_config = configArg.getValue();
         g_type = typeArg.getValue();
         g_phonebook = phonebookArg.getValue();
+        g_path = pathArg.getValue();
         g_operation = operationArg.getValue();
         g_log_level = logLevel.getValue();
         g_protocol = g_address.substr(0, g_address.find(":"));
@@ -4,10 +4,16 @@
  * See COPYRIGHT in top-level directory.
  */
 #include <yp/Provider.hpp>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include <spdlog/spdlog.h>
 #include <tclap/CmdLine.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace tl = thallium;
 namespace snt = yp;
@@ -17,23 +23,121 @@ static unsigned    g_num_providers = 1;
 static int         g_num_threads = 0;
 static std::string g_log_level = "info";
 static bool        g_use_progress_thread = false;
+static bool        g_pin = false;
+static int         g_numa_node = -1;
+static bool        g_work_stealing = false;
 
 static void parse_command_line(int argc, char** argv);
+static std::vector<int> cpus_of_node(int node);
+static bool set_preferred_node(int node);
 
 int main(int argc, char** argv) {
     parse_command_line(argc, argv);
     spdlog::set_level(spdlog::level::from_str(g_log_level));
     tl::engine engine(g_address, THALLIUM_SERVER_MODE, g_use_progress_thread, g_num_threads);
     engine.enable_remote_shutdown();
+    // the providers are declared last so that they are destroyed before
+    // the pools and execution streams that run their handlers
+    std::vector<tl::managed<tl::pool>> pools;
+    std::vector<tl::managed<tl::xstream>> xstreams;
     std::vector<snt::Provider> providers;
-    for(unsigned i=0 ; i < g_num_providers; i++) {
-        providers.emplace_back(engine, i);
+    if(!g_pin) {
+        for(unsigned i=0 ; i < g_num_providers; i++) {
+            providers.emplace_back(engine, i);
+        }
+    } else {
+        // one pool and one execution stream per provider, each pinned to
+        // a core of the NUMA node (or of the whole machine if none given)
+        auto cpus = cpus_of_node(g_numa_node);
+        if(cpus.empty()) {
+            spdlog::critical("No CPU found for NUMA node {}", g_numa_node);
+            return -1;
+        }
+        if(cpus.size() < g_num_providers)
+            spdlog::warn("{} providers will share {} cores", g_num_providers, cpus.size());
+        for(unsigned i=0 ; i < g_num_providers; i++) {
+            pools.push_back(tl::pool::create(tl::pool::access::mpmc));
+        }
+        // execution streams inherit the memory policy of the thread that
+        // creates them, so that the phonebooks, which are allocated by the
+        // handlers, end up on the node's memory
+        if(g_numa_node >= 0 && !set_preferred_node(g_numa_node))
+            spdlog::warn("Could not allocate memory on NUMA node {}", g_numa_node);
+        for(unsigned i=0 ; i < g_num_providers; i++) {
+            // with work stealing, an idle execution stream also runs the
+            // work of its neighbours, after its own
+            std::vector<tl::pool> scheduled = { *pools[i] };
+            if(g_work_stealing && g_num_providers > 1) {
+                scheduled.push_back(*pools[(i + 1) % g_num_providers]);
+                if(g_num_providers > 2)
+                    scheduled.push_back(*pools[(i + g_num_providers - 1) % g_num_providers]);
+            }
+            xstreams.push_back(tl::xstream::create(tl::scheduler::predef::basic_wait,
+                                                   scheduled.begin(), scheduled.end()));
+            int cpu = cpus[i % cpus.size()];
+            if(ABT_xstream_set_cpubind(xstreams.back()->native_handle(), cpu) != ABT_SUCCESS)
+                spdlog::warn("Could not pin the execution stream of provider {} to core {}", i, cpu);
+            else
+                spdlog::debug("Provider {} runs on core {}", i, cpu);
+        }
+        if(g_numa_node >= 0) set_preferred_node(-1);
+        for(unsigned i=0 ; i < g_num_providers; i++) {
+            providers.emplace_back(engine, i, "", *pools[i]);
+        }
     }
     spdlog::info("Server running at address {}", (std::string)engine.self());
     engine.wait_for_finalize();
+    // destroying a provider waits for the handlers still running in its
+    // pool, which needs the pool's execution stream
+    providers.clear();
+    for(auto& xstream : xstreams) {
+        xstream->join();
+    }
     return 0;
 }
 
+/**
+ * Returns the CPUs of a NUMA node, or those the process may run on
+ * if node is negative.
+ */
+std::vector<int> cpus_of_node(int node) {
+    std::vector<int> cpus;
+    if(node < 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if(sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if(CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        return cpus;
+    }
+    // e.g. "0-15,32-47"
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string range;
+    while(std::getline(file, range, ',')) {
+        int first, last;
+        char dash;
+        std::istringstream ss(range);
+        if(!(ss >> first)) continue;
+        last = (ss >> dash >> last) ? last : first;
+        for(int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+/**
+ * Makes the calling thread allocate memory on a NUMA node, falling back
+ * to other nodes if it is full, or restores the default policy if node
+ * is negative.
+ */
+bool set_preferred_node(int node) {
+    if(node < 0)
+        return syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0) == 0;
+    constexpr int bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node / bits + 1);
+    mask[node / bits] = 1UL << (node % bits);
+    return syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * bits) == 0;
+}
+
 void parse_command_line(int argc, char** argv) {
     try {
         TCLAP::CmdLine cmd("Spawns a Yp daemon", ' ', "0.1");
@@ -42,16 +146,23 @@ void parse_command_line(int argc, char** argv) {
         TCLAP::SwitchArg progressThreadArg("p","use-progress-thread","Use a Mercury progress thread", cmd, false);
         TCLAP::ValueArg<int> numThreads("t","num-threads", "Number of threads for RPC handlers", false, 0, "int");
         TCLAP::ValueArg<std::string> logLevel("v","verbose", "Log level (trace, debug, info, warning, error, critical, off)", false, "info", "string");
+        TCLAP::SwitchArg pinArg("P","pin","Give each provider its own execution stream, pinned to a core", cmd, false);
+        TCLAP::ValueArg<int> numaNodeArg("N","numa-node", "NUMA node whose cores and memory pinned providers use (implies -P)", false, -1, "int");
+        TCLAP::SwitchArg workStealingArg("w","work-stealing","Let pinned execution streams run the work of their neighbours", cmd, false);
         cmd.add(addressArg);
         cmd.add(providersArg);
         cmd.add(numThreads);
         cmd.add(logLevel);
+        cmd.add(numaNodeArg);
         cmd.parse(argc, argv);
         g_address = addressArg.getValue();
         g_num_providers = providersArg.getValue();
         g_num_threads = numThreads.getValue();
         g_use_progress_thread = progressThreadArg.getValue();
         g_log_level = logLevel.getValue();
+        g_numa_node = numaNodeArg.getValue();
+        g_pin = pinArg.getValue() || g_numa_node >= 0;
+        g_work_stealing = workStealingArg.getValue();
     } catch(TCLAP::ArgException &e) {
         std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
         exit(-1);
@@ -191,6 +191,70 @@ class Admin {
                          const UUID& phonebook_id,
                          const std::string& token="") const;
 
+    /**
+     * @brief Writes the content of a phonebook into a snapshot file
+     * on the server. The snapshot uses a versioned, checksummed binary
+     * format that the provider writes in parallel.
+     *
+     * @param address Address of the target provider.
+     * @param provider_id Provider id.
+     * @param phonebook_id UUID of the phonebook to snapshot.
+     * @param path Path of the snapshot file on the server.
+     */
+    void snapshotPhonebook(const std::string& address,
+                           uint16_t provider_id,
+                           const UUID& phonebook_id,
+                           const std::string& path,
+                           const std::string& token="") const;
+
+    /**
+     * @brief Replaces the content of a phonebook with the content
+     * of a snapshot file, or of a checkpoint directory, on the server.
+     * The phonebook is left unchanged if the snapshot cannot be read entirely.
+     *
+     * @param address Address of the target provider.
+     * @param provider_id Provider id.
+     * @param phonebook_id UUID of the phonebook to restore.
+     * @param path Path of the snapshot file or checkpoint directory on the server.
+     */
+    void restorePhonebook(const std::string& address,
+                          uint16_t provider_id,
+                          const UUID& phonebook_id,
+                          const std::string& path,
+                          const std::string& token="") const;
+
+    /**
+     * @brief Writes an incremental checkpoint of a phonebook into a
+     * directory on the server. Only the parts of the phonebook modified
+     * since the previous checkpoint in that directory are written, and
+     * the backend periodically consolidates the chain into a full snapshot.
+     * The directory can be passed to restorePhonebook.
+     *
+     * @param address Address of the target provider.
+     * @param provider_id Provider id.
+     * @param phonebook_id UUID of the phonebook to checkpoint.
+     * @param directory Checkpoint directory on the server.
+     */
+    void checkpointPhonebook(const std::string& address,
+                             uint16_t provider_id,
+                             const UUID& phonebook_id,
+                             const std::string& directory,
+                             const std::string& token="") const;
+
+    /**
+     * @brief Returns the load of the target provider as a JSON-formatted
+     * string (see Provider::getLoad), e.g. to decide which providers to
+     * move to which pools.
+     *
+     * @param address Address of the target provider.
+     * @param provider_id Provider id.
+     *
+     * @return JSON formatted string.
+     */
+    std::string getProviderLoad(const std::string& address,
+                                uint16_t provider_id,
+                                const std::string& token="") const;
+
     /**
      * @brief Shuts down the target server. The Thallium engine
      * used by the server must have remote shutdown enabled.
@@ -7,9 +7,18 @@
 #define __YP_BACKEND_HPP
 
 #include <yp/RequestResult.hpp>
+#include <yp/LookupBuffer.hpp>
+#include <yp/BloomFilter.hpp>
+#include <yp/IoEngine.hpp>
+#include <yp/BlockCache.hpp>
+#include <yp/Scan.hpp>
 #include <unordered_set>
 #include <unordered_map>
 #include <functional>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include <thallium.hpp>
 
@@ -38,7 +47,10 @@ class Backend {
     template<typename BackendType>
     friend class ::__YpBackendRegistration;
 
-    std::string m_name;
+    std::string                 m_name;
+    std::shared_ptr<IoEngine>   m_io_engine;
+    std::shared_ptr<BlockCache> m_block_cache;
+    BlockCache::Owner           m_block_cache_owner;
 
     public:
 
@@ -68,9 +80,9 @@ class Backend {
     Backend& operator=(const Backend&) = default;
 
     /**
-     * @brief Destructor.
+     * @brief Destructor. Drops the blocks of the backend from the block cache.
      */
-    virtual ~Backend() = default;
+    virtual ~Backend();
 
     /**
      * @brief Return the name of backend.
@@ -79,6 +91,54 @@ class Backend {
         return m_name;
     }
 
+    /**
+     * @brief Returns the I/O engine through which the backend should
+     * read and write its files, so that a handler waiting for the disk
+     * suspends only its own ULT instead of its whole execution stream.
+     * The engine is owned by the provider and shared by its phonebooks;
+     * until the provider sets it (i.e. in the backend's constructor),
+     * or if the backend is used without a provider, a process-wide
+     * blocking engine is returned.
+     */
+    IoEngine& ioEngine() const {
+        return m_io_engine ? *m_io_engine : IoEngine::blocking();
+    }
+
+    /**
+     * @brief Sets the I/O engine returned by ioEngine(). Called by the
+     * provider right after creating or opening the backend.
+     */
+    void setIoEngine(std::shared_ptr<IoEngine> engine) {
+        m_io_engine = std::move(engine);
+    }
+
+    /**
+     * @brief Returns the cache in which disk-backed backends should keep
+     * the blocks they read, rather than keeping their own caches. It is
+     * owned by the provider and shared by its phonebooks under a single
+     * memory budget. Blocks must be inserted and looked up on behalf of
+     * blockCacheOwner(), which the cache charges them to. Until the
+     * provider sets it, or if the backend is used without a provider,
+     * a disabled cache is returned.
+     */
+    BlockCache& blockCache() const {
+        return m_block_cache ? *m_block_cache : BlockCache::disabled();
+    }
+
+    /**
+     * @brief Returns the handle under which the backend uses the block cache.
+     */
+    const BlockCache::Owner& blockCacheOwner() const {
+        return m_block_cache_owner;
+    }
+
+    /**
+     * @brief Sets the cache returned by blockCache() and registers the
+     * backend as one of its owners. Called by the provider right after
+     * creating or opening the backend.
+     */
+    void setBlockCache(std::shared_ptr<BlockCache> cache);
+
     /**
      * @brief Returns a JSON-formatted configuration string.
      */
@@ -99,6 +159,228 @@ class Backend {
      */
     virtual RequestResult<int32_t> computeSum(int32_t x, int32_t y) = 0;
 
+    /**
+     * @brief Computes out[i] = x[i] + y[i] for n pairs of integers.
+     * Sums that overflow wrap around, and bit i % 64 of overflow[i / 64]
+     * is set for each sum i that overflowed. The default implementation
+     * uses the widest SIMD kernel supported by the CPU (AVX-512, AVX2)
+     * and falls back to a scalar loop.
+     *
+     * @param x first integers
+     * @param y second integers
+     * @param out sums (n integers)
+     * @param overflow overflow bitmap ((n + 63) / 64 words)
+     * @param n number of pairs
+     *
+     * @return a RequestResult<bool> indicating success.
+     */
+    virtual RequestResult<bool> computeSumMany(const int32_t* x,
+                                               const int32_t* y,
+                                               int32_t* out,
+                                               uint64_t* overflow,
+                                               size_t n);
+
+    /**
+     * @brief Inserts a name/number pair in the phonebook.
+     * If the name is already present, its number is replaced.
+     *
+     * @param name Name to insert.
+     * @param number Phone number associated with the name.
+     *
+     * @return a RequestResult<bool> indicating success.
+     */
+    virtual RequestResult<bool> insert(const std::string& name,
+                                       const std::string& number) = 0;
+
+    /**
+     * @brief Same as above, with name and number given as views, which
+     * are only valid until the call returns. The provider calls this
+     * overload with views into the RPC's input buffer; backends that
+     * can work without owning the strings should override it. The
+     * default implementation copies them and calls the overload above.
+     */
+    virtual RequestResult<bool> insert(std::string_view name,
+                                       std::string_view number);
+
+    /**
+     * @brief Looks up the number associated with a name.
+     *
+     * @param name Name to look up.
+     *
+     * @return a RequestResult containing the number.
+     */
+    virtual RequestResult<std::string> lookup(const std::string& name) = 0;
+
+    /**
+     * @brief Same as above, with the name given as a view (see insert).
+     */
+    virtual RequestResult<std::string> lookup(std::string_view name);
+
+    /**
+     * @brief Erases a name from the phonebook.
+     *
+     * @param name Name to erase.
+     *
+     * @return a RequestResult<bool> indicating success.
+     */
+    virtual RequestResult<bool> erase(const std::string& name) = 0;
+
+    /**
+     * @brief Same as above, with the name given as a view (see insert).
+     */
+    virtual RequestResult<bool> erase(std::string_view name);
+
+    /**
+     * @brief Overloads for string literals, which would otherwise
+     * be ambiguous between the std::string and view overloads.
+     */
+    RequestResult<bool> insert(const char* name, const char* number) {
+        return insert(std::string_view(name), std::string_view(number));
+    }
+
+    RequestResult<std::string> lookup(const char* name) {
+        return lookup(std::string_view(name));
+    }
+
+    RequestResult<bool> erase(const char* name) {
+        return erase(std::string_view(name));
+    }
+
+    /**
+     * @brief Looks up the numbers associated with each of the names.
+     * A name that is not found is not an error: its result has
+     * Status::NotFound. The default implementation calls lookup
+     * for each name.
+     *
+     * @param names Names to look up.
+     *
+     * @return a RequestResult containing a result per name.
+     */
+    virtual RequestResult<LookupBuffer> lookupMulti(const std::vector<std::string_view>& names);
+
+    /**
+     * @brief Searches for the entries whose name contains the pattern,
+     * allowing up to max_edit_distance insertions, deletions or
+     * substitutions, ignoring ASCII case. Entries with the fewest edits
+     * come first. The default implementation reports that search is not
+     * supported.
+     *
+     * @param pattern Pattern to look for.
+     * @param max_edit_distance Maximum number of edits.
+     * @param limit Maximum number of results (0 for no limit).
+     *
+     * @return a RequestResult containing name/number pairs.
+     */
+    virtual RequestResult<std::vector<std::pair<std::string, std::string>>>
+        search(const std::string& pattern, uint32_t max_edit_distance, size_t limit);
+
+    /**
+     * @brief Finds the names associated with a number. The default
+     * implementation relies on reverseLookupMulti.
+     *
+     * @param number Number to look up.
+     *
+     * @return a RequestResult containing the names, or an error
+     * if no name is associated with the number.
+     */
+    virtual RequestResult<std::vector<std::string>> reverseLookup(const std::string& number);
+
+    /**
+     * @brief Finds the names associated with each of the numbers.
+     * The default implementation reports that reverse lookups are
+     * not supported.
+     *
+     * @param numbers Numbers to look up.
+     *
+     * @return a RequestResult containing, for each number, the
+     * (possibly empty) list of names associated with it.
+     */
+    virtual RequestResult<std::vector<std::vector<std::string>>>
+        reverseLookupMulti(const std::vector<std::string>& numbers);
+
+    /**
+     * @brief Evaluates a scan query on the entries of the phonebook.
+     * The default implementation reports that scans are not supported.
+     *
+     * @param query Filter and aggregation to evaluate.
+     * @param pool Pool in which the backend may spread the work.
+     *
+     * @return a RequestResult containing the reduced result.
+     */
+    virtual RequestResult<ScanResult> scan(const ScanQuery& query,
+                                           const thallium::pool& pool);
+
+    /**
+     * @brief Returns the changes to the Bloom filter over the names of
+     * the phonebook since the given epoch and version, which clients
+     * cache to answer lookups of missing names without an RPC. Names
+     * must be added to the filter before the insert returns. The default
+     * implementation reports that filters are not supported.
+     *
+     * @param epoch Epoch of the client's copy of the filter.
+     * @param version Version of the client's copy of the filter.
+     *
+     * @return a RequestResult containing the update.
+     */
+    virtual RequestResult<FilterUpdate> getFilter(uint64_t epoch, uint64_t version);
+
+    /**
+     * @brief Returns the number of bytes of memory used by the phonebook,
+     * against which the provider enforces memory quotas. It is called
+     * from the write path (at most once per refresh interval of the
+     * quotas), so it should be cheap. The default implementation returns
+     * 0, i.e. the phonebook is never over its quota.
+     */
+    virtual size_t residentBytes();
+
+    /**
+     * @brief Returns statistics about the phonebook (e.g. number of
+     * entries and memory used per entry) as a JSON-formatted string.
+     * The default implementation returns an empty object.
+     */
+    virtual std::string getStats();
+
+    /**
+     * @brief Writes the content of the phonebook into a snapshot file.
+     * The default implementation reports that snapshots are not supported.
+     *
+     * @param path Path of the snapshot file on the server.
+     * @param pool Pool in which the backend may spread the work.
+     *
+     * @return a RequestResult<bool> indicating success.
+     */
+    virtual RequestResult<bool> snapshot(const std::string& path,
+                                         const thallium::pool& pool);
+
+    /**
+     * @brief Replaces the content of the phonebook with the content
+     * of a snapshot file, or of a checkpoint directory written by
+     * checkpoint(). The default implementation reports that snapshots
+     * are not supported.
+     *
+     * @param path Path of the snapshot file or checkpoint directory on the server.
+     * @param pool Pool in which the backend may spread the work.
+     *
+     * @return a RequestResult<bool> indicating success.
+     */
+    virtual RequestResult<bool> restore(const std::string& path,
+                                        const thallium::pool& pool);
+
+    /**
+     * @brief Writes an incremental checkpoint of the phonebook into a
+     * checkpoint directory: only the parts of the phonebook modified since
+     * the previous checkpoint in that directory are written, chained to the
+     * last full snapshot by a manifest. The default implementation reports
+     * that checkpoints are not supported.
+     *
+     * @param directory Checkpoint directory on the server.
+     * @param pool Pool in which the backend may spread the work.
+     *
+     * @return a RequestResult<bool> indicating success.
+     */
+    virtual RequestResult<bool> checkpoint(const std::string& directory,
+                                           const thallium::pool& pool);
+
     /**
      * @brief Destroys the underlying phonebook.
      *
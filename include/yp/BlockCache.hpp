@@ -0,0 +1,124 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_BLOCK_CACHE_HPP
+#define __YP_BLOCK_CACHE_HPP
+
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace yp {
+
+class BlockCacheImpl;
+class BlockCacheOwner;
+
+/**
+ * @brief Usage of the block cache by one owner (phonebook).
+ */
+struct BlockCacheStats {
+    size_t   bytes  = 0;
+    size_t   blocks = 0;
+    uint64_t hits   = 0;
+    uint64_t misses = 0;
+};
+
+/**
+ * @brief Cache of immutable file blocks, shared by all the phonebooks of
+ * a provider under a single byte budget. Blocks are identified by a file
+ * id, obtained from newFileId(), and an offset. The cache is split into
+ * shards, selected by hashing the key, each with its own mutex and its
+ * own share of the budget, and each evicting its least recently used
+ * blocks regardless of the phonebook that owns them: the blocks that
+ * stay resident are the hottest ones of the whole provider. Each block
+ * is charged to the owner that inserted it, so that the usage and hit
+ * rate of every phonebook can be reported.
+ *
+ * The cache is owned by the provider, and backends reach it through
+ * Backend::blockCache().
+ */
+class BlockCache {
+
+    public:
+
+    using Block = std::shared_ptr<const std::string>;
+    using Owner = std::shared_ptr<BlockCacheOwner>;
+
+    /**
+     * @brief Constructor. A capacity of 0 disables the cache.
+     *
+     * @param capacity Budget in bytes, counting the blocks' data.
+     * @param num_shards Number of shards.
+     */
+    explicit BlockCache(size_t capacity, unsigned num_shards = 16);
+
+    ~BlockCache();
+
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    /**
+     * @brief Registers an owner and returns a handle to it.
+     */
+    Owner addOwner();
+
+    /**
+     * @brief Drops the blocks of an owner and resets its statistics.
+     */
+    void removeOwner(const Owner& owner);
+
+    /**
+     * @brief Returns a new file id, never returned before.
+     */
+    uint64_t newFileId();
+
+    /**
+     * @brief Returns the block at the given offset of a file, or null
+     * if it is not cached, counting a hit or a miss for the owner.
+     * The owner may be null if the cache is disabled.
+     */
+    Block find(const Owner& owner, uint64_t file, uint64_t offset);
+
+    /**
+     * @brief Inserts a block, charging it to the owner and evicting the
+     * least recently used blocks of the shard if needed. Blocks larger
+     * than the budget of a shard are not cached.
+     */
+    void insert(const Owner& owner, uint64_t file, uint64_t offset, Block block);
+
+    /**
+     * @brief Drops all the blocks of a file (e.g. a deleted file).
+     */
+    void forgetFile(uint64_t file);
+
+    /**
+     * @brief Usage of an owner.
+     */
+    BlockCacheStats stats(const Owner& owner) const;
+
+    /**
+     * @brief Usage of the cache as a whole.
+     */
+    BlockCacheStats totals() const;
+
+    size_t capacity() const;
+
+    unsigned numShards() const;
+
+    /**
+     * @brief Process-wide cache with a capacity of 0, used by the
+     * backends that are not managed by a provider.
+     */
+    static BlockCache& disabled();
+
+    private:
+
+    std::shared_ptr<BlockCacheImpl> self;
+};
+
+}
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_BLOOM_FILTER_HPP
+#define __YP_BLOOM_FILTER_HPP
+
+#include <yp/Exception.hpp>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+
+namespace yp {
+
+/**
+ * @brief Changes to a BloomFilter since a given version, as sent by
+ * a provider to the clients that cache the filter of a phonebook.
+ * The epoch identifies one filter of one backend instance: it is
+ * drawn at random when the backend is created or loaded and whenever
+ * the filter is rebuilt, so that epochs are never reused. When the
+ * client's epoch is not the current one, the whole filter is sent. Otherwise only the blocks modified since
+ * the client's version are sent (none if the filter did not change).
+ */
+struct FilterUpdate {
+
+    uint64_t              epoch      = 0;
+    uint64_t              version    = 0;
+    uint64_t              num_blocks = 0;
+    bool                  full       = false;
+    std::vector<uint32_t> blocks; // indices of the modified blocks, unless full
+    std::vector<uint64_t> words;  // content of these blocks, or of the whole filter
+
+    template<typename Archive>
+    void save(Archive& a) const {
+        a & epoch;
+        a & version;
+        a & num_blocks;
+        a & full;
+        a & blocks;
+        a & words;
+    }
+
+    template<typename Archive>
+    void load(Archive& a) {
+        a & epoch;
+        a & version;
+        a & num_blocks;
+        a & full;
+        a & blocks;
+        a & words;
+    }
+};
+
+/**
+ * @brief Blocked Bloom filter over the names of a phonebook. Each name
+ * sets kNumProbes bits within a single 512-bit block (one cache line),
+ * so adding or testing a name touches one block. With kBitsPerName bits
+ * per name, a filter holding as many names as its capacity has a false
+ * positive rate of about 1%. Names are given as 64-bit hashes with
+ * well-mixed bits (see yp::mixHash). An empty filter (default-constructed)
+ * may contain anything.
+ */
+class BloomFilter {
+
+    public:
+
+    static constexpr size_t   kBlockWords  = 8;
+    static constexpr unsigned kNumProbes   = 7;
+    static constexpr unsigned kBitsPerName = 10;
+
+    BloomFilter() = default;
+
+    /**
+     * @brief Creates a filter sized for the given number of names.
+     */
+    explicit BloomFilter(size_t capacity)
+    : m_words(numBlocksFor(capacity) * kBlockWords, 0) {}
+
+    static size_t numBlocksFor(size_t capacity) {
+        return std::max<size_t>(1, (capacity * kBitsPerName + 511) / 512);
+    }
+
+    size_t numBlocks() const {
+        return m_words.size() / kBlockWords;
+    }
+
+    bool empty() const {
+        return m_words.empty();
+    }
+
+    /**
+     * @brief Index of the block a hash falls into.
+     */
+    size_t blockOf(uint64_t hash) const {
+        return static_cast<size_t>(((hash >> 32) * numBlocks()) >> 32);
+    }
+
+    /**
+     * @brief Adds a hash and returns the index of its block.
+     */
+    size_t add(uint64_t hash) {
+        size_t b = blockOf(hash);
+        uint64_t* block = &m_words[b * kBlockWords];
+        uint64_t probes = hash * 0x9e3779b97f4a7c15ULL;
+        for(unsigned i = 0; i < kNumProbes; i++) {
+            unsigned bit = (probes >> (9 * i)) & 511;
+            block[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+        return b;
+    }
+
+    /**
+     * @brief Returns false if the hash was definitely not added.
+     */
+    bool mayContain(uint64_t hash) const {
+        if(empty()) return true;
+        const uint64_t* block = &m_words[blockOf(hash) * kBlockWords];
+        uint64_t probes = hash * 0x9e3779b97f4a7c15ULL;
+        for(unsigned i = 0; i < kNumProbes; i++) {
+            unsigned bit = (probes >> (9 * i)) & 511;
+            if(!(block[bit / 64] & (uint64_t(1) << (bit % 64))))
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Words of the filter, kBlockWords per block.
+     */
+    const std::vector<uint64_t>& words() const {
+        return m_words;
+    }
+
+    /**
+     * @brief Applies an update, replacing the filter if it is full.
+     * Throws an Exception if the update does not match the filter.
+     */
+    void apply(const FilterUpdate& update) {
+        if(update.full) {
+            if(update.words.size() != update.num_blocks * kBlockWords)
+                throw Exception("Invalid filter update");
+            m_words = update.words;
+            return;
+        }
+        if(update.num_blocks != numBlocks()
+        || update.words.size() != update.blocks.size() * kBlockWords)
+            throw Exception("Invalid filter update");
+        for(size_t i = 0; i < update.blocks.size(); i++) {
+            if(update.blocks[i] >= numBlocks())
+                throw Exception("Invalid filter update");
+            std::copy_n(&update.words[i * kBlockWords], kBlockWords,
+                        &m_words[update.blocks[i] * kBlockWords]);
+        }
+    }
+
+    private:
+
+    std::vector<uint64_t> m_words;
+};
+
+}
+
+#endif
@@ -7,15 +7,28 @@
 #define __YP_CLIENT_HPP
 
 #include <yp/PhonebookHandle.hpp>
+#include <yp/AsyncRequest.hpp>
 #include <yp/UUID.hpp>
 #include <thallium.hpp>
+#include <functional>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace yp {
 
 class ClientImpl;
 class PhonebookHandle;
 
+/**
+ * @brief Options of Client::broadcast.
+ */
+struct BroadcastOptions {
+    bool   stop_on_first_hit = false; // return after the first successful operation
+    double timeout_ms        = 0.0;   // deadline of the call, none if not positive
+};
+
 /**
  * @brief The Client object is the main object used to establish
  * a connection with a Yp service.
@@ -79,6 +92,9 @@ class Client {
      * @brief Creates a handle to a remote phonebook and returns.
      * You may set "check" to false if you know for sure that the
      * corresponding phonebook exists, which will avoid one RPC.
+     * The check also obtains from the provider a compact handle to
+     * the phonebook, used instead of its UUID by subsequent RPCs;
+     * without it, the compact handle is obtained on first use.
      *
      * @param address Address of the provider holding the database.
      * @param provider_id Provider id.
@@ -97,6 +113,48 @@ class Client {
      */
     operator bool() const;
 
+    /**
+     * @brief Sends the same operation to all the phonebooks concurrently
+     * and combines the results in the order in which they arrive.
+     * op(handles[i], &result, &req) must issue a non-blocking operation
+     * that stores its result in result, e.g. a call to lookup. Each
+     * successful result is passed to combine(i, std::move(result)); the
+     * error message of each failed operation is stored in errors, if not
+     * null, along with the index of its handle. The call returns after
+     * all the operations have completed, after the first successful one
+     * if options.stop_on_first_hit is set, or when options.timeout_ms
+     * expires, in which case the pending operations are reported as
+     * failed. Each operation is waited on by its own ULT of the handler
+     * pool, which wakes up the caller; operations still pending when the
+     * call returns are left to these ULTs and their results discarded.
+     * An op that throws is reported in errors like a failed operation.
+     *
+     * @param handles phonebooks to send the operation to
+     * @param op function issuing the operation on a handle
+     * @param combine function combining a successful result
+     * @param options early termination and deadline
+     * @param errors errors of the failed operations
+     *
+     * @return the number of results passed to combine.
+     */
+    template<typename T, typename Op, typename Combine>
+    size_t broadcast(const std::vector<PhonebookHandle>& handles,
+                     Op&& op,
+                     Combine&& combine,
+                     const BroadcastOptions& options = BroadcastOptions(),
+                     std::vector<std::pair<size_t, std::string>>* errors = nullptr) const {
+        // the results are shared with the ULT that waits on pending operations
+        auto results = std::make_shared<std::vector<T>>(handles.size());
+        return broadcastImpl(handles.size(),
+            [&handles, &op, results](size_t i, AsyncRequest* req) {
+                op(handles[i], &(*results)[i], req);
+            },
+            [&combine, results](size_t i) {
+                combine(i, std::move((*results)[i]));
+            },
+            results, options, errors);
+    }
+
     /**
      * @brief Get internal configuration as a JSON-formatted string.
      *
@@ -108,6 +166,13 @@ class Client {
 
     Client(const std::shared_ptr<ClientImpl>& impl);
 
+    size_t broadcastImpl(size_t count,
+                     const std::function<void(size_t, AsyncRequest*)>& issue,
+                     const std::function<void(size_t)>& combine,
+                         std::shared_ptr<void> results,
+                         const BroadcastOptions& options,
+                         std::vector<std::pair<size_t, std::string>>* errors) const;
+
     std::shared_ptr<ClientImpl> self;
 };
 
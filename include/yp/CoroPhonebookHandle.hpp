@@ -0,0 +1,191 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_CORO_PHONEBOOK_HANDLE_HPP
+#define __YP_CORO_PHONEBOOK_HANDLE_HPP
+
+#include <yp/PhonebookHandle.hpp>
+#include <thallium.hpp>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace yp {
+
+class CoroPhonebookHandle;
+
+/**
+ * @brief An Awaitable is the pending result of an operation started
+ * by a CoroPhonebookHandle. The RPC is sent when the Awaitable is
+ * created; co_await suspends the calling coroutine until the response
+ * arrives, then returns the result or throws an Exception.
+ *
+ * No thread blocks while the coroutine is suspended: completion is
+ * handled by an Argobots ULT (a user-level thread, which yields its
+ * execution stream while waiting) created in the handle's pool, and
+ * the coroutine is resumed from that ULT. The code following the
+ * co_await therefore runs on one of the pool's execution streams.
+ *
+ * An Awaitable that is destroyed without being awaited waits for the
+ * operation to complete, like an AsyncRequest.
+ *
+ * @tparam T Type of the result.
+ */
+template<typename T>
+class Awaitable {
+
+    friend class CoroPhonebookHandle;
+
+    struct Value {
+        T value;
+    };
+
+    struct Empty {};
+
+    struct State : std::conditional_t<std::is_void<T>::value, Empty, Value> {
+        AsyncRequest       request;
+        std::exception_ptr error;
+    };
+
+    std::shared_ptr<State> m_state = std::make_shared<State>();
+    thallium::pool         m_pool;
+
+    Awaitable(const thallium::pool& pool)
+    : m_pool(pool) {}
+
+    public:
+
+    Awaitable(Awaitable&&) = default;
+    Awaitable& operator=(Awaitable&&) = default;
+    Awaitable(const Awaitable&) = delete;
+    Awaitable& operator=(const Awaitable&) = delete;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> coroutine) {
+        // the ULT may resume the coroutine, and destroy this object,
+        // before make_thread returns: only the copied state is used
+        auto state = m_state;
+        m_pool.make_thread([state, coroutine]() {
+            try {
+                state->request.wait();
+            } catch(...) {
+                state->error = std::current_exception();
+            }
+            coroutine.resume();
+        }, thallium::anonymous());
+    }
+
+    T await_resume() {
+        if(m_state->error)
+            std::rethrow_exception(m_state->error);
+        if constexpr (!std::is_void<T>::value)
+            return std::move(m_state->value);
+    }
+};
+
+/**
+ * @brief A CoroPhonebookHandle wraps a PhonebookHandle to expose its
+ * operations as Awaitables, for use in C++20 coroutines. It is part of
+ * the yp-client-coro library.
+ *
+ * @code
+ * yp::CoroPhonebookHandle phonebook(handle);
+ * std::string number = co_await phonebook.lookup("Alice");
+ * @endcode
+ */
+class CoroPhonebookHandle {
+
+    public:
+
+    /**
+     * @brief Constructor. The resulting handle will be invalid.
+     */
+    CoroPhonebookHandle() = default;
+
+    /**
+     * @brief Constructor. Completions are handled in the handler
+     * pool of the handle's engine.
+     */
+    CoroPhonebookHandle(const PhonebookHandle& handle);
+
+    /**
+     * @brief Constructor. Completions are handled in the given pool,
+     * in which coroutines are therefore resumed.
+     */
+    CoroPhonebookHandle(const PhonebookHandle& handle, const thallium::pool& pool);
+
+    /**
+     * @brief Returns the underlying PhonebookHandle.
+     */
+    const PhonebookHandle& handle() const {
+        return m_handle;
+    }
+
+    /**
+     * @brief Checks if the CoroPhonebookHandle instance is valid.
+     */
+    operator bool() const {
+        return static_cast<bool>(m_handle);
+    }
+
+    /**
+     * @brief See PhonebookHandle::computeSum.
+     */
+    Awaitable<int32_t> computeSum(int32_t x, int32_t y) const;
+
+    /**
+     * @brief See PhonebookHandle::insert.
+     */
+    Awaitable<void> insert(const std::string& name, const std::string& number) const;
+
+    /**
+     * @brief See PhonebookHandle::lookup.
+     */
+    Awaitable<std::string> lookup(const std::string& name) const;
+
+    /**
+     * @brief See PhonebookHandle::lookupMulti. The names and
+     * results must be kept alive until the result is awaited.
+     */
+    Awaitable<void> lookupMulti(const std::vector<std::string>& names,
+                                LookupBuffer* results) const;
+
+    /**
+     * @brief See PhonebookHandle::erase.
+     */
+    Awaitable<void> erase(const std::string& name) const;
+
+    /**
+     * @brief See PhonebookHandle::search.
+     */
+    Awaitable<std::vector<std::pair<std::string, std::string>>>
+        search(const std::string& pattern, uint32_t maxEditDistance, size_t limit) const;
+
+    /**
+     * @brief See PhonebookHandle::reverseLookup.
+     */
+    Awaitable<std::vector<std::string>> reverseLookup(const std::string& number) const;
+
+    /**
+     * @brief See PhonebookHandle::scan.
+     */
+    Awaitable<ScanResult> scan(const ScanQuery& query) const;
+
+    private:
+
+    PhonebookHandle m_handle;
+    thallium::pool  m_pool;
+};
+
+}
+
+#endif
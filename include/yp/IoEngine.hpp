@@ -0,0 +1,163 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_IO_ENGINE_HPP
+#define __YP_IO_ENGINE_HPP
+
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+namespace yp {
+
+class IoEngineImpl;
+
+/**
+ * @brief Options of an IoEngine.
+ */
+struct IoEngineOptions {
+    std::string type        = "io_uring"; // or "blocking"
+    unsigned    queue_depth = 256;        // operations in flight
+    unsigned    num_buffers = 64;         // registered buffers
+    size_t      buffer_size = 64 * 1024;
+};
+
+/**
+ * @brief Asynchronous file I/O for disk-backed backends. A blocking
+ * pread or pwrite issued by a handler ULT stalls the whole execution
+ * stream it runs on, along with every other ULT scheduled there. The
+ * IoEngine submits the operations to an io_uring instance instead and
+ * suspends only the calling ULT until the kernel completes them, so
+ * that one execution stream can keep many operations in flight.
+ * Completions are reaped by a dedicated thread that wakes up the
+ * waiting ULTs. The engine also owns a set of buffers registered with
+ * the kernel, which saves mapping the pages of the buffer on every
+ * operation.
+ *
+ * If io_uring is not available (old kernel, seccomp profile, etc.),
+ * or if the engine is created with type "blocking", the operations are
+ * performed by plain blocking system calls.
+ *
+ * The engine is owned by the provider and shared by all its phonebooks,
+ * which reach it through Backend::ioEngine().
+ */
+class IoEngine {
+
+    public:
+
+    /**
+     * @brief A registered buffer, returned to the engine on destruction.
+     * A Buffer must not outlive the operations using it.
+     */
+    class Buffer {
+
+        friend class IoEngine;
+
+        public:
+
+        Buffer() = default;
+        Buffer(Buffer&& other);
+        Buffer& operator=(Buffer&& other);
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+        ~Buffer();
+
+        char* data() const {
+            return m_data;
+        }
+
+        size_t size() const {
+            return m_size;
+        }
+
+        private:
+
+        std::shared_ptr<IoEngineImpl> m_engine;
+        char*                         m_data  = nullptr;
+        size_t                        m_size  = 0;
+        unsigned                      m_index = 0;
+    };
+
+    /**
+     * @brief Constructor. Throws an Exception if the options are invalid.
+     * Falls back to blocking I/O if io_uring cannot be set up.
+     */
+    explicit IoEngine(const IoEngineOptions& options = IoEngineOptions());
+
+    /**
+     * @brief Destructor. No operation may be in flight.
+     */
+    ~IoEngine();
+
+    IoEngine(const IoEngine&) = delete;
+    IoEngine& operator=(const IoEngine&) = delete;
+
+    /**
+     * @brief Reads up to size bytes at offset, suspending the calling
+     * ULT until the read completes. Has the semantics of ::pread: returns
+     * the number of bytes read, or -1 with errno set.
+     */
+    ssize_t pread(int fd, void* data, size_t size, uint64_t offset);
+
+    /**
+     * @brief Writes up to size bytes at offset, suspending the calling
+     * ULT until the write completes. Has the semantics of ::pwrite.
+     */
+    ssize_t pwrite(int fd, const void* data, size_t size, uint64_t offset);
+
+    /**
+     * @brief Takes a registered buffer of bufferSize() bytes, waiting
+     * for one to be released if they are all in use.
+     */
+    Buffer acquireBuffer();
+
+    /**
+     * @brief Reads up to size bytes (at most buffer.size()) at offset
+     * into a registered buffer.
+     */
+    ssize_t pread(int fd, Buffer& buffer, size_t size, uint64_t offset);
+
+    /**
+     * @brief Writes up to size bytes (at most buffer.size()) at offset
+     * from a registered buffer.
+     */
+    ssize_t pwrite(int fd, const Buffer& buffer, size_t size, uint64_t offset);
+
+    /**
+     * @brief Whether operations go through io_uring (as opposed to
+     * blocking system calls).
+     */
+    bool usesIoUring() const;
+
+    size_t bufferSize() const;
+
+    /**
+     * @brief Returns the options the engine was created with.
+     */
+    const IoEngineOptions& options() const;
+
+    /**
+     * @brief Returns the type of engine actually used, the queue depth,
+     * the number of operations submitted and the maximum number of them
+     * simultaneously in flight, as a JSON-formatted string.
+     */
+    std::string getStats() const;
+
+    /**
+     * @brief Process-wide blocking engine, used by the backends that
+     * are not managed by a provider.
+     */
+    static IoEngine& blocking();
+
+    private:
+
+    std::shared_ptr<IoEngineImpl> self;
+};
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_LOOKUP_BUFFER_HPP
+#define __YP_LOOKUP_BUFFER_HPP
+
+#include <yp/RequestResult.hpp>
+#include <yp/Exception.hpp>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+namespace yp {
+
+/**
+ * @brief A LookupBuffer holds the results of a batch of lookups: for
+ * each name, in order, a status (Status::Success or Status::NotFound)
+ * and, if found, the number. Numbers are stored back to back in a
+ * single byte array and returned as views into it, which remain valid
+ * until the buffer is modified. Clearing the buffer keeps its capacity,
+ * so reusing a buffer across calls of similar size does not allocate.
+ *
+ * @code
+ * yp::LookupBuffer results;
+ * for(auto& batch : batches) {
+ *     handle.lookupMulti(batch, &results);
+ *     for(size_t i = 0; i < results.size(); i++)
+ *         if(results.found(i)) use(batch[i], results.value(i));
+ * }
+ * @endcode
+ */
+class LookupBuffer {
+
+    public:
+
+    /**
+     * @brief Number of results.
+     */
+    size_t size() const {
+        return m_statuses.size();
+    }
+
+    /**
+     * @brief Status of the i-th lookup.
+     */
+    Status status(size_t i) const {
+        return static_cast<Status>(m_statuses[i]);
+    }
+
+    /**
+     * @brief Whether the i-th name was found.
+     */
+    bool found(size_t i) const {
+        return status(i) == Status::Success;
+    }
+
+    /**
+     * @brief Number found by the i-th lookup (empty if not found).
+     */
+    std::string_view value(size_t i) const {
+        uint32_t begin = i == 0 ? 0 : m_ends[i-1];
+        return std::string_view(m_bytes.data() + begin, m_ends[i] - begin);
+    }
+
+    /**
+     * @brief Removes all the results, keeping the memory.
+     */
+    void clear() {
+        m_statuses.clear();
+        m_ends.clear();
+        m_bytes.clear();
+    }
+
+    /**
+     * @brief Adds a result.
+     */
+    void append(Status status, std::string_view value = std::string_view()) {
+        m_statuses.push_back(static_cast<uint8_t>(status));
+        m_bytes.insert(m_bytes.end(), value.begin(), value.end());
+        m_ends.push_back(static_cast<uint32_t>(m_bytes.size()));
+    }
+
+    template<typename Archive>
+    void save(Archive& a) const {
+        uint64_t count = m_statuses.size();
+        uint64_t bytes = m_bytes.size();
+        a & count;
+        a & bytes;
+        if(count) {
+            a.write(m_statuses.data(), count);
+            a.write(m_ends.data(), count);
+        }
+        if(bytes) a.write(m_bytes.data(), bytes);
+    }
+
+    template<typename Archive>
+    void load(Archive& a) {
+        uint64_t count, bytes;
+        a & count;
+        a & bytes;
+        // resize() within the capacity does not allocate
+        m_statuses.resize(count);
+        m_ends.resize(count);
+        m_bytes.resize(bytes);
+        if(count) {
+            a.read(m_statuses.data(), count);
+            a.read(m_ends.data(), count);
+        }
+        if(bytes) a.read(m_bytes.data(), bytes);
+        uint32_t previous = 0;
+        for(auto end : m_ends) {
+            if(end < previous)
+                throw Exception("Invalid lookup results");
+            previous = end;
+        }
+        if(previous != bytes)
+            throw Exception("Invalid lookup results");
+    }
+
+    private:
+
+    std::vector<uint8_t>  m_statuses;
+    std::vector<uint32_t> m_ends;  // end offset of each number in m_bytes
+    std::vector<char>     m_bytes;
+};
+
+}
+
+#endif
@@ -9,10 +9,14 @@
 #include <thallium.hpp>
 #include <memory>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include <yp/Client.hpp>
 #include <yp/Exception.hpp>
 #include <yp/AsyncRequest.hpp>
+#include <yp/LookupBuffer.hpp>
+#include <yp/Scan.hpp>
 
 namespace yp {
 
@@ -92,6 +96,256 @@ class PhonebookHandle {
                     int32_t* result = nullptr,
                     AsyncRequest* req = nullptr) const;
 
+    /**
+     * @brief Requests the target phonebook to compute out[i] = x[i] + y[i]
+     * for n pairs of integers in a single RPC, the arrays being transferred
+     * using RDMA. Sums that overflow wrap around. If overflow is not null,
+     * it must hold (n + 63) / 64 words and bit i % 64 of overflow[i / 64]
+     * is set if sum i overflowed. If req is not null, this call will be
+     * non-blocking and the caller is responsible for waiting on the request
+     * and for keeping the arrays alive until then.
+     *
+     * @param[in] x first integers
+     * @param[in] y second integers
+     * @param[out] out sums
+     * @param[in] n number of pairs
+     * @param[out] overflow overflow bitmap
+     * @param[out] req request for a non-blocking operation
+     */
+    void computeSumMany(const int32_t* x, const int32_t* y,
+                        int32_t* out, size_t n,
+                        uint64_t* overflow = nullptr,
+                        AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Inserts a name/number pair in the target phonebook.
+     * If the name is already present, its number is replaced.
+     * If req is not null, this call will be non-blocking and the
+     * caller is responsible for waiting on the request.
+     *
+     * @param[in] name name to insert
+     * @param[in] number phone number associated with the name
+     * @param[out] req request for a non-blocking operation
+     */
+    void insert(const std::string& name,
+                const std::string& number,
+                AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Looks up the number associated with a name in the target
+     * phonebook. If number is null, it will be ignored. If req is not null,
+     * this call will be non-blocking and the caller is responsible for
+     * waiting on the request. Throws an Exception if the name is not found.
+     *
+     * @param[in] name name to look up
+     * @param[out] number phone number associated with the name
+     * @param[out] req request for a non-blocking operation
+     */
+    void lookup(const std::string& name,
+                std::string* number,
+                AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Looks up the number associated with a name, decoding the
+     * result into a caller-provided buffer rather than a new std::string.
+     * On success, results holds a single result, with Status::NotFound
+     * if the name is not in the phonebook (which is not an error).
+     * Reusing the same buffer across calls avoids allocations. If req
+     * is not null, this call will be non-blocking and the caller is
+     * responsible for waiting on the request and for keeping name and
+     * results alive until then.
+     *
+     * @param[in] name name to look up
+     * @param[out] results result of the lookup
+     * @param[out] req request for a non-blocking operation
+     */
+    void lookup(const std::string& name,
+                LookupBuffer* results,
+                AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Looks up the numbers associated with each of the names in
+     * a single RPC. On success, results holds one result per name, in
+     * order (see lookup above). If req is not null, this call will be
+     * non-blocking and the caller is responsible for waiting on the
+     * request and for keeping names and results alive until then.
+     *
+     * @param[in] names names to look up
+     * @param[out] results results of the lookups
+     * @param[out] req request for a non-blocking operation
+     */
+    void lookupMulti(const std::vector<std::string>& names,
+                     LookupBuffer* results,
+                     AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Erases a name from the target phonebook.
+     * If req is not null, this call will be non-blocking and the
+     * caller is responsible for waiting on the request. Throws an
+     * Exception if the name is not found.
+     *
+     * @param[in] name name to erase
+     * @param[out] req request for a non-blocking operation
+     */
+    void erase(const std::string& name,
+               AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Inserts a name and number without waiting for the
+     * phonebook to acknowledge it. The one-way writes (insertNoAck
+     * and eraseNoAck) issued through this handle and its copies are
+     * applied by the provider in the order in which they were issued.
+     * Their errors are reported by the next call to flush.
+     *
+     * @param[in] name name to insert
+     * @param[in] number phone number
+     */
+    void insertNoAck(const std::string& name,
+                     const std::string& number) const;
+
+    /**
+     * @brief Erases a name without waiting for the phonebook to
+     * acknowledge it. See insertNoAck.
+     *
+     * @param[in] name name to erase
+     */
+    void eraseNoAck(const std::string& name) const;
+
+    /**
+     * @brief Waits until all the one-way writes issued through this
+     * handle before the call have been applied. If some of the writes
+     * applied since the previous flush failed, or if some were lost on
+     * their way to the provider, their error messages are stored in
+     * errors or, if errors is null, an Exception is thrown.
+     *
+     * @param[out] errors error messages of the failed writes
+     */
+    void flush(std::vector<std::string>* errors = nullptr) const;
+
+    /**
+     * @brief Searches the target phonebook for the entries whose name
+     * contains the pattern with at most maxEditDistance insertions,
+     * deletions or substitutions, ignoring ASCII case. Entries with the
+     * fewest edits come first. If req is not null, this call will be
+     * non-blocking and the caller is responsible for waiting on the request.
+     *
+     * @param[in] pattern pattern to look for
+     * @param[in] maxEditDistance maximum number of edits
+     * @param[in] limit maximum number of results (0 for no limit)
+     * @param[out] results name/number pairs found
+     * @param[out] req request for a non-blocking operation
+     */
+    void search(const std::string& pattern,
+                uint32_t maxEditDistance,
+                size_t limit,
+                std::vector<std::pair<std::string, std::string>>* results,
+                AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Looks up the names associated with a number in the target
+     * phonebook. If names is null, it will be ignored. If req is not null,
+     * this call will be non-blocking and the caller is responsible for
+     * waiting on the request. Throws an Exception if no name is associated
+     * with the number.
+     *
+     * @param[in] number phone number to look up
+     * @param[out] names names associated with the number
+     * @param[out] req request for a non-blocking operation
+     */
+    void reverseLookup(const std::string& number,
+                       std::vector<std::string>* names,
+                       AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Looks up the names associated with each of the numbers
+     * in a single RPC. names[i] receives the (possibly empty) list of
+     * names associated with numbers[i]. If req is not null, this call
+     * will be non-blocking and the caller is responsible for waiting
+     * on the request.
+     *
+     * @param[in] numbers phone numbers to look up
+     * @param[out] names names associated with each number
+     * @param[out] req request for a non-blocking operation
+     */
+    void reverseLookupMulti(const std::vector<std::string>& numbers,
+                            std::vector<std::vector<std::string>>* names,
+                            AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Evaluates a scan query on the server side: only the entries
+     * passing the query's filter are considered, and only the requested
+     * aggregate (or the matching entries) is sent back. If result is null,
+     * it will be ignored. If req is not null, this call will be non-blocking
+     * and the caller is responsible for waiting on the request.
+     *
+     * @param[in] query filter and aggregation
+     * @param[out] result result of the scan
+     * @param[out] req request for a non-blocking operation
+     */
+    void scan(const ScanQuery& query,
+              ScanResult* result,
+              AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Enables the caching of the phonebook's name filter, a Bloom
+     * filter over its names (the backend must support it, e.g. the dummy
+     * backend with "name_filter" enabled). Lookups of a single name that
+     * the filter shows to be missing then fail without an RPC, as they
+     * would with the provider. The filter is downloaded by this call and
+     * its changes are downloaded by the first lookup made after it has
+     * been cached for maxAgeMilliseconds (or the whole filter, if the
+     * provider rebuilt it). Names inserted through this handle and its
+     * copies are added to the cached filter right away. The refresh is
+     * driven by age alone: the provider does not notify the handle of
+     * changes, so a name inserted through another handle (or restored
+     * from a snapshot) may be reported missing for up to
+     * maxAgeMilliseconds after the insert completes. Applications that
+     * cannot tolerate such false negatives should keep maxAgeMilliseconds
+     * below the delay they accept, or not enable the filter.
+     * Throws an Exception if the backend does not support name filters.
+     *
+     * @param maxAgeMilliseconds time after which the filter is refreshed
+     */
+    void enableLookupFilter(double maxAgeMilliseconds) const;
+
+    /**
+     * @brief Disables the caching of the name filter, sending all
+     * lookups to the provider.
+     */
+    void disableLookupFilter() const;
+
+    /**
+     * @brief Enables the coalescing of the small asynchronous operations
+     * (computeSum, insert, lookup and erase called with a non-null req)
+     * issued through this handle and its copies. Instead of being sent
+     * in its own RPC, such an operation is added to a batch, sent as a
+     * single RPC once it holds maxOps operations or maxDelayMicroseconds
+     * after its first operation was added, whichever comes first, or as
+     * soon as one of its operations is waited on. The operations of a
+     * batch are executed in order. Synchronous calls are not affected.
+     * The delay is implemented by a ULT in the handler pool of the
+     * client's engine; if that pool never gets to run, batches are only
+     * sent when full or waited on. Calling this function again changes
+     * the parameters, sending the pending batch if any.
+     *
+     * @param maxOps maximum number of operations in a batch
+     * @param maxDelayMicroseconds maximum time an operation is delayed
+     */
+    void enableCoalescing(size_t maxOps, double maxDelayMicroseconds) const;
+
+    /**
+     * @brief Disables the coalescing of operations, sending
+     * the pending batch if any.
+     */
+    void disableCoalescing() const;
+
+    /**
+     * @brief Returns statistics about the target phonebook (number of
+     * entries, bytes per entry, etc.) as a JSON-formatted string.
+     * The fields depend on the phonebook's backend.
+     */
+    std::string getStats() const;
+
     private:
 
     /**
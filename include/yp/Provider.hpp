@@ -89,6 +89,28 @@ class Provider {
      */
     std::string getConfig() const;
 
+    /**
+     * @brief Moves the handling of the provider's RPCs to another pool,
+     * e.g. to take a busy provider off an execution stream it shares
+     * with other providers. The RPCs remain registered with the pool the
+     * provider was created with, in which each request merely spawns its
+     * handler in the new pool. A null pool moves the handling back.
+     *
+     * @param pool Pool in which to handle the RPCs.
+     */
+    void setPool(const tl::pool& pool);
+
+    /**
+     * @brief Returns the load of the provider as a JSON-formatted string:
+     * the number of RPCs handled, forwarded to another pool and in flight,
+     * the time spent in handlers and its ratio to the provider's uptime
+     * (which exceeds 1 when handlers overlap), and the number of work
+     * units waiting in the pool the provider runs in.
+     *
+     * @return JSON formatted string.
+     */
+    std::string getLoad() const;
+
     /**
      * @brief Checks whether the Provider instance is valid.
      */
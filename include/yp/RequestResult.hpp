@@ -7,9 +7,60 @@
 #define __YP_REQUEST_RESULT_HPP
 
 #include <string>
+#include <cstdint>
 
 namespace yp {
 
+/**
+ * @brief Status of a request, sent as a single byte. Failures other
+ * than Error have a standard message (see statusMessage()) and are
+ * sent without any text; Error failures are described by the error
+ * string that comes with them.
+ */
+enum class Status : uint8_t {
+    Success           = 0,
+    Error             = 1,
+    InvalidToken      = 2,
+    PhonebookNotFound = 3,
+    StaleHandle       = 4,
+    NotFound          = 5,
+    QuotaExceeded     = 6
+};
+
+/**
+ * @brief Standard message of a status.
+ */
+inline const char* statusMessage(Status status) {
+    switch(status) {
+        case Status::Success:           return "Success";
+        case Status::InvalidToken:      return "Invalid security token";
+        case Status::PhonebookNotFound: return "Phonebook not found";
+        case Status::StaleHandle:       return "Stale phonebook handle";
+        case Status::NotFound:          return "Entry not found";
+        case Status::QuotaExceeded:     return "Memory quota exceeded";
+        default:                        return "Error";
+    }
+}
+
+/**
+ * @brief Standard message of a status as a std::string, built once.
+ */
+inline const std::string& statusMessageString(Status status) {
+    static const std::string messages[] = {
+        statusMessage(Status::Success),
+        statusMessage(Status::Error),
+        statusMessage(Status::InvalidToken),
+        statusMessage(Status::PhonebookNotFound),
+        statusMessage(Status::StaleHandle),
+        statusMessage(Status::NotFound),
+        statusMessage(Status::QuotaExceeded)
+    };
+    auto index = static_cast<size_t>(status);
+    if(index >= sizeof(messages) / sizeof(messages[0]))
+        index = static_cast<size_t>(Status::Error);
+    return messages[index];
+}
+
 /**
  * @brief The RequestResult object is a generic object
  * used to hold and send back the result of an RPC.
@@ -18,6 +69,15 @@ namespace yp {
  * - error must be set to an error string if an error occured
  * - value must be set to the result of the request if it succeeded
  *
+ * Alternatively, fail() marks the request as failed with one of the
+ * standard statuses, in which case no error string is built or sent
+ * over the network: error() returns the status' standard message,
+ * on either side.
+ * On the wire, a RequestResult is a status byte followed by the value
+ * (on success) or the error string (on Error failures only), so that
+ * successful responses carry no string and need no heap allocation
+ * beyond that of the value itself.
+ *
  * This class is specialized for two types: bool and std::string.
  * If bool is used, both the value and the success fields will be
  * managed by the same underlying variable. If std::string is used,
@@ -52,9 +112,28 @@ class RequestResult {
     }
 
     /**
-     * @brief Error string if the request failed.
+     * @brief Status of the request.
+     */
+    Status status() const {
+        return m_success ? Status::Success : m_status;
+    }
+
+    /**
+     * @brief Marks the request as failed with a standard status.
+     */
+    void fail(Status status) {
+        m_success = false;
+        m_status  = status;
+        m_error.clear();
+    }
+
+    /**
+     * @brief Error string if the request failed (for a standard
+     * status, its message, copied into the error string on first use).
      */
     std::string& error() {
+        if(!m_success && m_status != Status::Error && m_error.empty())
+            m_error = statusMessage(m_status);
         return m_error;
     }
 
@@ -62,6 +141,8 @@ class RequestResult {
      * @brief Error string if the request failed.
      */
     const std::string& error() const {
+        if(!m_success && m_status != Status::Error && m_error.empty())
+            return statusMessageString(m_status);
         return m_error;
     }
 
@@ -86,16 +167,40 @@ class RequestResult {
      * @param a Archive instance.
      */
     template<typename Archive>
-    void serialize(Archive& a) {
-        a & m_success;
-        a & m_error;
-        a & m_value;
+    void save(Archive& a) const {
+        uint8_t status = static_cast<uint8_t>(this->status());
+        a & status;
+        if(m_success)
+            a & m_value;
+        else if(m_status == Status::Error)
+            a & m_error;
+    }
+
+    /**
+     * @brief Deserialization function for Thallium.
+     *
+     * @tparam Archive Archive type.
+     * @param a Archive instance.
+     */
+    template<typename Archive>
+    void load(Archive& a) {
+        uint8_t status;
+        a & status;
+        m_success = status == static_cast<uint8_t>(Status::Success);
+        m_status  = m_success ? Status::Error : static_cast<Status>(status);
+        if(m_success)
+            a & m_value;
+        else if(m_status == Status::Error)
+            a & m_error;
+        else
+            m_error.clear(); // see error()
     }
 
     private:
 
     bool        m_success = true;
-    std::string m_error   = "";
+    Status      m_status  = Status::Error; // meaningful only if m_success is false
+    std::string m_error;
     T           m_value;
 };
 
@@ -118,11 +223,25 @@ class RequestResult<std::string> {
         return m_success;
     }
 
+    Status status() const {
+        return m_success ? Status::Success : m_status;
+    }
+
+    void fail(Status status) {
+        m_success = false;
+        m_status  = status;
+        m_content.clear();
+    }
+
     std::string& error() {
+        if(!m_success && m_status != Status::Error && m_content.empty())
+            m_content = statusMessage(m_status);
         return m_content;
     }
 
     const std::string& error() const {
+        if(!m_success && m_status != Status::Error && m_content.empty())
+            return statusMessageString(m_status);
         return m_content;
     }
 
@@ -135,15 +254,30 @@ class RequestResult<std::string> {
     }
 
     template<typename Archive>
-    void serialize(Archive& a) {
-        a & m_success;
-        a & m_content;
+    void save(Archive& a) const {
+        uint8_t status = static_cast<uint8_t>(this->status());
+        a & status;
+        if(m_success || m_status == Status::Error)
+            a & m_content;
+    }
+
+    template<typename Archive>
+    void load(Archive& a) {
+        uint8_t status;
+        a & status;
+        m_success = status == static_cast<uint8_t>(Status::Success);
+        m_status  = m_success ? Status::Error : static_cast<Status>(status);
+        if(m_success || m_status == Status::Error)
+            a & m_content;
+        else
+            m_content.clear(); // see error()
     }
 
     private:
 
     bool        m_success = true;
-    std::string m_content = "";
+    Status      m_status  = Status::Error;
+    std::string m_content;
 };
 
 template<>
@@ -165,11 +299,25 @@ class RequestResult<bool> {
         return m_success;
     }
 
+    Status status() const {
+        return m_success ? Status::Success : m_status;
+    }
+
+    void fail(Status status) {
+        m_success = false;
+        m_status  = status;
+        m_error.clear();
+    }
+
     std::string& error() {
+        if(!m_success && m_status != Status::Error && m_error.empty())
+            m_error = statusMessage(m_status);
         return m_error;
     }
 
     const std::string& error() const {
+        if(!m_success && m_status != Status::Error && m_error.empty())
+            return statusMessageString(m_status);
         return m_error;
     }
 
@@ -182,15 +330,30 @@ class RequestResult<bool> {
     }
 
     template<typename Archive>
-    void serialize(Archive& a) {
-        a & m_success;
-        a & m_error;
+    void save(Archive& a) const {
+        uint8_t status = static_cast<uint8_t>(this->status());
+        a & status;
+        if(!m_success && m_status == Status::Error)
+            a & m_error;
+    }
+
+    template<typename Archive>
+    void load(Archive& a) {
+        uint8_t status;
+        a & status;
+        m_success = status == static_cast<uint8_t>(Status::Success);
+        m_status  = m_success ? Status::Error : static_cast<Status>(status);
+        if(!m_success && m_status == Status::Error)
+            a & m_error;
+        else
+            m_error.clear(); // see error()
     }
 
     private:
 
     bool        m_success = true;
-    std::string m_error   = "";
+    Status      m_status  = Status::Error;
+    std::string m_error;
 };
 
 }
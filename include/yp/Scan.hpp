@@ -0,0 +1,231 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_SCAN_HPP
+#define __YP_SCAN_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace yp {
+
+/**
+ * @brief A ScanQuery describes a scan to be evaluated by the server:
+ * a filter, made of conditions on the fields of the entries that must
+ * all hold, and what to return about the entries that pass it (the
+ * entries themselves, or an aggregate). Only the query and the reduced
+ * result travel over the network.
+ *
+ * @code
+ * // number of entries per area code among the names starting with "A"
+ * yp::ScanQuery query;
+ * query.where(yp::ScanQuery::Field::Name, yp::ScanQuery::Op::Prefix, "A")
+ *      .groupByCount(yp::ScanQuery::Field::Number, 2, 3);
+ * @endcode
+ */
+class ScanQuery {
+
+    public:
+
+    /**
+     * @brief Field of an entry.
+     */
+    enum class Field : uint8_t {
+        Name   = 0,
+        Number = 1
+    };
+
+    /**
+     * @brief Comparison between a field and an operand. Ordered
+     * comparisons are lexicographic, Prefix checks that the field
+     * starts with the operand, and Regex that the field contains a
+     * match of the operand (ECMAScript syntax). Regex operands are
+     * limited to 256 characters and may not use back-references, and a
+     * value longer than 1024 bytes never matches a Regex predicate.
+     */
+    enum class Op : uint8_t {
+        Equal        = 0,
+        NotEqual     = 1,
+        Less         = 2,
+        LessEqual    = 3,
+        Greater      = 4,
+        GreaterEqual = 5,
+        Prefix       = 6,
+        Regex        = 7
+    };
+
+    /**
+     * @brief What the scan computes on the entries that pass the filter.
+     */
+    enum class Aggregate : uint8_t {
+        None          = 0, // return the entries
+        Count         = 1, // count them
+        GroupByCount  = 2, // count them per value of (a substring of) a field
+        CountDistinct = 3  // estimate the number of distinct values of a field
+    };
+
+    /**
+     * @brief Condition on one field.
+     */
+    struct Predicate {
+
+        Field       field = Field::Name;
+        Op          op    = Op::Equal;
+        std::string operand;
+
+        template<typename Archive>
+        void save(Archive& a) const {
+            uint8_t f = static_cast<uint8_t>(field);
+            uint8_t o = static_cast<uint8_t>(op);
+            a & f;
+            a & o;
+            a & operand;
+        }
+
+        template<typename Archive>
+        void load(Archive& a) {
+            uint8_t f, o;
+            a & f;
+            a & o;
+            a & operand;
+            field = static_cast<Field>(f);
+            op    = static_cast<Op>(o);
+        }
+    };
+
+    /**
+     * @brief Adds a condition to the filter.
+     */
+    ScanQuery& where(Field field, Op op, const std::string& operand) {
+        m_predicates.push_back(Predicate{ field, op, operand });
+        return *this;
+    }
+
+    /**
+     * @brief Returns the matching entries, at most limit of them
+     * (0 for no limit), sorted by name. This is the default.
+     */
+    ScanQuery& entries(uint64_t limit = 0) {
+        m_aggregate = Aggregate::None;
+        m_limit = limit;
+        return *this;
+    }
+
+    /**
+     * @brief Returns only the number of matching entries.
+     */
+    ScanQuery& count() {
+        m_aggregate = Aggregate::Count;
+        return *this;
+    }
+
+    /**
+     * @brief Counts the matching entries per group, the group of an
+     * entry being the substring of the field starting at offset and
+     * of at most length bytes (the whole field by default).
+     */
+    ScanQuery& groupByCount(Field field, uint32_t offset = 0, uint32_t length = UINT32_MAX) {
+        m_aggregate = Aggregate::GroupByCount;
+        m_field  = field;
+        m_offset = offset;
+        m_length = length;
+        return *this;
+    }
+
+    /**
+     * @brief Estimates the number of distinct values of the field
+     * among the matching entries, using a HyperLogLog sketch
+     * (typical relative error below 1%).
+     */
+    ScanQuery& countDistinct(Field field) {
+        m_aggregate = Aggregate::CountDistinct;
+        m_field = field;
+        return *this;
+    }
+
+    const std::vector<Predicate>& predicates() const {
+        return m_predicates;
+    }
+
+    Aggregate aggregate() const {
+        return m_aggregate;
+    }
+
+    Field field() const {
+        return m_field;
+    }
+
+    uint32_t offset() const {
+        return m_offset;
+    }
+
+    uint32_t length() const {
+        return m_length;
+    }
+
+    uint64_t limit() const {
+        return m_limit;
+    }
+
+    template<typename Archive>
+    void save(Archive& a) const {
+        uint8_t aggregate = static_cast<uint8_t>(m_aggregate);
+        uint8_t field     = static_cast<uint8_t>(m_field);
+        a & m_predicates;
+        a & aggregate;
+        a & field;
+        a & m_offset;
+        a & m_length;
+        a & m_limit;
+    }
+
+    template<typename Archive>
+    void load(Archive& a) {
+        uint8_t aggregate, field;
+        a & m_predicates;
+        a & aggregate;
+        a & field;
+        a & m_offset;
+        a & m_length;
+        a & m_limit;
+        m_aggregate = static_cast<Aggregate>(aggregate);
+        m_field     = static_cast<Field>(field);
+    }
+
+    private:
+
+    std::vector<Predicate> m_predicates;
+    Aggregate              m_aggregate = Aggregate::None;
+    Field                  m_field     = Field::Name;
+    uint32_t               m_offset    = 0;
+    uint32_t               m_length    = UINT32_MAX;
+    uint64_t               m_limit     = 0;
+};
+
+/**
+ * @brief Result of a scan. Only the fields corresponding
+ * to the query's aggregate are filled, except for count.
+ */
+struct ScanResult {
+
+    uint64_t count    = 0; // number of entries that passed the filter
+    uint64_t distinct = 0; // CountDistinct: estimated number of distinct values
+    std::vector<std::pair<std::string, uint64_t>>    groups;  // GroupByCount: sorted by group
+    std::vector<std::pair<std::string, std::string>> entries; // None: sorted by name
+
+    template<typename Archive>
+    void serialize(Archive& a) {
+        a & count;
+        a & distinct;
+        a & groups;
+        a & entries;
+    }
+};
+
+}
+
+#endif
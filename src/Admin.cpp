@@ -90,6 +90,57 @@ void Admin::destroyPhonebook(const std::string& address,
     }
 }
 
+void Admin::snapshotPhonebook(const std::string& address,
+                              uint16_t provider_id,
+                              const UUID& phonebook_id,
+                              const std::string& path,
+                              const std::string& token) const {
+    auto endpoint  = self->m_engine.lookup(address);
+    auto ph        = tl::provider_handle(endpoint, provider_id);
+    RequestResult<bool> result = self->m_snapshot_phonebook.on(ph)(token, phonebook_id, path);
+    if(not result.success()) {
+        throw Exception(result.error());
+    }
+}
+
+void Admin::restorePhonebook(const std::string& address,
+                             uint16_t provider_id,
+                             const UUID& phonebook_id,
+                             const std::string& path,
+                             const std::string& token) const {
+    auto endpoint  = self->m_engine.lookup(address);
+    auto ph        = tl::provider_handle(endpoint, provider_id);
+    RequestResult<bool> result = self->m_restore_phonebook.on(ph)(token, phonebook_id, path);
+    if(not result.success()) {
+        throw Exception(result.error());
+    }
+}
+
+void Admin::checkpointPhonebook(const std::string& address,
+                                uint16_t provider_id,
+                                const UUID& phonebook_id,
+                                const std::string& directory,
+                                const std::string& token) const {
+    auto endpoint  = self->m_engine.lookup(address);
+    auto ph        = tl::provider_handle(endpoint, provider_id);
+    RequestResult<bool> result = self->m_checkpoint_phonebook.on(ph)(token, phonebook_id, directory);
+    if(not result.success()) {
+        throw Exception(result.error());
+    }
+}
+
+std::string Admin::getProviderLoad(const std::string& address,
+                                   uint16_t provider_id,
+                                   const std::string& token) const {
+    auto endpoint  = self->m_engine.lookup(address);
+    auto ph        = tl::provider_handle(endpoint, provider_id);
+    RequestResult<std::string> result = self->m_get_load.on(ph)(token);
+    if(not result.success()) {
+        throw Exception(result.error());
+    }
+    return std::move(result.value());
+}
+
 void Admin::shutdownServer(const std::string& address) const {
     auto ep = self->m_engine.lookup(address);
     self->m_engine.shutdown_remote_engine(ep);
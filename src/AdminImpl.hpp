@@ -21,6 +21,10 @@ class AdminImpl {
     tl::remote_procedure m_open_phonebook;
     tl::remote_procedure m_close_phonebook;
     tl::remote_procedure m_destroy_phonebook;
+    tl::remote_procedure m_snapshot_phonebook;
+    tl::remote_procedure m_restore_phonebook;
+    tl::remote_procedure m_checkpoint_phonebook;
+    tl::remote_procedure m_get_load;
 
     AdminImpl(const tl::engine& engine)
     : m_engine(engine)
@@ -28,6 +32,10 @@ class AdminImpl {
     , m_open_phonebook(m_engine.define("yp_open_phonebook"))
     , m_close_phonebook(m_engine.define("yp_close_phonebook"))
     , m_destroy_phonebook(m_engine.define("yp_destroy_phonebook"))
+    , m_snapshot_phonebook(m_engine.define("yp_snapshot_phonebook"))
+    , m_restore_phonebook(m_engine.define("yp_restore_phonebook"))
+    , m_checkpoint_phonebook(m_engine.define("yp_checkpoint_phonebook"))
+    , m_get_load(m_engine.define("yp_get_load"))
     {}
 
     AdminImpl(margo_instance_id mid)
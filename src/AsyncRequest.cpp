@@ -49,13 +49,17 @@ AsyncRequest& AsyncRequest::operator=(AsyncRequest&& other) {
 void AsyncRequest::wait() const {
     if(not self) throw Exception("Invalid yp::AsyncRequest object");
     if(self->m_waited) return;
-    self->m_wait_callback(*self);
+    // set first, so that a request that failed is not waited
+    // on again (e.g. by the destructor) after having thrown
     self->m_waited = true;
+    self->m_wait_callback(*self);
 }
 
 bool AsyncRequest::completed() const {
     if(not self) throw Exception("Invalid yp::AsyncRequest object");
-    return self->m_async_response.received();
+    if(self->m_completed_callback)
+        return self->m_completed_callback();
+    return self->m_async_response->received();
 }
 
 }
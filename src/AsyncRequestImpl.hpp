@@ -7,6 +7,7 @@
 #define __YP_ASYNC_REQUEST_IMPL_H
 
 #include <functional>
+#include <optional>
 #include <thallium.hpp>
 
 namespace yp {
@@ -18,9 +19,17 @@ struct AsyncRequestImpl {
     AsyncRequestImpl(tl::async_response&& async_response)
     : m_async_response(std::move(async_response)) {}
 
-    tl::async_response                     m_async_response;
+    /**
+     * @brief Constructor for requests that are not backed by an RPC
+     * of their own (e.g. operations coalesced into a batch), for which
+     * m_completed_callback must be set.
+     */
+    AsyncRequestImpl() = default;
+
+    std::optional<tl::async_response>      m_async_response;
     bool                                   m_waited = false;
     std::function<void(AsyncRequestImpl&)> m_wait_callback;
+    std::function<bool()>                  m_completed_callback;
 
 };
 
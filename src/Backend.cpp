@@ -4,6 +4,7 @@
  * See COPYRIGHT in top-level directory.
  */
 #include "yp/Backend.hpp"
+#include "SumKernels.hpp"
 
 namespace tl = thallium;
 
@@ -35,4 +36,144 @@ std::unique_ptr<Backend> PhonebookFactory::openPhonebook(const std::string& back
     return f(engine, config);
 }
 
+Backend::~Backend() {
+    if(m_block_cache) m_block_cache->removeOwner(m_block_cache_owner);
+}
+
+void Backend::setBlockCache(std::shared_ptr<BlockCache> cache) {
+    if(m_block_cache) m_block_cache->removeOwner(m_block_cache_owner);
+    m_block_cache       = std::move(cache);
+    m_block_cache_owner = m_block_cache ? m_block_cache->addOwner() : nullptr;
+}
+
+RequestResult<bool> Backend::computeSumMany(const int32_t* x,
+                                            const int32_t* y,
+                                            int32_t* out,
+                                            uint64_t* overflow,
+                                            size_t n) {
+    RequestResult<bool> result;
+    sumInt32(x, y, out, overflow, n);
+    return result;
+}
+
+RequestResult<bool> Backend::insert(std::string_view name, std::string_view number) {
+    return insert(std::string(name), std::string(number));
+}
+
+RequestResult<std::string> Backend::lookup(std::string_view name) {
+    return lookup(std::string(name));
+}
+
+RequestResult<bool> Backend::erase(std::string_view name) {
+    return erase(std::string(name));
+}
+
+RequestResult<LookupBuffer> Backend::lookupMulti(const std::vector<std::string_view>& names) {
+    RequestResult<LookupBuffer> result;
+    for(auto name : names) {
+        auto found = lookup(name);
+        if(found.success()) {
+            result.value().append(Status::Success, found.value());
+        } else if(found.status() == Status::NotFound) {
+            result.value().append(Status::NotFound);
+        } else {
+            if(found.status() == Status::Error) {
+                result.success() = false;
+                result.error() = std::move(found.error());
+            } else {
+                result.fail(found.status());
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+RequestResult<std::vector<std::pair<std::string, std::string>>>
+Backend::search(const std::string& pattern, uint32_t max_edit_distance, size_t limit) {
+    (void)pattern;
+    (void)max_edit_distance;
+    (void)limit;
+    RequestResult<std::vector<std::pair<std::string, std::string>>> result;
+    result.success() = false;
+    result.error() = "Backend " + name() + " does not support search";
+    return result;
+}
+
+RequestResult<std::vector<std::string>> Backend::reverseLookup(const std::string& number) {
+    RequestResult<std::vector<std::string>> result;
+    auto multi = reverseLookupMulti({ number });
+    if(!multi.success()) {
+        result.success() = false;
+        result.error() = multi.error();
+    } else if(multi.value().empty() || multi.value()[0].empty()) {
+        result.fail(Status::NotFound);
+    } else {
+        result.value() = std::move(multi.value()[0]);
+    }
+    return result;
+}
+
+RequestResult<std::vector<std::vector<std::string>>>
+Backend::reverseLookupMulti(const std::vector<std::string>& numbers) {
+    (void)numbers;
+    RequestResult<std::vector<std::vector<std::string>>> result;
+    result.success() = false;
+    result.error() = "Backend " + name() + " does not support reverse lookups";
+    return result;
+}
+
+RequestResult<ScanResult> Backend::scan(const ScanQuery& query, const tl::pool& pool) {
+    (void)query;
+    (void)pool;
+    RequestResult<ScanResult> result;
+    result.success() = false;
+    result.error() = "Backend " + name() + " does not support scans";
+    return result;
+}
+
+RequestResult<FilterUpdate> Backend::getFilter(uint64_t epoch, uint64_t version) {
+    (void)epoch;
+    (void)version;
+    RequestResult<FilterUpdate> result;
+    result.success() = false;
+    result.error() = "Backend " + name() + " does not support name filters";
+    return result;
+}
+
+size_t Backend::residentBytes() {
+    return 0;
+}
+
+std::string Backend::getStats() {
+    return "{}";
+}
+
+RequestResult<bool> Backend::snapshot(const std::string& path, const tl::pool& pool) {
+    (void)path;
+    (void)pool;
+    RequestResult<bool> result;
+    result.success() = false;
+    result.error() = "Backend " + name() + " does not support snapshots";
+    return result;
+}
+
+RequestResult<bool> Backend::restore(const std::string& path, const tl::pool& pool) {
+    (void)path;
+    (void)pool;
+    RequestResult<bool> result;
+    result.success() = false;
+    result.error() = "Backend " + name() + " does not support snapshots";
+    return result;
+}
+
+RequestResult<bool> Backend::checkpoint(const std::string& directory, const tl::pool& pool) {
+    (void)directory;
+    (void)pool;
+    RequestResult<bool> result;
+    result.success() = false;
+    result.error() = "Backend " + name() + " does not support checkpoints";
+    return result;
+}
+
 }
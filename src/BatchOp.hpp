@@ -0,0 +1,138 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_BATCH_OP_H
+#define __YP_BATCH_OP_H
+
+#include <yp/RequestResult.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace yp {
+
+/**
+ * @brief One of the small operations that a client coalesces into
+ * a single yp_batch RPC. Only the fields used by the kind of
+ * operation are sent.
+ */
+struct BatchOp {
+
+    enum class Kind : uint8_t {
+        ComputeSum = 0,
+        Insert     = 1,
+        Lookup     = 2,
+        Erase      = 3,
+        Unknown    = 0xFF // decoded from an unknown value, never sent
+    };
+
+    static Kind decodeKind(uint8_t k) {
+        return k <= static_cast<uint8_t>(Kind::Erase) ? static_cast<Kind>(k) : Kind::Unknown;
+    }
+
+    Kind        kind = Kind::ComputeSum;
+    int32_t     x    = 0;
+    int32_t     y    = 0;
+    std::string name;
+    std::string number;
+
+    template<typename Archive>
+    void save(Archive& a) const {
+        uint8_t k = static_cast<uint8_t>(kind);
+        a & k;
+        switch(kind) {
+            case Kind::ComputeSum: a & x; a & y; break;
+            case Kind::Insert:     a & name; a & number; break;
+            case Kind::Lookup:
+            case Kind::Erase:      a & name; break;
+            case Kind::Unknown:    break;
+        }
+    }
+
+    template<typename Archive>
+    void load(Archive& a) {
+        uint8_t k;
+        a & k;
+        kind = decodeKind(k);
+        switch(kind) {
+            case Kind::ComputeSum: a & x; a & y; break;
+            case Kind::Insert:     a & name; a & number; break;
+            case Kind::Lookup:
+            case Kind::Erase:      a & name; break;
+            case Kind::Unknown:    break; // its fields cannot be skipped
+        }
+    }
+};
+
+/**
+ * @brief Operations of a yp_batch RPC as decoded by the provider, with
+ * the wire format of std::vector<BatchOp>. Since the fields of an
+ * operation of unknown kind cannot be skipped, decoding stops at the
+ * first one and the list is marked invalid.
+ */
+struct BatchOpList {
+
+    std::vector<BatchOp> ops;
+    bool                 valid = true;
+
+    template<typename Archive>
+    void load(Archive& a) {
+        size_t count;
+        a & count;
+        ops.clear();
+        for(size_t i = 0; i < count; i++) {
+            BatchOp op;
+            a & op;
+            if(op.kind == BatchOp::Kind::Unknown) {
+                valid = false;
+                break;
+            }
+            ops.push_back(std::move(op));
+        }
+    }
+};
+
+/**
+ * @brief Result of a BatchOp, holding the RequestResult that the
+ * corresponding individual RPC would have returned.
+ */
+struct BatchOpResult {
+
+    BatchOp::Kind              kind = BatchOp::Kind::ComputeSum;
+    RequestResult<int32_t>     sum;    // ComputeSum
+    RequestResult<std::string> number; // Lookup
+    RequestResult<bool>        done;   // Insert, Erase
+
+    template<typename Archive>
+    void save(Archive& a) const {
+        uint8_t k = static_cast<uint8_t>(kind);
+        a & k;
+        switch(kind) {
+            case BatchOp::Kind::ComputeSum: a & sum; break;
+            case BatchOp::Kind::Lookup:     a & number; break;
+            case BatchOp::Kind::Insert:
+            case BatchOp::Kind::Erase:      a & done; break;
+            case BatchOp::Kind::Unknown:    break;
+        }
+    }
+
+    template<typename Archive>
+    void load(Archive& a) {
+        uint8_t k;
+        a & k;
+        kind = BatchOp::decodeKind(k);
+        switch(kind) {
+            case BatchOp::Kind::ComputeSum: a & sum; break;
+            case BatchOp::Kind::Lookup:     a & number; break;
+            case BatchOp::Kind::Insert:
+            case BatchOp::Kind::Erase:      a & done; break;
+            case BatchOp::Kind::Unknown:    break;
+        }
+    }
+};
+
+}
+
+#endif
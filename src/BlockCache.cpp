@@ -0,0 +1,249 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "yp/BlockCache.hpp"
+#include "yp/Exception.hpp"
+#include "Hash.hpp"
+
+#include <thallium.hpp>
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace yp {
+
+namespace tl = thallium;
+
+class BlockCacheOwner {
+
+    public:
+
+    std::atomic<size_t>   bytes  = 0;
+    std::atomic<size_t>   blocks = 0;
+    std::atomic<uint64_t> hits   = 0;
+    std::atomic<uint64_t> misses = 0;
+};
+
+namespace {
+
+struct Key {
+    uint64_t file;
+    uint64_t offset;
+
+    bool operator==(const Key& other) const {
+        return file == other.file && offset == other.offset;
+    }
+};
+
+struct KeyHash {
+    size_t operator()(const Key& key) const {
+        return mixHash(key.file * 0x9e3779b97f4a7c15ULL ^ key.offset);
+    }
+};
+
+struct Entry {
+    Key               key;
+    BlockCache::Block block;
+    BlockCache::Owner owner;
+};
+
+}
+
+class BlockCacheImpl {
+
+    public:
+
+    struct Shard {
+        tl::mutex                                                     mutex;
+        std::list<Entry>                                              lru; // most recent first
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        size_t                                                        bytes = 0;
+        // keys of the shard by file and by owner, so that dropping the
+        // blocks of either only visits those blocks
+        std::unordered_map<uint64_t, std::unordered_set<uint64_t>>                  files;
+        std::unordered_map<const BlockCacheOwner*, std::unordered_set<Key, KeyHash>> owners;
+    };
+
+    size_t                m_capacity;
+    size_t                m_shard_capacity;
+    std::vector<Shard>    m_shards;
+    std::atomic<uint64_t> m_next_file = 1;
+    std::atomic<uint64_t> m_hits      = 0;
+    std::atomic<uint64_t> m_misses    = 0;
+
+    BlockCacheImpl(size_t capacity, unsigned num_shards)
+    : m_capacity(capacity)
+    , m_shard_capacity(num_shards ? capacity / num_shards : 0)
+    , m_shards(num_shards) {
+        if(num_shards == 0)
+            throw Exception("The block cache needs at least one shard");
+    }
+
+    Shard& shardOf(const Key& key) {
+        return m_shards[KeyHash()(key) % m_shards.size()];
+    }
+
+    /**
+     * Removes an entry from its shard. The shard's mutex must be held.
+     */
+    static void erase(Shard& shard, std::list<Entry>::iterator it) {
+        size_t size = it->block->size();
+        shard.bytes -= size;
+        it->owner->bytes  -= size;
+        it->owner->blocks -= 1;
+        auto file = shard.files.find(it->key.file);
+        if(file != shard.files.end()) {
+            file->second.erase(it->key.offset);
+            if(file->second.empty()) shard.files.erase(file);
+        }
+        auto owner = shard.owners.find(it->owner.get());
+        if(owner != shard.owners.end()) {
+            owner->second.erase(it->key);
+            if(owner->second.empty()) shard.owners.erase(owner);
+        }
+        shard.index.erase(it->key);
+        shard.lru.erase(it);
+    }
+
+    /**
+     * Removes the entries of the given keys that are in the shard.
+     * The shard's mutex must be held.
+     */
+    template<typename Keys>
+    static void eraseKeys(Shard& shard, const Keys& keys) {
+        for(auto& key : keys) {
+            auto it = shard.index.find(key);
+            if(it != shard.index.end()) erase(shard, it->second);
+        }
+    }
+};
+
+BlockCache::BlockCache(size_t capacity, unsigned num_shards)
+: self(std::make_shared<BlockCacheImpl>(capacity, num_shards)) {}
+
+BlockCache::~BlockCache() = default;
+
+BlockCache::Owner BlockCache::addOwner() {
+    return std::make_shared<BlockCacheOwner>();
+}
+
+void BlockCache::removeOwner(const Owner& owner) {
+    if(!owner) return;
+    for(auto& shard : self->m_shards) {
+        std::lock_guard<tl::mutex> lock(shard.mutex);
+        auto found = shard.owners.find(owner.get());
+        if(found == shard.owners.end()) continue;
+        auto keys = std::move(found->second);
+        shard.owners.erase(found);
+        BlockCacheImpl::eraseKeys(shard, keys);
+    }
+    owner->hits   = 0;
+    owner->misses = 0;
+}
+
+uint64_t BlockCache::newFileId() {
+    return self->m_next_file++;
+}
+
+BlockCache::Block BlockCache::find(const Owner& owner, uint64_t file, uint64_t offset) {
+    if(self->m_shard_capacity == 0) return nullptr;
+    Key key{ file, offset };
+    auto& shard = self->shardOf(key);
+    Block block;
+    {
+        std::lock_guard<tl::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if(it != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            block = it->second->block;
+        }
+    }
+    auto& counter = block ? self->m_hits : self->m_misses;
+    counter += 1;
+    if(owner) {
+        auto& owner_counter = block ? owner->hits : owner->misses;
+        owner_counter += 1;
+    }
+    return block;
+}
+
+void BlockCache::insert(const Owner& owner, uint64_t file, uint64_t offset, Block block) {
+    if(self->m_shard_capacity == 0 || !owner || !block) return;
+    if(block->size() > self->m_shard_capacity) return;
+    Key key{ file, offset };
+    auto& shard = self->shardOf(key);
+    std::lock_guard<tl::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if(it != shard.index.end()) {
+        // inserted concurrently by another reader of the same block
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+    while(!shard.lru.empty() && shard.bytes + block->size() > self->m_shard_capacity)
+        BlockCacheImpl::erase(shard, std::prev(shard.lru.end()));
+    size_t size = block->size();
+    shard.lru.push_front(Entry{ key, std::move(block), owner });
+    shard.index.emplace(key, shard.lru.begin());
+    shard.files[file].insert(offset);
+    shard.owners[owner.get()].insert(key);
+    shard.bytes   += size;
+    owner->bytes  += size;
+    owner->blocks += 1;
+}
+
+void BlockCache::forgetFile(uint64_t file) {
+    if(self->m_shard_capacity == 0) return;
+    for(auto& shard : self->m_shards) {
+        std::lock_guard<tl::mutex> lock(shard.mutex);
+        auto found = shard.files.find(file);
+        if(found == shard.files.end()) continue;
+        std::vector<Key> keys;
+        keys.reserve(found->second.size());
+        for(auto offset : found->second) keys.push_back(Key{ file, offset });
+        shard.files.erase(found);
+        BlockCacheImpl::eraseKeys(shard, keys);
+    }
+}
+
+BlockCacheStats BlockCache::stats(const Owner& owner) const {
+    BlockCacheStats stats;
+    if(!owner) return stats;
+    stats.bytes  = owner->bytes;
+    stats.blocks = owner->blocks;
+    stats.hits   = owner->hits;
+    stats.misses = owner->misses;
+    return stats;
+}
+
+BlockCacheStats BlockCache::totals() const {
+    BlockCacheStats stats;
+    for(auto& shard : self->m_shards) {
+        std::lock_guard<tl::mutex> lock(shard.mutex);
+        stats.bytes  += shard.bytes;
+        stats.blocks += shard.lru.size();
+    }
+    stats.hits   = self->m_hits;
+    stats.misses = self->m_misses;
+    return stats;
+}
+
+size_t BlockCache::capacity() const {
+    return self->m_capacity;
+}
+
+unsigned BlockCache::numShards() const {
+    return static_cast<unsigned>(self->m_shards.size());
+}
+
+BlockCache& BlockCache::disabled() {
+    static BlockCache cache(0, 1);
+    return cache;
+}
+
+}
@@ -13,6 +13,10 @@
 
 #include <thallium/serialization/stl/string.hpp>
 
+#include <ctime>
+#include <memory>
+#include <vector>
+
 namespace tl = thallium;
 
 namespace yp {
@@ -54,13 +58,15 @@ PhonebookHandle Client::makePhonebookHandle(
         bool check) const {
     auto endpoint  = self->m_engine.lookup(address);
     auto ph        = tl::provider_handle(endpoint, provider_id);
-    RequestResult<bool> result;
+    RequestResult<uint32_t> result;
     result.success() = true;
+    result.value() = kInvalidSlotHandle; // resolved on first use
     if(check) {
         result = self->m_check_phonebook.on(ph)(phonebook_id);
     }
     if(result.success()) {
-        auto phonebook_impl = std::make_shared<PhonebookHandleImpl>(self, std::move(ph), phonebook_id);
+        auto phonebook_impl = std::make_shared<PhonebookHandleImpl>(
+            self, std::move(ph), phonebook_id, result.value());
         return PhonebookHandle(phonebook_impl);
     } else {
         throw Exception(result.error());
@@ -68,6 +74,117 @@ PhonebookHandle Client::makePhonebookHandle(
     }
 }
 
+namespace {
+
+/**
+ * @brief State of a broadcast, shared with the ULTs that wait on its
+ * operations (one per operation), which may outlive the call.
+ */
+struct BroadcastState {
+    struct Completion {
+        size_t      index;
+        bool        success;
+        std::string error;
+    };
+    tl::mutex                 mutex;
+    tl::condition_variable    cv;
+    std::vector<Completion>   completed; // not yet seen by broadcastImpl
+    std::vector<AsyncRequest> requests;
+    std::shared_ptr<void>     results;   // where the operations store their results
+};
+
+}
+
+size_t Client::broadcastImpl(
+        size_t count,
+        const std::function<void(size_t, AsyncRequest*)>& issue,
+        const std::function<void(size_t)>& combine,
+        std::shared_ptr<void> results,
+        const BroadcastOptions& options,
+        std::vector<std::pair<size_t, std::string>>* errors) const {
+    if(errors) errors->clear();
+    auto fail = [errors](size_t i, const std::string& error) {
+        if(errors) errors->emplace_back(i, error);
+    };
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    auto ns = static_cast<long long>(options.timeout_ms * 1e6) + deadline.tv_nsec;
+    deadline.tv_sec  += ns / 1000000000;
+    deadline.tv_nsec  = ns % 1000000000;
+    auto expired = [&deadline]() {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        return now.tv_sec > deadline.tv_sec
+            || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec);
+    };
+    auto state = std::make_shared<BroadcastState>();
+    state->requests.resize(count);
+    state->results = std::move(results);
+    // all the operations are in flight before the first one is waited on,
+    // each by a ULT that reports its completion to this one
+    std::vector<bool> pending(count, false);
+    size_t num_pending = 0;
+    auto pool = self->m_engine.get_handler_pool();
+    for(size_t i = 0; i < count; i++) {
+        try {
+            issue(i, &state->requests[i]);
+        } catch(const std::exception& ex) {
+            fail(i, ex.what());
+            continue;
+        }
+        pending[i] = true;
+        num_pending += 1;
+        pool.make_thread([state, i]() {
+            BroadcastState::Completion completion{i, true, std::string()};
+            try {
+                state->requests[i].wait();
+            } catch(const std::exception& ex) {
+                completion.success = false;
+                completion.error   = ex.what();
+            }
+            std::lock_guard<tl::mutex> lock(state->mutex);
+            state->completed.push_back(std::move(completion));
+            state->cv.notify_one();
+        }, tl::anonymous());
+    }
+    size_t combined = 0;
+    bool done = false;
+    std::unique_lock<tl::mutex> lock(state->mutex);
+    while(num_pending > 0 && !done) {
+        if(state->completed.empty()) {
+            if(options.timeout_ms <= 0) {
+                state->cv.wait(lock);
+            } else if(!expired()) {
+                state->cv.wait_until(lock, &deadline);
+            } else {
+                for(size_t i = 0; i < count; i++)
+                    if(pending[i]) fail(i, "Deadline expired");
+                break;
+            }
+            continue;
+        }
+        auto completed = std::move(state->completed);
+        state->completed.clear();
+        lock.unlock();
+        for(auto& completion : completed) {
+            pending[completion.index] = false;
+            num_pending -= 1;
+            if(!completion.success) {
+                fail(completion.index, completion.error);
+                continue;
+            }
+            combine(completion.index);
+            combined += 1;
+            done = options.stop_on_first_hit;
+            if(done) break;
+        }
+        lock.lock();
+    }
+    // operations still pending are left to their ULTs, which keep the
+    // requests and the results alive
+    return combined;
+}
+
 std::string Client::getConfig() const {
     return "{}";
 }
@@ -23,12 +23,44 @@ class ClientImpl {
     tl::remote_procedure m_check_phonebook;
     tl::remote_procedure m_say_hello;
     tl::remote_procedure m_compute_sum;
+    tl::remote_procedure m_compute_sum_many;
+    tl::remote_procedure m_insert;
+    tl::remote_procedure m_lookup;
+    tl::remote_procedure m_lookup_multi;
+    tl::remote_procedure m_erase;
+    tl::remote_procedure m_search;
+    tl::remote_procedure m_reverse_lookup;
+    tl::remote_procedure m_reverse_lookup_multi;
+    tl::remote_procedure m_scan;
+    tl::remote_procedure m_get_stats;
+    tl::remote_procedure m_batch;
+    tl::remote_procedure m_insert_noack;
+    tl::remote_procedure m_erase_noack;
+    tl::remote_procedure m_flush_writes;
+    tl::remote_procedure m_end_write_session;
+    tl::remote_procedure m_get_filter;
 
     ClientImpl(const tl::engine& engine)
     : m_engine(engine)
     , m_check_phonebook(m_engine.define("yp_check_phonebook"))
     , m_say_hello(m_engine.define("yp_say_hello").disable_response())
     , m_compute_sum(m_engine.define("yp_compute_sum"))
+    , m_compute_sum_many(m_engine.define("yp_compute_sum_many"))
+    , m_insert(m_engine.define("yp_insert"))
+    , m_lookup(m_engine.define("yp_lookup"))
+    , m_lookup_multi(m_engine.define("yp_lookup_multi"))
+    , m_erase(m_engine.define("yp_erase"))
+    , m_search(m_engine.define("yp_search"))
+    , m_reverse_lookup(m_engine.define("yp_reverse_lookup"))
+    , m_reverse_lookup_multi(m_engine.define("yp_reverse_lookup_multi"))
+    , m_scan(m_engine.define("yp_scan"))
+    , m_get_stats(m_engine.define("yp_get_stats"))
+    , m_batch(m_engine.define("yp_batch"))
+    , m_insert_noack(m_engine.define("yp_insert_noack").disable_response())
+    , m_erase_noack(m_engine.define("yp_erase_noack").disable_response())
+    , m_flush_writes(m_engine.define("yp_flush_writes"))
+    , m_end_write_session(m_engine.define("yp_end_write_session").disable_response())
+    , m_get_filter(m_engine.define("yp_get_filter"))
     {}
 
     ClientImpl(margo_instance_id mid)
@@ -0,0 +1,126 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "Coalescer.hpp"
+#include "ClientImpl.hpp"
+#include "PhonebookHandleImpl.hpp"
+#include "yp/Exception.hpp"
+
+#include <thallium/serialization/stl/string.hpp>
+#include <thallium/serialization/stl/vector.hpp>
+
+namespace yp {
+
+void Batch::send() {
+    std::lock_guard<tl::mutex> lock(m_mutex);
+    sendLocked();
+}
+
+void Batch::sendLocked() {
+    if(m_sent) return;
+    auto& rpc = m_handle->m_client->m_batch;
+    m_response = rpc.on(m_handle->m_ph).async(m_handle->slotHandle(), m_ops);
+    m_sent = true;
+}
+
+const BatchOpResult& Batch::wait(size_t index) {
+    std::lock_guard<tl::mutex> lock(m_mutex);
+    sendLocked();
+    if(!m_done) {
+        // the response can only be waited on once, so failures
+        // are recorded for the other operations of the batch
+        try {
+            auto& rpc = m_handle->m_client->m_batch;
+            m_results = m_handle->retryIfStale<RequestResult<std::vector<BatchOpResult>>>(
+                m_response->wait(), rpc, m_ops);
+        } catch(const std::exception& ex) {
+            m_results.success() = false;
+            m_results.error() = ex.what();
+        }
+        m_done = true;
+    }
+    if(!m_results.success())
+        throw Exception(m_results.error());
+    if(index >= m_results.value().size()
+    || m_results.value()[index].kind != m_ops[index].kind)
+        throw Exception("Invalid batch response");
+    return m_results.value()[index];
+}
+
+bool Batch::completed() const {
+    return m_done || (m_sent && m_response->received());
+}
+
+std::shared_ptr<AsyncRequestImpl> Coalescer::add(
+        const std::shared_ptr<PhonebookHandleImpl>& handle,
+        BatchOp&& op,
+        std::function<void(const BatchOpResult&)> complete)
+{
+    std::shared_ptr<Batch> batch;
+    size_t index;
+    bool first = false, full = false;
+    {
+        std::lock_guard<tl::mutex> lock(m_mutex);
+        if(!m_current) {
+            m_current = std::make_shared<Batch>(handle);
+            first = true;
+        }
+        batch = m_current;
+        index = batch->add(std::move(op));
+        if(batch->size() >= m_max_ops) {
+            m_current.reset();
+            full = true;
+        }
+    }
+    if(full) {
+        batch->send();
+    } else if(first) {
+        // flushes the batch when the delay expires, unless it was sent
+        // in the meantime; the ULT yields while it sleeps
+        std::weak_ptr<Coalescer> weak = shared_from_this();
+        auto engine = handle->m_client->m_engine;
+        double delay_ms = m_max_delay_us / 1000.0;
+        engine.get_handler_pool().make_thread([weak, batch, engine, delay_ms]() {
+            tl::thread::sleep(engine, delay_ms);
+            auto coalescer = weak.lock();
+            try {
+                if(coalescer) coalescer->flush(batch);
+                else batch->send();
+            } catch(...) {
+                // the error is reported when the operations are waited on
+            }
+        }, tl::anonymous());
+    }
+    auto async_request_impl = std::make_shared<AsyncRequestImpl>();
+    async_request_impl->m_wait_callback =
+        [batch, index, complete](AsyncRequestImpl&) {
+            complete(batch->wait(index));
+        };
+    async_request_impl->m_completed_callback =
+        [batch]() {
+            return batch->completed();
+        };
+    return async_request_impl;
+}
+
+void Coalescer::flush() {
+    std::shared_ptr<Batch> batch;
+    {
+        std::lock_guard<tl::mutex> lock(m_mutex);
+        batch.swap(m_current);
+    }
+    if(batch) batch->send();
+}
+
+void Coalescer::flush(const std::shared_ptr<Batch>& batch) {
+    {
+        std::lock_guard<tl::mutex> lock(m_mutex);
+        if(m_current != batch) return; // already sent
+        m_current.reset();
+    }
+    batch->send();
+}
+
+}
@@ -0,0 +1,124 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_COALESCER_H
+#define __YP_COALESCER_H
+
+#include "AsyncRequestImpl.hpp"
+#include "BatchOp.hpp"
+#include <yp/RequestResult.hpp>
+#include <thallium.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace yp {
+
+namespace tl = thallium;
+
+class PhonebookHandleImpl;
+
+/**
+ * @brief A Batch is a group of operations sent to a phonebook
+ * in a single yp_batch RPC. It is sent once, either when the
+ * Coalescer that filled it lets it go or when one of its
+ * operations is waited on, whichever comes first.
+ */
+class Batch {
+
+    public:
+
+    Batch(const std::shared_ptr<PhonebookHandleImpl>& handle)
+    : m_handle(handle) {}
+
+    /**
+     * @brief Adds an operation and returns its index. Must not be
+     * called once the batch has been handed to send().
+     */
+    size_t add(BatchOp&& op) {
+        m_ops.push_back(std::move(op));
+        return m_ops.size() - 1;
+    }
+
+    size_t size() const {
+        return m_ops.size();
+    }
+
+    /**
+     * @brief Sends the batch, if it has not been sent yet.
+     */
+    void send();
+
+    /**
+     * @brief Sends the batch if needed, waits for its response and
+     * returns the result of the operation at the given index. Throws
+     * an Exception if the batch as a whole failed.
+     */
+    const BatchOpResult& wait(size_t index);
+
+    /**
+     * @brief Whether the response of the batch has arrived.
+     */
+    bool completed() const;
+
+    private:
+
+    void sendLocked();
+
+    tl::mutex                                 m_mutex;
+    std::shared_ptr<PhonebookHandleImpl>      m_handle;
+    std::vector<BatchOp>                      m_ops;
+    std::optional<tl::async_response>         m_response;
+    RequestResult<std::vector<BatchOpResult>> m_results;
+    std::atomic<bool>                         m_sent{false};
+    std::atomic<bool>                         m_done{false};
+};
+
+/**
+ * @brief A Coalescer buffers the small asynchronous operations issued
+ * through a PhonebookHandle, in the manner of Nagle's algorithm: the
+ * first operation of a batch starts a timer, and the batch is sent
+ * when it holds max_ops operations or when the timer expires after
+ * max_delay_us microseconds, whichever comes first. Waiting on one
+ * of the operations sends its batch right away.
+ */
+class Coalescer : public std::enable_shared_from_this<Coalescer> {
+
+    public:
+
+    Coalescer(size_t max_ops, double max_delay_us)
+    : m_max_ops(max_ops ? max_ops : 1)
+    , m_max_delay_us(max_delay_us) {}
+
+    /**
+     * @brief Adds an operation to the current batch and returns the
+     * implementation of an AsyncRequest that calls complete with the
+     * result of the operation when waited on.
+     */
+    std::shared_ptr<AsyncRequestImpl> add(
+            const std::shared_ptr<PhonebookHandleImpl>& handle,
+            BatchOp&& op,
+            std::function<void(const BatchOpResult&)> complete);
+
+    /**
+     * @brief Sends the current batch, if any.
+     */
+    void flush();
+
+    private:
+
+    void flush(const std::shared_ptr<Batch>& batch);
+
+    tl::mutex              m_mutex;
+    size_t                 m_max_ops;
+    double                 m_max_delay_us;
+    std::shared_ptr<Batch> m_current;
+};
+
+}
+
+#endif
@@ -0,0 +1,364 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "CompactStore.hpp"
+#include "Hash.hpp"
+#include "yp/Exception.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace yp {
+
+static constexpr uint32_t kNone           = SlabArena::kNone;
+static constexpr size_t   kMinPrefix      = 4;
+static constexpr size_t   kMaxDigits      = 15;
+static constexpr uint64_t kPackedFlag     = uint64_t(1) << 63;
+static constexpr uint64_t kPlusFlag       = uint64_t(1) << 62;
+static constexpr int      kDigitsShift    = 58;
+static constexpr uint64_t kValueMask      = (uint64_t(1) << 50) - 1;
+
+static uint32_t hash32(const char* data, size_t size) {
+    // the low bits of the hash select the shard, use the high ones
+    return static_cast<uint32_t>(hashBytes(data, size) >> 32);
+}
+
+static size_t stemLength(std::string_view name) {
+    size_t digits = name.size();
+    while(digits > 0 && name[digits-1] >= '0' && name[digits-1] <= '9') digits--;
+    if(digits == name.size()) digits = 0;
+    size_t sep = name.find_last_of(" ,.-_/@'");
+    size_t stem = std::max(digits, sep == std::string_view::npos ? 0 : sep + 1);
+    if(stem < kMinPrefix || stem >= name.size()) return 0;
+    return stem;
+}
+
+static size_t tableCapacity(size_t n) {
+    size_t capacity = 16;
+    while(capacity * 3 < n * 4) capacity *= 2;
+    return capacity;
+}
+
+// Removes slot i from a linear-probing table by shifting back
+// the following entries of the cluster that can take its place.
+template<typename T>
+static void eraseSlot(std::vector<T>& table, size_t i, uint32_t T::*key) {
+    size_t mask = table.size() - 1;
+    size_t j = i;
+    while(true) {
+        j = (j + 1) & mask;
+        if(table[j].*key == kNone) break;
+        size_t home = table[j].hash & mask;
+        if(((j - home) & mask) >= ((j - i) & mask)) {
+            table[i] = table[j];
+            i = j;
+        }
+    }
+    table[i].*key = kNone;
+}
+
+uint32_t CompactStore::append(uint32_t prefix, const char* data, size_t size) {
+    char header[10];
+    size_t header_size = 0;
+    uint64_t value = (uint64_t(size) << 1) | (prefix != kNone);
+    do {
+        char byte = value & 0x7F;
+        value >>= 7;
+        header[header_size++] = value ? (byte | 0x80) : byte;
+    } while(value);
+    size_t prefix_size = prefix != kNone ? sizeof(prefix) : 0;
+    uint32_t ref = m_arena.allocate(header_size + prefix_size + size);
+    char* p = m_arena.data(ref);
+    std::memcpy(p, header, header_size);
+    std::memcpy(p + header_size, &prefix, prefix_size);
+    std::memcpy(p + header_size + prefix_size, data, size);
+    return ref;
+}
+
+CompactStore::Record CompactStore::record(uint32_t ref) const {
+    Record r;
+    const char* start = m_arena.data(ref);
+    const char* p = start;
+    uint64_t header = 0;
+    int shift = 0;
+    unsigned char byte;
+    do {
+        byte = static_cast<unsigned char>(*p++);
+        header |= uint64_t(byte & 0x7F) << shift;
+        shift += 7;
+    } while(byte & 0x80);
+    r.prefix = kNone;
+    r.prefix_pos = p - start;
+    if(header & 1) {
+        std::memcpy(&r.prefix, p, sizeof(r.prefix));
+        p += sizeof(r.prefix);
+    }
+    r.size = header >> 1;
+    r.data = p;
+    r.record_size = (p - start) + r.size;
+    return r;
+}
+
+void CompactStore::setPrefix(uint32_t ref, uint32_t prefix) {
+    auto r = record(ref);
+    std::memcpy(m_arena.data(ref) + r.prefix_pos, &prefix, sizeof(prefix));
+}
+
+std::string CompactStore::decode(uint32_t ref) const {
+    auto r = record(ref);
+    std::string result;
+    if(r.prefix != kNone) {
+        auto p = record(r.prefix);
+        result.reserve(p.size + r.size);
+        result.append(p.data, p.size);
+    }
+    result.append(r.data, r.size);
+    return result;
+}
+
+bool CompactStore::equals(uint32_t ref, std::string_view str) const {
+    auto r = record(ref);
+    size_t prefix_size = 0;
+    if(r.prefix != kNone) {
+        auto p = record(r.prefix);
+        prefix_size = p.size;
+        if(str.size() < prefix_size || std::memcmp(str.data(), p.data, p.size) != 0)
+            return false;
+    }
+    return str.size() == prefix_size + r.size
+        && std::memcmp(str.data() + prefix_size, r.data, r.size) == 0;
+}
+
+size_t CompactStore::find(std::string_view name, uint32_t hash) const {
+    if(m_slots.empty()) return m_slots.size();
+    size_t mask = m_slots.size() - 1;
+    for(size_t i = hash & mask; m_slots[i].name != kNone; i = (i + 1) & mask) {
+        if(m_slots[i].hash == hash && equals(m_slots[i].name, name))
+            return i;
+    }
+    return m_slots.size();
+}
+
+uint32_t CompactStore::intern(const char* data, size_t size) {
+    if((m_interned_count + 1) * 4 > m_interned.size() * 3)
+        rehashInterned(tableCapacity(m_interned_count + 1));
+    uint32_t hash = hash32(data, size);
+    size_t mask = m_interned.size() - 1;
+    size_t i = hash & mask;
+    for(; m_interned[i].record != kNone; i = (i + 1) & mask) {
+        auto& slot = m_interned[i];
+        if(slot.hash != hash) continue;
+        auto r = record(slot.record);
+        if(r.size == size && std::memcmp(r.data, data, size) == 0) {
+            slot.refs += 1;
+            return slot.record;
+        }
+    }
+    m_interned[i].hash   = hash;
+    m_interned[i].record = append(kNone, data, size);
+    m_interned[i].refs   = 1;
+    m_interned_count += 1;
+    return m_interned[i].record;
+}
+
+void CompactStore::release(uint32_t ref) {
+    auto r = record(ref);
+    uint32_t hash = hash32(r.data, r.size);
+    size_t mask = m_interned.size() - 1;
+    size_t i = hash & mask;
+    while(m_interned[i].record != ref) i = (i + 1) & mask;
+    if(--m_interned[i].refs > 0) return;
+    eraseSlot(m_interned, i, &Interned::record);
+    m_interned_count -= 1;
+    m_arena.free(ref, r.record_size);
+}
+
+void CompactStore::releaseName(uint32_t ref) {
+    auto r = record(ref);
+    uint32_t prefix = r.prefix;
+    m_arena.free(ref, r.record_size);
+    if(prefix != kNone) release(prefix);
+}
+
+uint64_t CompactStore::encodeNumber(std::string_view number) {
+    bool plus = !number.empty() && number[0] == '+';
+    size_t digits = number.size() - plus;
+    bool packable = digits > 0 && digits <= kMaxDigits;
+    uint64_t value = 0;
+    for(size_t i = plus; packable && i < number.size(); i++) {
+        if(number[i] < '0' || number[i] > '9') packable = false;
+        else value = value * 10 + (number[i] - '0');
+    }
+    if(!packable)
+        return intern(number.data(), number.size());
+    m_packed += 1;
+    return kPackedFlag | (plus ? kPlusFlag : 0)
+         | (uint64_t(digits) << kDigitsShift) | value;
+}
+
+std::string CompactStore::decodeNumber(uint64_t number) const {
+    if(!(number & kPackedFlag))
+        return decode(static_cast<uint32_t>(number));
+    bool plus = number & kPlusFlag;
+    size_t digits = (number >> kDigitsShift) & 0xF;
+    uint64_t value = number & kValueMask;
+    std::string result(plus + digits, '+');
+    for(size_t i = 0; i < digits; i++) {
+        result[result.size() - 1 - i] = '0' + (value % 10);
+        value /= 10;
+    }
+    return result;
+}
+
+void CompactStore::releaseNumber(uint64_t number) {
+    if(number & kPackedFlag) m_packed -= 1;
+    else release(static_cast<uint32_t>(number));
+}
+
+void CompactStore::rehash(size_t capacity) {
+    std::vector<Slot> slots(capacity, Slot{0, kNone, 0});
+    size_t mask = capacity - 1;
+    for(auto& slot : m_slots) {
+        if(slot.name == kNone) continue;
+        size_t i = slot.hash & mask;
+        while(slots[i].name != kNone) i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+    m_slots.swap(slots);
+}
+
+void CompactStore::rehashInterned(size_t capacity) {
+    std::vector<Interned> interned(capacity, Interned{0, kNone, 0});
+    size_t mask = capacity - 1;
+    for(auto& slot : m_interned) {
+        if(slot.record == kNone) continue;
+        size_t i = slot.hash & mask;
+        while(interned[i].record != kNone) i = (i + 1) & mask;
+        interned[i] = slot;
+    }
+    m_interned.swap(interned);
+}
+
+size_t CompactStore::compact(double threshold) {
+    uint32_t slab = m_arena.pickSlab(threshold);
+    if(slab == kNone) return 0;
+    // the live records will be copied as is, so once this succeeds
+    // none of the allocations below can fail halfway through
+    m_arena.reserve(m_arena.liveBytes(slab), slab);
+    auto inSlab = [slab](uint32_t ref) {
+        return ref != kNone && SlabArena::slabOf(ref) == slab;
+    };
+    // move the interned records first, since name records refer to them
+    std::unordered_map<uint32_t, uint32_t> moved;
+    for(auto& slot : m_interned) {
+        if(!inSlab(slot.record)) continue;
+        auto r = record(slot.record);
+        uint32_t ref = append(kNone, r.data, r.size);
+        moved[slot.record] = ref;
+        slot.record = ref;
+    }
+    auto remap = [&moved](uint32_t ref) {
+        auto it = moved.find(ref);
+        return it == moved.end() ? ref : it->second;
+    };
+    for(auto& slot : m_slots) {
+        if(slot.name == kNone) continue;
+        if(!(slot.number & kPackedFlag))
+            slot.number = remap(static_cast<uint32_t>(slot.number));
+        auto r = record(slot.name);
+        uint32_t prefix = r.prefix == kNone ? kNone : remap(r.prefix);
+        if(inSlab(slot.name))
+            slot.name = append(prefix, r.data, r.size);
+        else if(prefix != r.prefix)
+            setPrefix(slot.name, prefix);
+    }
+    m_arena.releaseSlab(slab);
+    return SlabArena::kSlabSize;
+}
+
+bool CompactStore::insert(std::string_view name, std::string_view number) {
+    uint32_t hash = hash32(name.data(), name.size());
+    size_t index = find(name, hash);
+    if(index != m_slots.size()) {
+        auto& slot = m_slots[index];
+        uint64_t encoded = encodeNumber(number);
+        releaseNumber(slot.number);
+        slot.number = encoded;
+        return false;
+    }
+    if((m_count + 1) * 4 > m_slots.size() * 3)
+        rehash(tableCapacity(m_count + 1));
+    size_t stem = stemLength(name);
+    uint32_t prefix = stem ? intern(name.data(), stem) : kNone;
+    Slot slot;
+    slot.hash = hash;
+    try {
+        slot.name = append(prefix, name.data() + stem, name.size() - stem);
+    } catch(...) {
+        if(prefix != kNone) release(prefix);
+        throw;
+    }
+    try {
+        slot.number = encodeNumber(number);
+    } catch(...) {
+        releaseName(slot.name);
+        throw;
+    }
+    size_t mask = m_slots.size() - 1;
+    size_t i = hash & mask;
+    while(m_slots[i].name != kNone) i = (i + 1) & mask;
+    m_slots[i] = slot;
+    m_count += 1;
+    return true;
+}
+
+bool CompactStore::lookup(std::string_view name, std::string* number) const {
+    size_t index = find(name, hash32(name.data(), name.size()));
+    if(index == m_slots.size()) return false;
+    if(number) *number = decodeNumber(m_slots[index].number);
+    return true;
+}
+
+bool CompactStore::erase(std::string_view name) {
+    size_t index = find(name, hash32(name.data(), name.size()));
+    if(index == m_slots.size()) return false;
+    releaseName(m_slots[index].name);
+    releaseNumber(m_slots[index].number);
+    eraseSlot(m_slots, index, &Slot::name);
+    m_count -= 1;
+    if(m_slots.size() > 16 && m_count * 8 < m_slots.size())
+        rehash(tableCapacity(m_count * 2));
+    return true;
+}
+
+void CompactStore::reserve(size_t n) {
+    size_t capacity = tableCapacity(n);
+    if(capacity > m_slots.size()) rehash(capacity);
+}
+
+void CompactStore::forEach(const std::function<void(const std::string&, const std::string&)>& f) const {
+    for(auto& slot : m_slots) {
+        if(slot.name == kNone) continue;
+        f(decode(slot.name), decodeNumber(slot.number));
+    }
+}
+
+EntryStore::Stats CompactStore::stats() const {
+    Stats s;
+    s.num_entries   = m_count;
+    s.memory_bytes  = m_slots.capacity() * sizeof(Slot)
+                    + m_interned.capacity() * sizeof(Interned)
+                    + m_arena.residentBytes();
+    s.arena_bytes   = m_arena.mappedBytes();
+    s.live_bytes    = m_arena.liveBytes();
+    s.garbage_bytes = m_arena.garbageBytes();
+    s.slabs         = m_arena.numSlabs();
+    s.interned      = m_interned_count;
+    s.packed        = m_packed;
+    return s;
+}
+
+}
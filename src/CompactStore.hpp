@@ -0,0 +1,116 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_COMPACT_STORE_H
+#define __YP_COMPACT_STORE_H
+
+#include "EntryStore.hpp"
+#include "SlabArena.hpp"
+#include <vector>
+
+namespace yp {
+
+/**
+ * @brief Memory-efficient EntryStore.
+ *
+ * Entries live in an open-addressing table of 16-byte slots holding
+ * the 32-bit hash of the name, the 32-bit reference of the name in a
+ * SlabArena, and the number. Numbers made of an optional '+' followed by
+ * 1 to 15 digits (which covers E.164) are packed into the 64-bit field;
+ * other numbers are stored as text in the arena.
+ *
+ * Arena records are a varint (length << 1 | has_prefix), an optional
+ * 32-bit prefix reference, and the bytes. The stem of a name (everything up
+ * to its last separator or its trailing digits, e.g. "Smith, " or "room")
+ * is stored once and shared by reference. Stems and text numbers are
+ * interned, with a reference count, so duplicates are stored only once.
+ *
+ * Erased records become garbage in their slab. compact() reclaims one
+ * sparse slab at a time by moving its live records to another slab,
+ * so that a background task can defragment the store in short steps.
+ */
+class CompactStore : public EntryStore {
+
+    public:
+
+    bool insert(std::string_view name, std::string_view number) override;
+
+    bool lookup(std::string_view name, std::string* number) const override;
+
+    bool erase(std::string_view name) override;
+
+    size_t size() const override {
+        return m_count;
+    }
+
+    void reserve(size_t n) override;
+
+    void forEach(const std::function<void(const std::string&, const std::string&)>& f) const override;
+
+    Stats stats() const override;
+
+    size_t compact(double threshold) override;
+
+    private:
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t name;   // reference of the name record, kNone if the slot is empty
+        uint64_t number; // packed number, or reference of a text number record
+    };
+
+    struct Interned {
+        uint32_t hash;
+        uint32_t record; // reference of the record, kNone if the slot is empty
+        uint32_t refs;
+    };
+
+    struct Record {
+        uint32_t    prefix;
+        size_t      prefix_pos; // position of the prefix in the record
+        const char* data;
+        size_t      size;
+        size_t      record_size;
+    };
+
+    std::vector<Slot>     m_slots;
+    size_t                m_count = 0;
+    std::vector<Interned> m_interned;
+    size_t                m_interned_count = 0;
+    SlabArena             m_arena;
+    size_t                m_packed = 0;
+
+    uint32_t append(uint32_t prefix, const char* data, size_t size);
+
+    Record record(uint32_t ref) const;
+
+    void setPrefix(uint32_t ref, uint32_t prefix);
+
+    std::string decode(uint32_t ref) const;
+
+    bool equals(uint32_t ref, std::string_view str) const;
+
+    size_t find(std::string_view name, uint32_t hash) const;
+
+    uint32_t intern(const char* data, size_t size);
+
+    void release(uint32_t ref);
+
+    void releaseName(uint32_t ref);
+
+    uint64_t encodeNumber(std::string_view number);
+
+    std::string decodeNumber(uint64_t number) const;
+
+    void releaseNumber(uint64_t number);
+
+    void rehash(size_t capacity);
+
+    void rehashInterned(size_t capacity);
+};
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "yp/CoroPhonebookHandle.hpp"
+#include "yp/Exception.hpp"
+
+namespace yp {
+
+CoroPhonebookHandle::CoroPhonebookHandle(const PhonebookHandle& handle)
+: m_handle(handle) {
+    if(not m_handle) throw Exception("Invalid yp::PhonebookHandle object");
+    m_pool = m_handle.client().engine().get_handler_pool();
+}
+
+CoroPhonebookHandle::CoroPhonebookHandle(const PhonebookHandle& handle,
+                                         const thallium::pool& pool)
+: m_handle(handle)
+, m_pool(pool) {}
+
+Awaitable<int32_t> CoroPhonebookHandle::computeSum(int32_t x, int32_t y) const {
+    Awaitable<int32_t> result(m_pool);
+    m_handle.computeSum(x, y, &result.m_state->value, &result.m_state->request);
+    return result;
+}
+
+Awaitable<void> CoroPhonebookHandle::insert(const std::string& name,
+                                            const std::string& number) const {
+    Awaitable<void> result(m_pool);
+    m_handle.insert(name, number, &result.m_state->request);
+    return result;
+}
+
+Awaitable<std::string> CoroPhonebookHandle::lookup(const std::string& name) const {
+    Awaitable<std::string> result(m_pool);
+    m_handle.lookup(name, &result.m_state->value, &result.m_state->request);
+    return result;
+}
+
+Awaitable<void> CoroPhonebookHandle::lookupMulti(const std::vector<std::string>& names,
+                                                 LookupBuffer* results) const {
+    Awaitable<void> result(m_pool);
+    m_handle.lookupMulti(names, results, &result.m_state->request);
+    return result;
+}
+
+Awaitable<void> CoroPhonebookHandle::erase(const std::string& name) const {
+    Awaitable<void> result(m_pool);
+    m_handle.erase(name, &result.m_state->request);
+    return result;
+}
+
+Awaitable<std::vector<std::pair<std::string, std::string>>>
+CoroPhonebookHandle::search(const std::string& pattern, uint32_t maxEditDistance, size_t limit) const {
+    Awaitable<std::vector<std::pair<std::string, std::string>>> result(m_pool);
+    m_handle.search(pattern, maxEditDistance, limit,
+                    &result.m_state->value, &result.m_state->request);
+    return result;
+}
+
+Awaitable<std::vector<std::string>> CoroPhonebookHandle::reverseLookup(const std::string& number) const {
+    Awaitable<std::vector<std::string>> result(m_pool);
+    m_handle.reverseLookup(number, &result.m_state->value, &result.m_state->request);
+    return result;
+}
+
+Awaitable<ScanResult> CoroPhonebookHandle::scan(const ScanQuery& query) const {
+    Awaitable<ScanResult> result(m_pool);
+    m_handle.scan(query, &result.m_state->value, &result.m_state->request);
+    return result;
+}
+
+}
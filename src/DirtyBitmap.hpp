@@ -0,0 +1,77 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_DIRTY_BITMAP_H
+#define __YP_DIRTY_BITMAP_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+namespace yp {
+
+/**
+ * @brief Fixed-size bitmap of atomic words used to track which
+ * parts (e.g. shards) of a phonebook were modified since the last
+ * checkpoint. Setting a bit is lock-free, and collect() atomically
+ * takes and clears every bit that is set.
+ */
+class DirtyBitmap {
+
+    std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+    size_t                                   m_size;
+
+    size_t numWords() const {
+        return (m_size + 63) / 64;
+    }
+
+    public:
+
+    explicit DirtyBitmap(size_t size)
+    : m_words(new std::atomic<uint64_t>[(size + 63) / 64])
+    , m_size(size) {
+        for(size_t i = 0; i < numWords(); i++)
+            m_words[i].store(0, std::memory_order_relaxed);
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    /**
+     * @brief Marks bit i as dirty.
+     */
+    void set(size_t i) {
+        m_words[i / 64].fetch_or(uint64_t(1) << (i % 64), std::memory_order_release);
+    }
+
+    /**
+     * @brief Marks all the bits as dirty.
+     */
+    void setAll() {
+        for(size_t i = 0; i < m_size; i++) set(i);
+    }
+
+    /**
+     * @brief Clears the bitmap and returns the indices that were set.
+     */
+    std::vector<size_t> collect() {
+        std::vector<size_t> result;
+        for(size_t w = 0; w < numWords(); w++) {
+            uint64_t bits = m_words[w].exchange(0, std::memory_order_acq_rel);
+            while(bits) {
+                int b = __builtin_ctzll(bits);
+                result.push_back(w * 64 + b);
+                bits &= bits - 1;
+            }
+        }
+        return result;
+    }
+};
+
+}
+
+#endif
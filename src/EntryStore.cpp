@@ -0,0 +1,90 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "EntryStore.hpp"
+#include "CompactStore.hpp"
+#include "yp/Exception.hpp"
+
+namespace yp {
+
+EntryStore::Stats& EntryStore::Stats::operator+=(const Stats& other) {
+    num_entries   += other.num_entries;
+    memory_bytes  += other.memory_bytes;
+    arena_bytes   += other.arena_bytes;
+    live_bytes    += other.live_bytes;
+    garbage_bytes += other.garbage_bytes;
+    slabs         += other.slabs;
+    interned      += other.interned;
+    packed        += other.packed;
+    return *this;
+}
+
+std::unique_ptr<EntryStore> EntryStore::create(const std::string& kind) {
+    if(kind == "map")
+        return std::unique_ptr<EntryStore>(new MapStore());
+    if(kind == "compact")
+        return std::unique_ptr<EntryStore>(new CompactStore());
+    throw Exception("Unknown storage type \"" + kind + "\"");
+}
+
+static size_t heapSize(const std::string& str) {
+    // strings that fit in the small-string buffer do not allocate
+    auto self = reinterpret_cast<const char*>(&str);
+    if(str.data() >= self && str.data() < self + sizeof(str)) return 0;
+    return str.capacity() + 1;
+}
+
+// std::unordered_map has no heterogeneous lookup before C++20, so the
+// lookups below build a key, which allocates for names that do not fit
+// in the small-string buffer (use the compact store to avoid it)
+
+bool MapStore::insert(std::string_view name, std::string_view number) {
+    auto it = m_entries.find(std::string(name));
+    if(it != m_entries.end()) {
+        m_heap_bytes -= heapSize(it->second);
+        it->second.assign(number.data(), number.size());
+        m_heap_bytes += heapSize(it->second);
+        return false;
+    }
+    it = m_entries.emplace(name, number).first;
+    m_heap_bytes += heapSize(it->first) + heapSize(it->second);
+    return true;
+}
+
+bool MapStore::lookup(std::string_view name, std::string* number) const {
+    auto it = m_entries.find(std::string(name));
+    if(it == m_entries.end()) return false;
+    if(number) *number = it->second;
+    return true;
+}
+
+bool MapStore::erase(std::string_view name) {
+    auto it = m_entries.find(std::string(name));
+    if(it == m_entries.end()) return false;
+    m_heap_bytes -= heapSize(it->first) + heapSize(it->second);
+    m_entries.erase(it);
+    return true;
+}
+
+void MapStore::forEach(const std::function<void(const std::string&, const std::string&)>& f) const {
+    for(auto& entry : m_entries)
+        f(entry.first, entry.second);
+}
+
+EntryStore::Stats MapStore::stats() const {
+    // estimate of libstdc++'s layout: one node per entry holding
+    // the next pointer, the pair and the cached hash, plus buckets
+    constexpr size_t node_size = sizeof(void*)
+                               + sizeof(std::pair<const std::string, std::string>)
+                               + sizeof(size_t);
+    Stats s;
+    s.num_entries  = m_entries.size();
+    s.memory_bytes = m_entries.bucket_count() * sizeof(void*)
+                   + m_entries.size() * node_size
+                   + m_heap_bytes;
+    return s;
+}
+
+}
@@ -0,0 +1,139 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_ENTRY_STORE_H
+#define __YP_ENTRY_STORE_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+
+namespace yp {
+
+/**
+ * @brief An EntryStore holds the name/number pairs of (a shard of)
+ * an in-memory phonebook. EntryStores are not thread-safe; callers
+ * are expected to protect them with their own lock.
+ */
+class EntryStore {
+
+    public:
+
+    /**
+     * @brief Memory accounting of a store.
+     */
+    struct Stats {
+        size_t num_entries   = 0; // number of name/number pairs
+        size_t memory_bytes  = 0; // bytes allocated by the store
+        size_t arena_bytes   = 0; // bytes mapped for the arena (compact storage)
+        size_t live_bytes    = 0; // bytes of live records in the arena
+        size_t garbage_bytes = 0; // bytes of erased records not yet reclaimed
+        size_t slabs         = 0; // number of slabs of the arena
+        size_t interned      = 0; // distinct interned prefixes and numbers
+        size_t packed        = 0; // numbers stored as integers
+
+        Stats& operator+=(const Stats& other);
+    };
+
+    virtual ~EntryStore() = default;
+
+    /**
+     * @brief Inserts or replaces an entry.
+     *
+     * @return true if the name was not already present.
+     */
+    virtual bool insert(std::string_view name, std::string_view number) = 0;
+
+    /**
+     * @brief Looks up a name.
+     *
+     * @return false if the name is not present.
+     */
+    virtual bool lookup(std::string_view name, std::string* number) const = 0;
+
+    /**
+     * @brief Erases a name.
+     *
+     * @return false if the name was not present.
+     */
+    virtual bool erase(std::string_view name) = 0;
+
+    /**
+     * @brief Number of entries in the store.
+     */
+    virtual size_t size() const = 0;
+
+    /**
+     * @brief Prepares the store to receive n entries in total.
+     */
+    virtual void reserve(size_t n) = 0;
+
+    /**
+     * @brief Calls f(name, number) on every entry.
+     */
+    virtual void forEach(const std::function<void(const std::string&, const std::string&)>& f) const = 0;
+
+    /**
+     * @brief Returns the memory accounting of the store. Must not
+     * iterate over the entries, since it is used for quota checks.
+     */
+    virtual Stats stats() const = 0;
+
+    /**
+     * @brief Performs one step of defragmentation, if the store
+     * supports it, moving data out of a region in which less than
+     * threshold (a fraction) of the bytes are live.
+     *
+     * @return the number of bytes returned to the OS (0 if there
+     * was nothing to do).
+     */
+    virtual size_t compact(double threshold) {
+        (void)threshold;
+        return 0;
+    }
+
+    /**
+     * @brief Creates a store of the requested kind ("map" or "compact").
+     *
+     * @throw yp::Exception if the kind is unknown.
+     */
+    static std::unique_ptr<EntryStore> create(const std::string& kind);
+};
+
+/**
+ * @brief EntryStore based on an std::unordered_map of std::string.
+ */
+class MapStore : public EntryStore {
+
+    std::unordered_map<std::string, std::string> m_entries;
+    size_t m_heap_bytes = 0; // allocated by the strings, kept up to date so that stats() is O(1)
+
+    public:
+
+    bool insert(std::string_view name, std::string_view number) override;
+
+    bool lookup(std::string_view name, std::string* number) const override;
+
+    bool erase(std::string_view name) override;
+
+    size_t size() const override {
+        return m_entries.size();
+    }
+
+    void reserve(size_t n) override {
+        m_entries.reserve(n);
+    }
+
+    void forEach(const std::function<void(const std::string&, const std::string&)>& f) const override;
+
+    Stats stats() const override;
+};
+
+}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_HASH_H
+#define __YP_HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace yp {
+
+/**
+ * @brief 64-bit FNV-1a hash. Unlike std::hash, its value is stable
+ * across builds and platforms, so it can be used for anything that
+ * ends up on disk or on the wire (e.g. shard assignment).
+ *
+ * @param data Pointer to the data to hash.
+ * @param size Size of the data.
+ *
+ * @return a 64-bit hash.
+ */
+inline uint64_t hashBytes(const void* data, size_t size) {
+    auto p = static_cast<const unsigned char*>(data);
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline uint64_t hashBytes(const std::string& str) {
+    return hashBytes(str.data(), str.size());
+}
+
+inline uint64_t hashBytes(std::string_view str) {
+    return hashBytes(str.data(), str.size());
+}
+
+/**
+ * @brief splitmix64 finalizer. FNV-1a does not mix its high bits well
+ * enough for uses that split a hash into several indices (e.g. HyperLogLog
+ * registers, Bloom filter blocks), so its output goes through this first.
+ */
+inline uint64_t mixHash(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "HyperLogLog.hpp"
+#include "Hash.hpp"
+#include <cmath>
+
+namespace yp {
+
+HyperLogLog::HyperLogLog(unsigned precision)
+: m_precision(precision)
+, m_registers(size_t(1) << precision, 0) {}
+
+void HyperLogLog::add(const std::string& value) {
+    uint64_t h = mixHash(hashBytes(value));
+    size_t   index = h >> (64 - m_precision);
+    uint64_t rest  = h << m_precision;
+    uint8_t  rank  = rest == 0 ? 64 - m_precision + 1 : __builtin_clzll(rest) + 1;
+    if(rank > m_registers[index]) m_registers[index] = rank;
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    for(size_t i = 0; i < m_registers.size(); i++)
+        if(other.m_registers[i] > m_registers[i])
+            m_registers[i] = other.m_registers[i];
+}
+
+uint64_t HyperLogLog::estimate() const {
+    double m = static_cast<double>(m_registers.size());
+    double sum = 0.0;
+    size_t zeros = 0;
+    for(auto r : m_registers) {
+        sum += std::ldexp(1.0, -static_cast<int>(r));
+        if(r == 0) zeros++;
+    }
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double e = alpha * m * m / sum;
+    // linear counting is more accurate for small cardinalities
+    if(e <= 2.5 * m && zeros != 0)
+        e = m * std::log(m / static_cast<double>(zeros));
+    return static_cast<uint64_t>(std::llround(e));
+}
+
+}
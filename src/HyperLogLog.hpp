@@ -0,0 +1,42 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_HYPER_LOG_LOG_H
+#define __YP_HYPER_LOG_LOG_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace yp {
+
+/**
+ * @brief HyperLogLog sketch estimating the number of distinct strings
+ * added to it, in 2^precision bytes. The relative standard error is
+ * about 1.04 / sqrt(2^precision), 0.8% with the default precision.
+ * Sketches with the same precision can be merged, which gives the
+ * sketch of the union of their inputs.
+ */
+class HyperLogLog {
+
+    public:
+
+    explicit HyperLogLog(unsigned precision = 14);
+
+    void add(const std::string& value);
+
+    void merge(const HyperLogLog& other);
+
+    uint64_t estimate() const;
+
+    private:
+
+    unsigned             m_precision;
+    std::vector<uint8_t> m_registers;
+};
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_INPUT_STRING_H
+#define __YP_INPUT_STRING_H
+
+#include <thallium.hpp>
+#include <mercury_proc.h>
+#include <string>
+#include <string_view>
+
+namespace yp {
+
+/**
+ * @brief Type to use in place of std::string for the arguments of an
+ * RPC handler, to avoid copying them. It has the same wire format as
+ * std::string, so clients keep sending std::strings, but it decodes as
+ * a view into the Mercury input buffer of the request, which remains
+ * valid until the handler returns. Should the bytes not be contiguous
+ * in the input buffer (e.g. a string straddling the eager buffer and
+ * the overflow buffer of a large request), they are copied instead.
+ */
+class InputString {
+
+    std::string_view m_view;
+    std::string      m_copy; // only used when the bytes could not be viewed
+
+    public:
+
+    InputString() = default;
+
+    InputString(const InputString& other)
+    : m_copy(other.m_copy) {
+        m_view = other.m_view.data() == other.m_copy.data()
+               ? std::string_view(m_copy) : other.m_view;
+    }
+
+    InputString& operator=(const InputString& other) {
+        if(this != &other) {
+            m_copy = other.m_copy;
+            m_view = other.m_view.data() == other.m_copy.data()
+                   ? std::string_view(m_copy) : other.m_view;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Returns a copy that owns its bytes, and may therefore
+     * outlive the request it was decoded from.
+     */
+    InputString detached() const {
+        InputString result;
+        result.m_copy = std::string(m_view);
+        result.m_view = result.m_copy;
+        return result;
+    }
+
+    std::string_view view() const {
+        return m_view;
+    }
+
+    operator std::string_view() const {
+        return m_view;
+    }
+
+    template<typename Archive>
+    void save(Archive& a) const {
+        size_t size = m_view.size();
+        a & size;
+        a.write(m_view.data(), size);
+    }
+
+    template<typename Archive>
+    void load(Archive& a) {
+        size_t size;
+        a & size;
+        m_copy.clear();
+        if(size == 0) {
+            m_view = std::string_view();
+            return;
+        }
+        auto proc = a.get_proc();
+        auto ptr  = static_cast<char*>(hg_proc_save_ptr(proc, size));
+        if(ptr) {
+            // lets Mercury account for the bytes (e.g. in its checksum)
+            hg_proc_restore_ptr(proc, ptr, size);
+            m_view = std::string_view(ptr, size);
+        } else {
+            m_copy.resize(size);
+            a.read(&m_copy[0], size);
+            m_view = m_copy;
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "Intersect.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define YP_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace yp {
+
+static size_t intersectScalar(const uint32_t* a, size_t na,
+                              const uint32_t* b, size_t nb,
+                              uint32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    while(i < na && j < nb) {
+        if(a[i] < b[j]) i++;
+        else if(b[j] < a[i]) j++;
+        else {
+            out[k++] = a[i];
+            i++;
+            j++;
+        }
+    }
+    return k;
+}
+
+#ifdef YP_X86_KERNELS
+
+// Compares a block of 8 values of a with all 8 rotations of a block of
+// b, then advances the block(s) with the smallest maximum. Since values
+// are distinct, each match is found exactly once.
+__attribute__((target("avx2")))
+static size_t intersectAvx2(const uint32_t* a, size_t na,
+                            const uint32_t* b, size_t nb,
+                            uint32_t* out) {
+    size_t i = 0, j = 0, k = 0;
+    const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    while(i + 8 <= na && j + 8 <= nb) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        __m256i match = _mm256_cmpeq_epi32(va, vb);
+        for(int r = 1; r < 8; r++) {
+            vb = _mm256_permutevar8x32_epi32(vb, rotate);
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi32(va, vb));
+        }
+        uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+        while(mask) {
+            out[k++] = a[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+        uint32_t a_max = a[i + 7];
+        uint32_t b_max = b[j + 7];
+        if(a_max <= b_max) i += 8;
+        if(b_max <= a_max) j += 8;
+    }
+    return k + intersectScalar(a + i, na - i, b + j, nb - j, out + k);
+}
+
+#endif
+
+namespace {
+
+using IntersectFn = size_t (*)(const uint32_t*, size_t, const uint32_t*, size_t, uint32_t*);
+
+IntersectFn pickIntersect() {
+#ifdef YP_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return intersectAvx2;
+#endif
+    return intersectScalar;
+}
+
+}
+
+size_t intersectSorted(const uint32_t* a, size_t na,
+                       const uint32_t* b, size_t nb,
+                       uint32_t* out) {
+    static const IntersectFn fn = pickIntersect();
+    return fn(a, na, b, nb, out);
+}
+
+}
@@ -0,0 +1,30 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_INTERSECT_H
+#define __YP_INTERSECT_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace yp {
+
+/**
+ * @brief Intersects two sorted arrays of distinct integers.
+ * out must be able to hold min(na, nb) integers and must not
+ * overlap with a or b.
+ *
+ * The implementation is picked on first use depending on the CPU:
+ * AVX2 (8x8 all-pairs block comparisons) or a scalar merge.
+ *
+ * @return the number of integers written to out.
+ */
+size_t intersectSorted(const uint32_t* a, size_t na,
+                       const uint32_t* b, size_t nb,
+                       uint32_t* out);
+
+}
+
+#endif
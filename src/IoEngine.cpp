@@ -0,0 +1,431 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "yp/IoEngine.hpp"
+#include "yp/Exception.hpp"
+
+#include <thallium.hpp>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace yp {
+
+namespace tl = thallium;
+
+using namespace std::string_literals;
+
+namespace {
+
+constexpr unsigned kMaxQueueDepth = 4096;
+constexpr size_t   kBufferAlign   = 4096; // suitable for O_DIRECT
+constexpr uint64_t kWakeUp        = 0;    // user_data of the NOP stopping the reaper
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                                      flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+/**
+ * Operation waited for by a ULT. Lives on the ULT's stack.
+ */
+struct Pending {
+    tl::eventual<int> result; // res field of the completion
+};
+
+}
+
+class IoEngineImpl {
+
+    public:
+
+    IoEngineOptions m_options;
+    bool              m_io_uring = false;
+
+    // buffers (registered if m_registered)
+    std::vector<char*>     m_buffers;
+    std::vector<unsigned>  m_free_buffers;
+    bool                   m_registered = false;
+    tl::mutex              m_buffers_mtx;
+    tl::condition_variable m_buffers_cv;
+
+    // submission queue, protected by m_submit_mtx
+    int                    m_ring_fd   = -1;
+    void*                  m_sq_ptr    = nullptr;
+    size_t                 m_sq_len    = 0;
+    void*                  m_cq_ptr    = nullptr;
+    size_t                 m_cq_len    = 0;
+    io_uring_sqe*          m_sqes      = nullptr;
+    size_t                 m_sqes_len  = 0;
+    unsigned*              m_sq_tail   = nullptr;
+    unsigned*              m_sq_mask   = nullptr;
+    unsigned*              m_sq_array  = nullptr;
+    unsigned*              m_cq_head   = nullptr;
+    unsigned*              m_cq_tail   = nullptr;
+    unsigned*              m_cq_mask   = nullptr;
+    io_uring_cqe*          m_cqes      = nullptr;
+    unsigned               m_in_flight = 0;
+    tl::mutex              m_submit_mtx;
+    tl::condition_variable m_submit_cv;
+
+    std::thread m_reaper;
+
+    std::atomic<uint64_t> m_submitted     = 0;
+    std::atomic<unsigned> m_max_in_flight = 0;
+
+    IoEngineImpl(const IoEngineOptions& options)
+    : m_options(options) {
+        if(options.type != "io_uring" && options.type != "blocking")
+            throw Exception("Invalid I/O engine type "s + options.type);
+        if(options.queue_depth == 0 || options.queue_depth > kMaxQueueDepth)
+            throw Exception("queue_depth must be between 1 and "s + std::to_string(kMaxQueueDepth));
+        if(options.buffer_size == 0 || options.buffer_size % kBufferAlign)
+            throw Exception("buffer_size must be a positive multiple of "s + std::to_string(kBufferAlign));
+        allocateBuffers();
+        if(options.type == "io_uring") {
+            try {
+                setupRing();
+            } catch(const Exception& ex) {
+                spdlog::warn("Could not set up io_uring ({}), falling back to blocking I/O", ex.what());
+                teardownRing();
+                return;
+            }
+            m_io_uring = true;
+            registerBuffers();
+            m_reaper = std::thread([this]() { reap(); });
+        }
+    }
+
+    ~IoEngineImpl() {
+        if(m_io_uring) {
+            {
+                std::lock_guard<tl::mutex> lock(m_submit_mtx);
+                auto sqe = nextSqe();
+                sqe->opcode    = IORING_OP_NOP;
+                sqe->user_data = kWakeUp;
+                if(!submit()) {
+                    spdlog::critical("Could not stop the I/O engine: {}", std::strerror(errno));
+                    std::abort();
+                }
+            }
+            m_reaper.join();
+        }
+        teardownRing();
+        for(auto buffer : m_buffers) std::free(buffer);
+    }
+
+    void allocateBuffers() {
+        m_buffers.reserve(m_options.num_buffers);
+        for(unsigned i = 0; i < m_options.num_buffers; i++) {
+            void* p = nullptr;
+            if(::posix_memalign(&p, kBufferAlign, m_options.buffer_size) != 0) {
+                for(auto buffer : m_buffers) std::free(buffer);
+                throw Exception("Could not allocate I/O buffers");
+            }
+            m_buffers.push_back(static_cast<char*>(p));
+            m_free_buffers.push_back(m_options.num_buffers - 1 - i);
+        }
+    }
+
+    void setupRing() {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        m_ring_fd = ioUringSetup(m_options.queue_depth, &params);
+        if(m_ring_fd < 0)
+            throw Exception("io_uring_setup: "s + std::strerror(errno));
+        m_sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if(single_mmap) m_sq_len = m_cq_len = std::max(m_sq_len, m_cq_len);
+        m_sq_ptr = ::mmap(nullptr, m_sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          m_ring_fd, IORING_OFF_SQ_RING);
+        if(m_sq_ptr == MAP_FAILED) {
+            m_sq_ptr = nullptr;
+            throw Exception("Could not map the submission queue: "s + std::strerror(errno));
+        }
+        if(single_mmap) {
+            m_cq_ptr = m_sq_ptr;
+        } else {
+            m_cq_ptr = ::mmap(nullptr, m_cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              m_ring_fd, IORING_OFF_CQ_RING);
+            if(m_cq_ptr == MAP_FAILED) {
+                m_cq_ptr = nullptr;
+                throw Exception("Could not map the completion queue: "s + std::strerror(errno));
+            }
+        }
+        m_sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, m_sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            m_ring_fd, IORING_OFF_SQES);
+        if(sqes == MAP_FAILED)
+            throw Exception("Could not map the submission entries: "s + std::strerror(errno));
+        m_sqes = static_cast<io_uring_sqe*>(sqes);
+        auto sq = static_cast<char*>(m_sq_ptr);
+        auto cq = static_cast<char*>(m_cq_ptr);
+        m_sq_tail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sq_mask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        m_cq_head  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cq_tail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_cq_mask  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        m_cqes     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        // the completion queue must be able to hold every operation in flight
+        m_options.queue_depth = std::min(m_options.queue_depth, params.cq_entries);
+    }
+
+    void teardownRing() {
+        if(m_sqes) ::munmap(m_sqes, m_sqes_len);
+        if(m_cq_ptr && m_cq_ptr != m_sq_ptr) ::munmap(m_cq_ptr, m_cq_len);
+        if(m_sq_ptr) ::munmap(m_sq_ptr, m_sq_len);
+        if(m_ring_fd >= 0) ::close(m_ring_fd);
+        m_sqes    = nullptr;
+        m_cq_ptr  = nullptr;
+        m_sq_ptr  = nullptr;
+        m_ring_fd = -1;
+    }
+
+    void registerBuffers() {
+        if(m_buffers.empty()) return;
+        std::vector<iovec> iovecs(m_buffers.size());
+        for(size_t i = 0; i < m_buffers.size(); i++) {
+            iovecs[i].iov_base = m_buffers[i];
+            iovecs[i].iov_len  = m_options.buffer_size;
+        }
+        if(ioUringRegister(m_ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), iovecs.size()) < 0) {
+            // typically RLIMIT_MEMLOCK on older kernels; the buffers still work, unregistered
+            spdlog::warn("Could not register I/O buffers: {}", std::strerror(errno));
+            return;
+        }
+        m_registered = true;
+    }
+
+    /**
+     * Returns the next submission entry, cleared. m_submit_mtx must be
+     * held and an entry must be free, which is the case as long as
+     * m_in_flight < queue_depth since submit() hands entries over to the
+     * kernel right away.
+     */
+    io_uring_sqe* nextSqe() {
+        unsigned tail  = *m_sq_tail;
+        unsigned index = tail & *m_sq_mask;
+        auto sqe = &m_sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        m_sq_array[index] = index;
+        return sqe;
+    }
+
+    /**
+     * Publishes the entry returned by nextSqe() and submits it.
+     * m_submit_mtx must be held. Returns false, with errno set,
+     * if the kernel rejected the entry.
+     */
+    bool submit() {
+        unsigned tail = *m_sq_tail;
+        __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+        int ret;
+        while((ret = ioUringEnter(m_ring_fd, 1, 0, 0)) <= 0) {
+            if(ret == 0 || errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            __atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Submits an operation and suspends the calling ULT until it completes.
+     */
+    ssize_t perform(uint8_t opcode, int fd, const void* data, size_t size,
+                    uint64_t offset, int buffer_index) {
+        Pending pending;
+        {
+            std::unique_lock<tl::mutex> lock(m_submit_mtx);
+            while(m_in_flight >= m_options.queue_depth)
+                m_submit_cv.wait(lock);
+            auto sqe = nextSqe();
+            sqe->opcode    = opcode;
+            sqe->fd        = fd;
+            sqe->addr      = reinterpret_cast<uint64_t>(data);
+            sqe->len       = static_cast<uint32_t>(std::min<size_t>(size, 0x7ffff000));
+            sqe->off       = offset;
+            sqe->user_data = reinterpret_cast<uint64_t>(&pending);
+            if(buffer_index >= 0) sqe->buf_index = static_cast<uint16_t>(buffer_index);
+            if(!submit()) return -1;
+            m_in_flight += 1;
+            m_submitted += 1;
+            if(m_in_flight > m_max_in_flight) m_max_in_flight = m_in_flight;
+        }
+        int res = pending.result.wait();
+        {
+            std::lock_guard<tl::mutex> lock(m_submit_mtx);
+            m_in_flight -= 1;
+            m_submit_cv.notify_one();
+        }
+        if(res < 0) {
+            errno = -res;
+            return -1;
+        }
+        return res;
+    }
+
+    /**
+     * Body of the reaper thread: waits for completions and wakes up the
+     * ULTs waiting for them, until the wake-up NOP completes.
+     */
+    void reap() {
+        while(true) {
+            if(ioUringEnter(m_ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                spdlog::critical("io_uring_enter: {}", std::strerror(errno));
+                std::abort();
+            }
+            unsigned head = *m_cq_head;
+            unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+            bool stop = false;
+            for(; head != tail; head++) {
+                auto& cqe = m_cqes[head & *m_cq_mask];
+                if(cqe.user_data == kWakeUp) {
+                    stop = true;
+                    continue;
+                }
+                reinterpret_cast<Pending*>(cqe.user_data)->result.set_value(cqe.res);
+            }
+            __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+            if(stop) return;
+        }
+    }
+
+    unsigned acquireBuffer() {
+        std::unique_lock<tl::mutex> lock(m_buffers_mtx);
+        while(m_free_buffers.empty())
+            m_buffers_cv.wait(lock);
+        unsigned index = m_free_buffers.back();
+        m_free_buffers.pop_back();
+        return index;
+    }
+
+    void releaseBuffer(unsigned index) {
+        std::lock_guard<tl::mutex> lock(m_buffers_mtx);
+        m_free_buffers.push_back(index);
+        m_buffers_cv.notify_one();
+    }
+};
+
+IoEngine::Buffer::Buffer(Buffer&& other)
+: m_engine(std::move(other.m_engine))
+, m_data(other.m_data)
+, m_size(other.m_size)
+, m_index(other.m_index) {
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+IoEngine::Buffer& IoEngine::Buffer::operator=(Buffer&& other) {
+    if(this == &other) return *this;
+    if(m_engine) m_engine->releaseBuffer(m_index);
+    m_engine = std::move(other.m_engine);
+    m_data   = other.m_data;
+    m_size   = other.m_size;
+    m_index  = other.m_index;
+    other.m_data = nullptr;
+    other.m_size = 0;
+    return *this;
+}
+
+IoEngine::Buffer::~Buffer() {
+    if(m_engine) m_engine->releaseBuffer(m_index);
+}
+
+IoEngine::IoEngine(const IoEngineOptions& options)
+: self(std::make_shared<IoEngineImpl>(options)) {}
+
+IoEngine::~IoEngine() = default;
+
+ssize_t IoEngine::pread(int fd, void* data, size_t size, uint64_t offset) {
+    if(!self->m_io_uring) return ::pread(fd, data, size, offset);
+    return self->perform(IORING_OP_READ, fd, data, size, offset, -1);
+}
+
+ssize_t IoEngine::pwrite(int fd, const void* data, size_t size, uint64_t offset) {
+    if(!self->m_io_uring) return ::pwrite(fd, data, size, offset);
+    return self->perform(IORING_OP_WRITE, fd, data, size, offset, -1);
+}
+
+IoEngine::Buffer IoEngine::acquireBuffer() {
+    if(self->m_buffers.empty())
+        throw Exception("The I/O engine has no buffers");
+    Buffer buffer;
+    buffer.m_index  = self->acquireBuffer();
+    buffer.m_engine = self;
+    buffer.m_data   = self->m_buffers[buffer.m_index];
+    buffer.m_size   = self->m_options.buffer_size;
+    return buffer;
+}
+
+ssize_t IoEngine::pread(int fd, Buffer& buffer, size_t size, uint64_t offset) {
+    size = std::min(size, buffer.size());
+    if(!self->m_io_uring) return ::pread(fd, buffer.data(), size, offset);
+    if(!self->m_registered) return self->perform(IORING_OP_READ, fd, buffer.data(), size, offset, -1);
+    return self->perform(IORING_OP_READ_FIXED, fd, buffer.data(), size, offset, buffer.m_index);
+}
+
+ssize_t IoEngine::pwrite(int fd, const Buffer& buffer, size_t size, uint64_t offset) {
+    size = std::min(size, buffer.size());
+    if(!self->m_io_uring) return ::pwrite(fd, buffer.data(), size, offset);
+    if(!self->m_registered) return self->perform(IORING_OP_WRITE, fd, buffer.data(), size, offset, -1);
+    return self->perform(IORING_OP_WRITE_FIXED, fd, buffer.data(), size, offset, buffer.m_index);
+}
+
+bool IoEngine::usesIoUring() const {
+    return self->m_io_uring;
+}
+
+size_t IoEngine::bufferSize() const {
+    return self->m_options.buffer_size;
+}
+
+const IoEngineOptions& IoEngine::options() const {
+    return self->m_options;
+}
+
+std::string IoEngine::getStats() const {
+    nlohmann::json stats;
+    stats["type"]               = self->m_io_uring ? "io_uring" : "blocking";
+    stats["queue_depth"]        = self->m_options.queue_depth;
+    stats["registered_buffers"] = self->m_registered ? self->m_buffers.size() : 0;
+    stats["submitted"]          = self->m_submitted.load();
+    stats["max_in_flight"]      = self->m_max_in_flight.load();
+    return stats.dump();
+}
+
+IoEngine& IoEngine::blocking() {
+    static IoEngine engine([]() {
+        IoEngineOptions options;
+        options.type        = "blocking";
+        options.num_buffers = 4;
+        return options;
+    }());
+    return engine;
+}
+
+}
@@ -0,0 +1,117 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_LOOKUP_FILTER_H
+#define __YP_LOOKUP_FILTER_H
+
+#include <yp/BloomFilter.hpp>
+#include "Hash.hpp"
+#include <thallium.hpp>
+#include <chrono>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace yp {
+
+namespace tl = thallium;
+
+/**
+ * @brief Client-side copy of the name filter of a phonebook, used to
+ * answer lookups of names that are definitely missing without an RPC.
+ * The copy is refreshed once it is older than max_age_ms, which is the
+ * only bound on how long it may miss names inserted by other clients:
+ * nothing tells the client that the provider's filter changed. Names
+ * inserted through the handle are added to the copy right away, and
+ * added again after the next two refreshes, which may otherwise
+ * overwrite their bits with blocks fetched before the provider applied
+ * the insert.
+ */
+class LookupFilter {
+
+    using clock = std::chrono::steady_clock;
+
+    public:
+
+    explicit LookupFilter(double max_age_ms)
+    : m_max_age(std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double, std::milli>(max_age_ms))) {}
+
+    /**
+     * @brief Whether the copy must be refreshed before being used, i.e.
+     * whether it is empty or older than max_age_ms.
+     */
+    bool stale() const {
+        std::lock_guard<tl::mutex> lock(m_mutex);
+        return m_filter.empty() || clock::now() - m_fetched >= m_max_age;
+    }
+
+    /**
+     * @brief Epoch and version to request the changes since.
+     */
+    std::pair<uint64_t, uint64_t> position() const {
+        std::lock_guard<tl::mutex> lock(m_mutex);
+        return { m_epoch, m_version };
+    }
+
+    /**
+     * @brief Applies an update sent by the provider. Epochs are random
+     * identifiers rather than counters: an update of another epoch
+     * replaces the whole copy (the provider sends it in full), while an
+     * update of the same epoch is skipped if a concurrent refresh has
+     * already applied a more recent one.
+     */
+    void apply(const FilterUpdate& update) {
+        std::lock_guard<tl::mutex> lock(m_mutex);
+        m_fetched = clock::now();
+        if(update.epoch != m_epoch) {
+            if(!update.full) return;
+        } else if(update.version < m_version) {
+            return;
+        }
+        m_filter.apply(update);
+        m_epoch   = update.epoch;
+        m_version = update.version;
+        for(auto h : m_previous_local) m_filter.add(h);
+        for(auto h : m_local) m_filter.add(h);
+        m_previous_local.swap(m_local);
+        m_local.clear();
+    }
+
+    /**
+     * @brief Adds a name inserted through the handle.
+     */
+    void add(std::string_view name) {
+        uint64_t h = mixHash(hashBytes(name));
+        std::lock_guard<tl::mutex> lock(m_mutex);
+        if(!m_filter.empty()) m_filter.add(h);
+        m_local.push_back(h);
+    }
+
+    /**
+     * @brief Returns false if the name is definitely not in the phonebook.
+     */
+    bool mayContain(std::string_view name) const {
+        uint64_t h = mixHash(hashBytes(name));
+        std::lock_guard<tl::mutex> lock(m_mutex);
+        return m_filter.mayContain(h);
+    }
+
+    private:
+
+    mutable tl::mutex     m_mutex;
+    BloomFilter           m_filter;
+    uint64_t              m_epoch   = 0;
+    uint64_t              m_version = 0;
+    std::vector<uint64_t> m_local;          // names inserted since the last refresh
+    std::vector<uint64_t> m_previous_local; // names inserted the refresh before
+    clock::duration       m_max_age;
+    clock::time_point     m_fetched;
+};
+
+}
+
+#endif
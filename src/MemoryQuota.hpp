@@ -0,0 +1,139 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_MEMORY_QUOTA_H
+#define __YP_MEMORY_QUOTA_H
+
+#include "yp/Backend.hpp"
+#include <thallium.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+namespace yp {
+
+namespace tl = thallium;
+
+/**
+ * @brief Memory accounting of the phonebooks of a provider against a
+ * per-phonebook and a per-provider quota (0 meaning no quota). Writes
+ * are admitted as long as neither quota is exceeded. The resident bytes
+ * of a phonebook (Backend::residentBytes()) are only refreshed by its
+ * writes, at most once per refresh interval, and the provider's total is
+ * the sum of the last values, so that admission is cheap; a phonebook
+ * may therefore exceed its quota by the writes of one interval. Since
+ * a phonebook only grows by being written to, the total is never
+ * underestimated by more than that.
+ */
+class MemoryQuota {
+
+    using clock = std::chrono::steady_clock;
+
+    public:
+
+    /**
+     * @brief Accounting of one phonebook.
+     */
+    struct Usage {
+        size_t               limit;        // 0 if none
+        std::atomic<size_t>  bytes{0};     // as of the last refresh
+        std::atomic<int64_t> refreshed{0}; // in clock ticks
+        tl::mutex            mutex;        // serializes refreshes
+        bool                 tracked = true;
+
+        explicit Usage(size_t l)
+        : limit(l) {}
+    };
+
+    MemoryQuota(size_t provider_limit, size_t phonebook_limit, double refresh_interval_ms)
+    : m_provider_limit(provider_limit)
+    , m_phonebook_limit(phonebook_limit)
+    , m_refresh_interval(std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double, std::milli>(refresh_interval_ms)).count()) {}
+
+    /**
+     * @brief Starts accounting for a phonebook, whose quota is the
+     * provided one, or the default per-phonebook quota if 0.
+     */
+    std::shared_ptr<Usage> track(Backend& backend, size_t limit = 0) {
+        auto usage = std::make_shared<Usage>(limit ? limit : m_phonebook_limit);
+        refresh(backend, *usage);
+        return usage;
+    }
+
+    /**
+     * @brief Stops accounting for a phonebook (closed or destroyed).
+     */
+    void untrack(Usage& usage) {
+        std::lock_guard<tl::mutex> lock(usage.mutex);
+        usage.tracked = false;
+        m_total -= usage.bytes.exchange(0);
+    }
+
+    /**
+     * @brief Whether a write to the phonebook may proceed.
+     */
+    bool admit(Backend& backend, Usage& usage) {
+        if(!usage.limit && !m_provider_limit) return true;
+        auto now = clock::now().time_since_epoch().count();
+        if(now - usage.refreshed.load() >= m_refresh_interval && usage.mutex.try_lock()) {
+            std::lock_guard<tl::mutex> lock(usage.mutex, std::adopt_lock);
+            if(usage.tracked) refreshLocked(backend, usage);
+        }
+        if(usage.limit && usage.bytes >= usage.limit) return false;
+        return !m_provider_limit || m_total < m_provider_limit;
+    }
+
+    /**
+     * @brief Whether a new phonebook may be created or opened.
+     */
+    bool admitPhonebook() const {
+        return !m_provider_limit || m_total < m_provider_limit;
+    }
+
+    /**
+     * @brief Refreshes the usage of a phonebook right away (e.g. after
+     * its content was replaced by a restore).
+     */
+    void refresh(Backend& backend, Usage& usage) {
+        std::lock_guard<tl::mutex> lock(usage.mutex);
+        if(usage.tracked) refreshLocked(backend, usage);
+    }
+
+    size_t totalBytes() const {
+        return m_total;
+    }
+
+    size_t providerLimit() const {
+        return m_provider_limit;
+    }
+
+    size_t phonebookLimit() const {
+        return m_phonebook_limit;
+    }
+
+    double refreshIntervalMs() const {
+        return std::chrono::duration<double, std::milli>(clock::duration(m_refresh_interval)).count();
+    }
+
+    private:
+
+    size_t              m_provider_limit   = 0;
+    size_t              m_phonebook_limit  = 0;
+    int64_t             m_refresh_interval = 0; // in clock ticks
+    std::atomic<size_t> m_total{0};
+
+    void refreshLocked(Backend& backend, Usage& usage) {
+        size_t bytes = backend.residentBytes();
+        size_t old   = usage.bytes.exchange(bytes);
+        m_total += bytes - old; // modular arithmetic, in one atomic step
+        usage.refreshed = clock::now().time_since_epoch().count();
+    }
+};
+
+}
+
+#endif
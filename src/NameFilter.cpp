@@ -0,0 +1,89 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "NameFilter.hpp"
+#include "Hash.hpp"
+#include <algorithm>
+#include <mutex>
+#include <random>
+
+namespace yp {
+
+NameFilter::NameFilter(size_t capacity)
+: m_filter(std::max(capacity, kMinCapacity))
+, m_block_versions(m_filter.numBlocks(), 0)
+, m_capacity(std::max(capacity, kMinCapacity)) {}
+
+void NameFilter::add(std::string_view name) {
+    uint64_t h = mixHash(hashBytes(name));
+    std::lock_guard<tl::mutex> lock(m_mutex);
+    m_block_versions[m_filter.add(h)] = ++m_version;
+    if(m_next) m_next->add(h);
+    m_added.fetch_add(1, std::memory_order_relaxed);
+}
+
+FilterUpdate NameFilter::changesSince(uint64_t epoch, uint64_t version) {
+    FilterUpdate update;
+    std::lock_guard<tl::mutex> lock(m_mutex);
+    update.epoch      = m_epoch;
+    update.version    = m_version;
+    update.num_blocks = m_filter.numBlocks();
+    if(epoch != m_epoch || version > m_version) {
+        update.full  = true;
+        update.words = m_filter.words();
+        return update;
+    }
+    if(version == m_version) return update;
+    auto& words = m_filter.words();
+    for(size_t b = 0; b < m_block_versions.size(); b++) {
+        if(m_block_versions[b] <= version) continue;
+        update.blocks.push_back(b);
+        update.words.insert(update.words.end(),
+                            words.begin() + b * BloomFilter::kBlockWords,
+                            words.begin() + (b + 1) * BloomFilter::kBlockWords);
+    }
+    return update;
+}
+
+bool NameFilter::beginRebuild(size_t capacity) {
+    std::lock_guard<tl::mutex> lock(m_mutex);
+    if(m_next) return false;
+    m_next_capacity = std::max(capacity, kMinCapacity);
+    m_next.reset(new BloomFilter(m_next_capacity));
+    return true;
+}
+
+void NameFilter::addToNext(std::string_view name) {
+    uint64_t h = mixHash(hashBytes(name));
+    std::lock_guard<tl::mutex> lock(m_mutex);
+    m_next->add(h);
+}
+
+void NameFilter::endRebuild() {
+    std::lock_guard<tl::mutex> lock(m_mutex);
+    m_filter = std::move(*m_next);
+    m_next.reset();
+    m_block_versions.assign(m_filter.numBlocks(), 0);
+    m_epoch   = newEpoch();
+    m_version = 0;
+    m_capacity.store(m_next_capacity, std::memory_order_relaxed);
+    m_added.store(0, std::memory_order_relaxed);
+}
+
+uint64_t NameFilter::newEpoch() {
+    std::random_device rd;
+    uint64_t epoch = 0;
+    while(epoch == 0)
+        epoch = (static_cast<uint64_t>(rd()) << 32) | rd();
+    return epoch;
+}
+
+size_t NameFilter::memoryUsage() {
+    std::lock_guard<tl::mutex> lock(m_mutex);
+    return m_filter.words().size() * sizeof(uint64_t)
+         + m_block_versions.size() * sizeof(uint64_t);
+}
+
+}
@@ -0,0 +1,103 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_NAME_FILTER_H
+#define __YP_NAME_FILTER_H
+
+#include <yp/BloomFilter.hpp>
+#include <thallium.hpp>
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+namespace yp {
+
+namespace tl = thallium;
+
+/**
+ * @brief Versioned BloomFilter over the names of a backend, from which
+ * clients download incremental updates. Each addition bumps the version
+ * and records it as the version of the block it modified, so the blocks
+ * modified since a client's version are found by comparing versions.
+ * Names are never removed; once more names have been added than the
+ * filter was sized for, the backend rebuilds it from its current names
+ * (which also drops erased names) with beginRebuild/addToNext/endRebuild.
+ * Names added during a rebuild go to both filters. A rebuild starts a
+ * new epoch, for which clients download the whole filter. Epochs are
+ * random (see newEpoch), so that a filter rebuilt by another instance
+ * of the backend (e.g. one reloaded after an eviction or a restart)
+ * never reuses an epoch a client has seen.
+ */
+class NameFilter {
+
+    public:
+
+    static constexpr size_t kMinCapacity = 1024;
+
+    explicit NameFilter(size_t capacity = kMinCapacity);
+
+    /**
+     * @brief Adds a name.
+     */
+    void add(std::string_view name);
+
+    /**
+     * @brief Whether more names were added than the filter was sized for.
+     */
+    bool overloaded() const {
+        return m_added.load(std::memory_order_relaxed) > m_capacity.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Returns the changes since the given version, or the whole
+     * filter if the epoch is not the current one.
+     */
+    FilterUpdate changesSince(uint64_t epoch, uint64_t version);
+
+    /**
+     * @brief Starts a rebuild for the given number of names. Returns
+     * false if a rebuild is already in progress.
+     */
+    bool beginRebuild(size_t capacity);
+
+    /**
+     * @brief Adds a name to the filter being rebuilt.
+     */
+    void addToNext(std::string_view name);
+
+    /**
+     * @brief Replaces the filter with the rebuilt one.
+     */
+    void endRebuild();
+
+    /**
+     * @brief Memory used by the filter, in bytes.
+     */
+    size_t memoryUsage();
+
+    private:
+
+    tl::mutex                    m_mutex;
+    BloomFilter                  m_filter;
+    std::vector<uint64_t>        m_block_versions;
+    uint64_t                     m_epoch   = newEpoch();
+    uint64_t                     m_version = 0;
+    std::atomic<size_t>          m_capacity;
+    std::atomic<size_t>          m_added{0};
+    std::unique_ptr<BloomFilter> m_next; // non-null during a rebuild
+    size_t                       m_next_capacity = 0;
+
+    /**
+     * @brief Random non-zero epoch (0 is the epoch of a client that has
+     * no filter yet).
+     */
+    static uint64_t newEpoch();
+};
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_PARALLEL_H
+#define __YP_PARALLEL_H
+
+#include <thallium.hpp>
+#include <exception>
+#include <vector>
+
+namespace yp {
+
+namespace tl = thallium;
+
+/**
+ * @brief Calls fn(i) for every i in [0, n), each call in its own ULT
+ * pushed into the provided pool, and waits for all of them to complete.
+ * If any call throws, the first exception (by index) is rethrown once
+ * every ULT has completed. If the pool is null or n is 1, the calls are
+ * made sequentially by the caller.
+ *
+ * @tparam F Callable type.
+ * @param pool Pool in which to spawn the ULTs.
+ * @param n Number of calls.
+ * @param fn Function to call.
+ */
+template<typename F>
+void parallelFor(const tl::pool& pool, size_t n, F&& fn) {
+    if(n == 0) return;
+    if(pool.is_null() || n == 1) {
+        for(size_t i = 0; i < n; i++) fn(i);
+        return;
+    }
+    std::vector<std::exception_ptr> errors(n);
+    std::vector<tl::managed<tl::thread>> ults;
+    ults.reserve(n);
+    for(size_t i = 0; i < n; i++) {
+        ults.push_back(pool.make_thread([&fn, &errors, i]() {
+            try {
+                fn(i);
+            } catch(...) {
+                errors[i] = std::current_exception();
+            }
+        }));
+    }
+    for(auto& ult : ults) ult->join();
+    for(auto& error : errors)
+        if(error) std::rethrow_exception(error);
+}
+
+}
+
+#endif
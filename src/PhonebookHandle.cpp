@@ -10,12 +10,122 @@
 #include "AsyncRequestImpl.hpp"
 #include "ClientImpl.hpp"
 #include "PhonebookHandleImpl.hpp"
+#include "Coalescer.hpp"
 
 #include <thallium/serialization/stl/string.hpp>
 #include <thallium/serialization/stl/pair.hpp>
+#include <thallium/serialization/stl/vector.hpp>
+
+#include <functional>
+#include <mutex>
+#include <tuple>
+#include <vector>
 
 namespace yp {
 
+namespace {
+
+/**
+ * @brief Names sent with the wire format of std::vector<std::string>,
+ * without copying them into a vector.
+ */
+struct NameList {
+
+    const std::string* names;
+    size_t             count;
+
+    template<typename Archive>
+    void save(Archive& a) const {
+        a & count;
+        for(size_t i = 0; i < count; i++)
+            a & names[i];
+    }
+};
+
+/**
+ * @brief Decodes a LookupBuffer sent by the provider into the
+ * LookupBuffer given as serialization context.
+ */
+struct LookupBufferSink {
+
+    template<typename Archive>
+    void load(Archive& a) {
+        std::get<0>(a.get_context())->load(a);
+    }
+};
+
+/**
+ * @brief Whether the handle's cached name filter, refreshed if stale,
+ * shows that the name is not in the phonebook.
+ */
+bool isDefiniteMiss(const std::shared_ptr<PhonebookHandleImpl>& self,
+                    const std::string& name) {
+    auto filter = self->lookupFilter(true);
+    return filter && !filter->mayContain(name);
+}
+
+/**
+ * @brief Implementation of an AsyncRequest for a lookup answered
+ * locally, which calls the provided function when waited on.
+ */
+std::shared_ptr<AsyncRequestImpl> missingEntry(std::function<void()> miss) {
+    auto async_request_impl = std::make_shared<AsyncRequestImpl>();
+    async_request_impl->m_wait_callback = [miss](AsyncRequestImpl&) { miss(); };
+    async_request_impl->m_completed_callback = []() { return true; };
+    return async_request_impl;
+}
+
+/**
+ * @brief Common implementation of the lookups into a LookupBuffer.
+ * Returns the implementation of the request if async is true.
+ */
+std::shared_ptr<AsyncRequestImpl> lookupInto(
+        const std::shared_ptr<PhonebookHandleImpl>& self,
+        NameList names,
+        LookupBuffer* results,
+        bool async)
+{
+    auto& rpc = self->m_client->m_lookup_multi;
+    auto& ph  = self->m_ph;
+    using Result = RequestResult<LookupBufferSink>;
+    if(not async) { // synchronous call
+        LookupBuffer ignored;
+        if(results == nullptr) results = &ignored;
+        Result response = self->callWithContext<Result>(results, rpc, names);
+        if(not response.success()) {
+            throw Exception(response.error());
+        }
+        return nullptr;
+    } else { // asynchronous call
+        std::shared_ptr<LookupBuffer> ignored;
+        if(results == nullptr) {
+            ignored = std::make_shared<LookupBuffer>();
+            results = ignored.get();
+        }
+        // the caller's names may be gone by the time a stale handle
+        // makes the wait callback send them again
+        auto owned = std::make_shared<std::vector<std::string>>(
+            names.names, names.names + names.count);
+        names = NameList{ owned->data(), owned->size() };
+        auto async_response = rpc.on(ph).async(self->slotHandle(), names);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [impl = self, &rpc, owned, names, results, ignored](AsyncRequestImpl& async_request_impl) {
+                Result response = impl->retryIfStaleWithContext(
+                    async_request_impl.m_async_response->wait()
+                        .with_serialization_context(results).as<Result>(),
+                    results, rpc, names);
+                if(not response.success()) {
+                    throw Exception(response.error());
+                }
+            };
+        return async_request_impl;
+    }
+}
+
+}
+
 PhonebookHandle::PhonebookHandle() = default;
 
 PhonebookHandle::PhonebookHandle(const std::shared_ptr<PhonebookHandleImpl>& impl)
@@ -43,8 +153,7 @@ void PhonebookHandle::sayHello() const {
     if(not self) throw Exception("Invalid yp::PhonebookHandle object");
     auto& rpc = self->m_client->m_say_hello;
     auto& ph  = self->m_ph;
-    auto& phonebook_id = self->m_phonebook_id;
-    rpc.on(ph)(phonebook_id);
+    rpc.on(ph)(self->slotHandle());
 }
 
 void PhonebookHandle::computeSum(
@@ -55,22 +164,34 @@ void PhonebookHandle::computeSum(
     if(not self) throw Exception("Invalid yp::PhonebookHandle object");
     auto& rpc = self->m_client->m_compute_sum;
     auto& ph  = self->m_ph;
-    auto& phonebook_id = self->m_phonebook_id;
     if(req == nullptr) { // synchronous call
-        RequestResult<int32_t> response = rpc.on(ph)(phonebook_id, x, y);
+        RequestResult<int32_t> response = self->call<RequestResult<int32_t>>(rpc, x, y);
         if(response.success()) {
             if(result) *result = response.value();
         } else {
             throw Exception(response.error());
         }
+    } else if(auto coalescer = self->coalescer()) { // coalesced asynchronous call
+        BatchOp op;
+        op.kind = BatchOp::Kind::ComputeSum;
+        op.x = x;
+        op.y = y;
+        *req = AsyncRequest(coalescer->add(self, std::move(op),
+            [result](const BatchOpResult& r) {
+                if(r.sum.success()) {
+                    if(result) *result = r.sum.value();
+                } else {
+                    throw Exception(r.sum.error());
+                }
+            }));
     } else { // asynchronous call
-        auto async_response = rpc.on(ph).async(phonebook_id, x, y);
+        auto async_response = rpc.on(ph).async(self->slotHandle(), x, y);
         auto async_request_impl =
             std::make_shared<AsyncRequestImpl>(std::move(async_response));
         async_request_impl->m_wait_callback =
-            [result](AsyncRequestImpl& async_request_impl) {
-                RequestResult<int32_t> response =
-                    async_request_impl.m_async_response.wait();
+            [impl = self, &rpc, x, y, result](AsyncRequestImpl& async_request_impl) {
+                RequestResult<int32_t> response = impl->retryIfStale<RequestResult<int32_t>>(
+                    async_request_impl.m_async_response->wait(), rpc, x, y);
                     if(response.success()) {
                         if(result) *result = response.value();
                     } else {
@@ -81,4 +202,437 @@ void PhonebookHandle::computeSum(
     }
 }
 
+void PhonebookHandle::computeSumMany(
+        const int32_t* x, const int32_t* y,
+        int32_t* out, size_t n,
+        uint64_t* overflow,
+        AsyncRequest* req) const
+{
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto& rpc = self->m_client->m_compute_sum_many;
+    auto& ph  = self->m_ph;
+    tl::bulk data;
+    if(n != 0) {
+        // x and y are only read by the server, but a bulk handle has a single mode
+        std::vector<std::pair<void*, size_t>> segments = {
+            { const_cast<int32_t*>(x), n * sizeof(int32_t) },
+            { const_cast<int32_t*>(y), n * sizeof(int32_t) },
+            { out, n * sizeof(int32_t) }
+        };
+        if(overflow)
+            segments.emplace_back(overflow, (n + 63) / 64 * sizeof(uint64_t));
+        data = self->m_client->m_engine.expose(segments, tl::bulk_mode::read_write);
+    }
+    bool with_overflow = overflow != nullptr;
+    if(req == nullptr) { // synchronous call
+        RequestResult<bool> response =
+            self->call<RequestResult<bool>>(rpc, static_cast<uint64_t>(n), with_overflow, data);
+        if(not response.success()) {
+            throw Exception(response.error());
+        }
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(self->slotHandle(), static_cast<uint64_t>(n), with_overflow, data);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [impl = self, &rpc, n, with_overflow, data](AsyncRequestImpl& async_request_impl) {
+                // data keeps the memory registered until the server is done
+                RequestResult<bool> response = impl->retryIfStale<RequestResult<bool>>(
+                    async_request_impl.m_async_response->wait(), rpc, static_cast<uint64_t>(n), with_overflow, data);
+                if(not response.success()) {
+                    throw Exception(response.error());
+                }
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PhonebookHandle::insert(
+        const std::string& name,
+        const std::string& number,
+        AsyncRequest* req) const
+{
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    if(auto filter = self->lookupFilter(false)) filter->add(name);
+    auto& rpc = self->m_client->m_insert;
+    auto& ph  = self->m_ph;
+    if(req == nullptr) { // synchronous call
+        RequestResult<bool> response = self->call<RequestResult<bool>>(rpc, name, number);
+        if(not response.success()) {
+            throw Exception(response.error());
+        }
+    } else if(auto coalescer = self->coalescer()) { // coalesced asynchronous call
+        BatchOp op;
+        op.kind = BatchOp::Kind::Insert;
+        op.name = name;
+        op.number = number;
+        *req = AsyncRequest(coalescer->add(self, std::move(op),
+            [](const BatchOpResult& r) {
+                if(not r.done.success()) {
+                    throw Exception(r.done.error());
+                }
+            }));
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(self->slotHandle(), name, number);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [impl = self, &rpc, name, number](AsyncRequestImpl& async_request_impl) {
+                RequestResult<bool> response = impl->retryIfStale<RequestResult<bool>>(
+                    async_request_impl.m_async_response->wait(), rpc, name, number);
+                if(not response.success()) {
+                    throw Exception(response.error());
+                }
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PhonebookHandle::lookup(
+        const std::string& name,
+        std::string* number,
+        AsyncRequest* req) const
+{
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto& rpc = self->m_client->m_lookup;
+    auto& ph  = self->m_ph;
+    if(isDefiniteMiss(self, name)) { // answered locally
+        if(req == nullptr) throw Exception(statusMessage(Status::NotFound));
+        *req = AsyncRequest(missingEntry([](){
+            throw Exception(statusMessage(Status::NotFound));
+        }));
+    } else if(req == nullptr) { // synchronous call
+        RequestResult<std::string> response = self->call<RequestResult<std::string>>(rpc, name);
+        if(response.success()) {
+            if(number) *number = std::move(response.value());
+        } else {
+            throw Exception(response.error());
+        }
+    } else if(auto coalescer = self->coalescer()) { // coalesced asynchronous call
+        BatchOp op;
+        op.kind = BatchOp::Kind::Lookup;
+        op.name = name;
+        *req = AsyncRequest(coalescer->add(self, std::move(op),
+            [number](const BatchOpResult& r) {
+                if(r.number.success()) {
+                    if(number) *number = r.number.value();
+                } else {
+                    throw Exception(r.number.error());
+                }
+            }));
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(self->slotHandle(), name);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [impl = self, &rpc, name, number](AsyncRequestImpl& async_request_impl) {
+                RequestResult<std::string> response =
+                    impl->retryIfStale<RequestResult<std::string>>(
+                        async_request_impl.m_async_response->wait(), rpc, name);
+                if(response.success()) {
+                    if(number) *number = std::move(response.value());
+                } else {
+                    throw Exception(response.error());
+                }
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PhonebookHandle::lookup(
+        const std::string& name,
+        LookupBuffer* results,
+        AsyncRequest* req) const
+{
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    if(isDefiniteMiss(self, name)) { // answered locally
+        auto miss = [results]() {
+            if(not results) return;
+            results->clear();
+            results->append(Status::NotFound);
+        };
+        if(req == nullptr) miss();
+        else *req = AsyncRequest(missingEntry(std::move(miss)));
+        return;
+    }
+    auto async_request_impl = lookupInto(self, NameList{ &name, 1 }, results, req != nullptr);
+    if(req) *req = AsyncRequest(std::move(async_request_impl));
+}
+
+void PhonebookHandle::lookupMulti(
+        const std::vector<std::string>& names,
+        LookupBuffer* results,
+        AsyncRequest* req) const
+{
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto async_request_impl = lookupInto(self, NameList{ names.data(), names.size() }, results, req != nullptr);
+    if(req) *req = AsyncRequest(std::move(async_request_impl));
+}
+
+void PhonebookHandle::erase(
+        const std::string& name,
+        AsyncRequest* req) const
+{
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto& rpc = self->m_client->m_erase;
+    auto& ph  = self->m_ph;
+    if(req == nullptr) { // synchronous call
+        RequestResult<bool> response = self->call<RequestResult<bool>>(rpc, name);
+        if(not response.success()) {
+            throw Exception(response.error());
+        }
+    } else if(auto coalescer = self->coalescer()) { // coalesced asynchronous call
+        BatchOp op;
+        op.kind = BatchOp::Kind::Erase;
+        op.name = name;
+        *req = AsyncRequest(coalescer->add(self, std::move(op),
+            [](const BatchOpResult& r) {
+                if(not r.done.success()) {
+                    throw Exception(r.done.error());
+                }
+            }));
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(self->slotHandle(), name);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [impl = self, &rpc, name](AsyncRequestImpl& async_request_impl) {
+                RequestResult<bool> response = impl->retryIfStale<RequestResult<bool>>(
+                    async_request_impl.m_async_response->wait(), rpc, name);
+                if(not response.success()) {
+                    throw Exception(response.error());
+                }
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PhonebookHandle::search(
+        const std::string& pattern,
+        uint32_t maxEditDistance,
+        size_t limit,
+        std::vector<std::pair<std::string, std::string>>* results,
+        AsyncRequest* req) const
+{
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto& rpc = self->m_client->m_search;
+    auto& ph  = self->m_ph;
+    using Results = std::vector<std::pair<std::string, std::string>>;
+    if(req == nullptr) { // synchronous call
+        RequestResult<Results> response =
+            self->call<RequestResult<Results>>(rpc, pattern, maxEditDistance, static_cast<uint64_t>(limit));
+        if(response.success()) {
+            if(results) *results = std::move(response.value());
+        } else {
+            throw Exception(response.error());
+        }
+    } else { // asynchronous call
+        auto async_response =
+            rpc.on(ph).async(self->slotHandle(), pattern, maxEditDistance, static_cast<uint64_t>(limit));
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [impl = self, &rpc, pattern, maxEditDistance, limit, results](AsyncRequestImpl& async_request_impl) {
+                RequestResult<Results> response = impl->retryIfStale<RequestResult<Results>>(
+                    async_request_impl.m_async_response->wait(), rpc, pattern, maxEditDistance, static_cast<uint64_t>(limit));
+                if(response.success()) {
+                    if(results) *results = std::move(response.value());
+                } else {
+                    throw Exception(response.error());
+                }
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PhonebookHandle::reverseLookup(
+        const std::string& number,
+        std::vector<std::string>* names,
+        AsyncRequest* req) const
+{
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto& rpc = self->m_client->m_reverse_lookup;
+    auto& ph  = self->m_ph;
+    if(req == nullptr) { // synchronous call
+        RequestResult<std::vector<std::string>> response =
+            self->call<RequestResult<std::vector<std::string>>>(rpc, number);
+        if(response.success()) {
+            if(names) *names = std::move(response.value());
+        } else {
+            throw Exception(response.error());
+        }
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(self->slotHandle(), number);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [impl = self, &rpc, number, names](AsyncRequestImpl& async_request_impl) {
+                RequestResult<std::vector<std::string>> response =
+                    impl->retryIfStale<RequestResult<std::vector<std::string>>>(
+                        async_request_impl.m_async_response->wait(), rpc, number);
+                if(response.success()) {
+                    if(names) *names = std::move(response.value());
+                } else {
+                    throw Exception(response.error());
+                }
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PhonebookHandle::reverseLookupMulti(
+        const std::vector<std::string>& numbers,
+        std::vector<std::vector<std::string>>* names,
+        AsyncRequest* req) const
+{
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto& rpc = self->m_client->m_reverse_lookup_multi;
+    auto& ph  = self->m_ph;
+    if(req == nullptr) { // synchronous call
+        RequestResult<std::vector<std::vector<std::string>>> response =
+            self->call<RequestResult<std::vector<std::vector<std::string>>>>(rpc, numbers);
+        if(response.success()) {
+            if(names) *names = std::move(response.value());
+        } else {
+            throw Exception(response.error());
+        }
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(self->slotHandle(), numbers);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [impl = self, &rpc, numbers, names](AsyncRequestImpl& async_request_impl) {
+                RequestResult<std::vector<std::vector<std::string>>> response =
+                    impl->retryIfStale<RequestResult<std::vector<std::vector<std::string>>>>(
+                        async_request_impl.m_async_response->wait(), rpc, numbers);
+                if(response.success()) {
+                    if(names) *names = std::move(response.value());
+                } else {
+                    throw Exception(response.error());
+                }
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PhonebookHandle::scan(
+        const ScanQuery& query,
+        ScanResult* result,
+        AsyncRequest* req) const
+{
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto& rpc = self->m_client->m_scan;
+    auto& ph  = self->m_ph;
+    if(req == nullptr) { // synchronous call
+        RequestResult<ScanResult> response = self->call<RequestResult<ScanResult>>(rpc, query);
+        if(response.success()) {
+            if(result) *result = std::move(response.value());
+        } else {
+            throw Exception(response.error());
+        }
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(self->slotHandle(), query);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [impl = self, &rpc, query, result](AsyncRequestImpl& async_request_impl) {
+                RequestResult<ScanResult> response = impl->retryIfStale<RequestResult<ScanResult>>(
+                    async_request_impl.m_async_response->wait(), rpc, query);
+                if(response.success()) {
+                    if(result) *result = std::move(response.value());
+                } else {
+                    throw Exception(response.error());
+                }
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PhonebookHandle::insertNoAck(
+        const std::string& name,
+        const std::string& number) const
+{
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    if(auto filter = self->lookupFilter(false)) filter->add(name);
+    auto& rpc = self->m_client->m_insert_noack;
+    auto& ph  = self->m_ph;
+    auto handle = self->slotHandle();
+    // the sequence number is only consumed once the write is sent,
+    // otherwise the provider would wait for a write that never comes
+    std::lock_guard<tl::mutex> lock(self->m_write_mtx);
+    rpc.on(ph)(handle, self->m_write_session, self->m_next_write.load(), name, number);
+    self->m_next_write += 1;
+}
+
+void PhonebookHandle::eraseNoAck(const std::string& name) const {
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto& rpc = self->m_client->m_erase_noack;
+    auto& ph  = self->m_ph;
+    auto handle = self->slotHandle();
+    std::lock_guard<tl::mutex> lock(self->m_write_mtx);
+    rpc.on(ph)(handle, self->m_write_session, self->m_next_write.load(), name);
+    self->m_next_write += 1;
+}
+
+void PhonebookHandle::flush(std::vector<std::string>* errors) const {
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto& rpc = self->m_client->m_flush_writes;
+    uint64_t count = self->m_next_write.load();
+    RequestResult<std::vector<std::string>> response =
+        self->call<RequestResult<std::vector<std::string>>>(rpc, self->m_write_session, count);
+    if(not response.success()) {
+        throw Exception(response.error());
+    }
+    auto& failed = response.value();
+    if(errors) {
+        *errors = std::move(failed);
+    } else if(!failed.empty()) {
+        throw Exception("One-way writes failed, first error: " + failed.front());
+    }
+}
+
+void PhonebookHandle::enableLookupFilter(double maxAgeMilliseconds) const {
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto filter = std::make_shared<LookupFilter>(maxAgeMilliseconds);
+    self->refreshLookupFilter(*filter);
+    std::lock_guard<tl::mutex> lock(self->m_lookup_filter_mtx);
+    self->m_lookup_filter = std::move(filter);
+}
+
+void PhonebookHandle::disableLookupFilter() const {
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    std::lock_guard<tl::mutex> lock(self->m_lookup_filter_mtx);
+    self->m_lookup_filter.reset();
+}
+
+void PhonebookHandle::enableCoalescing(size_t maxOps, double maxDelayMicroseconds) const {
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto coalescer = std::make_shared<Coalescer>(maxOps, maxDelayMicroseconds);
+    {
+        std::lock_guard<tl::mutex> lock(self->m_coalescer_mtx);
+        coalescer.swap(self->m_coalescer);
+    }
+    if(coalescer) coalescer->flush();
+}
+
+void PhonebookHandle::disableCoalescing() const {
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    std::shared_ptr<Coalescer> coalescer;
+    {
+        std::lock_guard<tl::mutex> lock(self->m_coalescer_mtx);
+        coalescer.swap(self->m_coalescer);
+    }
+    if(coalescer) coalescer->flush();
+}
+
+std::string PhonebookHandle::getStats() const {
+    if(not self) throw Exception("Invalid yp::PhonebookHandle object");
+    auto& rpc = self->m_client->m_get_stats;
+    RequestResult<std::string> response = self->call<RequestResult<std::string>>(rpc);
+    if(not response.success()) {
+        throw Exception(response.error());
+    }
+    return std::move(response.value());
+}
+
 }
@@ -7,6 +7,16 @@
 #define __YP_PHONEBOOK_HANDLE_IMPL_H
 
 #include <yp/UUID.hpp>
+#include <yp/RequestResult.hpp>
+#include <yp/Exception.hpp>
+#include "ClientImpl.hpp"
+#include "PhonebookSlot.hpp"
+#include "Coalescer.hpp"
+#include "LookupFilter.hpp"
+#include <thallium/serialization/stl/vector.hpp>
+#include <atomic>
+#include <mutex>
+#include <random>
 
 namespace yp {
 
@@ -14,18 +24,153 @@ class PhonebookHandleImpl {
 
     public:
 
-    UUID                        m_phonebook_id;
-    std::shared_ptr<ClientImpl> m_client;
-    tl::provider_handle         m_ph;
+    UUID                          m_phonebook_id;
+    std::shared_ptr<ClientImpl>   m_client;
+    tl::provider_handle           m_ph;
+    std::atomic<uint32_t>         m_slot_handle{kInvalidSlotHandle};
+    std::shared_ptr<Coalescer>    m_coalescer; // null unless coalescing is enabled
+    tl::mutex                     m_coalescer_mtx;
+    uint64_t                      m_write_session = newWriteSession();
+    std::atomic<uint64_t>         m_next_write{0}; // sequence number of the next one-way write
+    tl::mutex                     m_write_mtx;     // serializes the sending of one-way writes
+    std::shared_ptr<LookupFilter> m_lookup_filter; // null unless the filter is enabled
+    tl::mutex                     m_lookup_filter_mtx;
 
     PhonebookHandleImpl() = default;
     
     PhonebookHandleImpl(const std::shared_ptr<ClientImpl>& client, 
                        tl::provider_handle&& ph,
-                       const UUID& phonebook_id)
+                       const UUID& phonebook_id,
+                       uint32_t slot_handle = kInvalidSlotHandle)
     : m_phonebook_id(phonebook_id)
     , m_client(client)
-    , m_ph(std::move(ph)) {}
+    , m_ph(std::move(ph))
+    , m_slot_handle(slot_handle) {}
+
+    ~PhonebookHandleImpl() {
+        // lets the provider forget the session of the one-way writes
+        uint64_t count = m_next_write.load();
+        if(!m_client || count == 0) return;
+        try {
+            m_client->m_end_write_session.on(m_ph)(m_write_session, count);
+        } catch(const std::exception&) {
+            // the provider will drop the session once it is idle
+        }
+    }
+
+    /**
+     * @brief Random identifier under which the provider orders the
+     * one-way writes issued through this handle.
+     */
+    static uint64_t newWriteSession() {
+        std::random_device rd;
+        return (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+
+    /**
+     * @brief Asks the provider for the slot handle of the phonebook.
+     * Throws an Exception if the phonebook does not exist.
+     */
+    void resolve() {
+        RequestResult<uint32_t> result =
+            m_client->m_check_phonebook.on(m_ph)(m_phonebook_id);
+        if(!result.success())
+            throw Exception(result.error());
+        m_slot_handle = result.value();
+    }
+
+    /**
+     * @brief Slot handle to send in data RPCs, resolved on first use
+     * if the handle was created without a check.
+     */
+    uint32_t slotHandle() {
+        if(m_slot_handle == kInvalidSlotHandle)
+            resolve();
+        return m_slot_handle;
+    }
+
+    /**
+     * @brief Coalescer of the handle's small asynchronous operations,
+     * or null if they are sent individually.
+     */
+    std::shared_ptr<Coalescer> coalescer() {
+        std::lock_guard<tl::mutex> lock(m_coalescer_mtx);
+        return m_coalescer;
+    }
+
+    /**
+     * @brief Cached name filter of the phonebook, or null if lookups
+     * are always sent. If refresh is true, a stale filter is refreshed.
+     */
+    std::shared_ptr<LookupFilter> lookupFilter(bool refresh) {
+        std::shared_ptr<LookupFilter> filter;
+        {
+            std::lock_guard<tl::mutex> lock(m_lookup_filter_mtx);
+            filter = m_lookup_filter;
+        }
+        if(filter && refresh && filter->stale())
+            refreshLookupFilter(*filter);
+        return filter;
+    }
+
+    /**
+     * @brief Downloads the changes to the phonebook's name filter.
+     */
+    void refreshLookupFilter(LookupFilter& filter) {
+        auto position = filter.position();
+        auto response = call<RequestResult<FilterUpdate>>(
+            m_client->m_get_filter, position.first, position.second);
+        if(!response.success())
+            throw Exception(response.error());
+        filter.apply(response.value());
+    }
+
+    /**
+     * @brief Sends rpc(slot handle, args...) and returns its response.
+     */
+    template<typename Result, typename ... Args>
+    Result call(tl::remote_procedure& rpc, const Args&... args) {
+        Result response = rpc.on(m_ph)(slotHandle(), args...);
+        return retryIfStale(std::move(response), rpc, args...);
+    }
+
+    /**
+     * @brief If the response reports a stale slot handle, resolves the
+     * phonebook's UUID into a new handle and sends the RPC again.
+     */
+    template<typename Result, typename ... Args>
+    Result retryIfStale(Result response, tl::remote_procedure& rpc, const Args&... args) {
+        if(response.status() != Status::StaleHandle)
+            return response;
+        resolve();
+        Result retried = rpc.on(m_ph)(m_slot_handle.load(), args...);
+        return retried;
+    }
+
+    /**
+     * @brief Same as call, the response being decoded with the given
+     * serialization context (e.g. the buffer to decode the value into).
+     */
+    template<typename Result, typename Context, typename ... Args>
+    Result callWithContext(Context ctx, tl::remote_procedure& rpc, const Args&... args) {
+        Result response = rpc.on(m_ph)(slotHandle(), args...)
+                             .with_serialization_context(ctx).template as<Result>();
+        return retryIfStaleWithContext(std::move(response), ctx, rpc, args...);
+    }
+
+    /**
+     * @brief Same as retryIfStale, with a serialization context.
+     */
+    template<typename Result, typename Context, typename ... Args>
+    Result retryIfStaleWithContext(Result response, Context ctx,
+                                   tl::remote_procedure& rpc, const Args&... args) {
+        if(response.status() != Status::StaleHandle)
+            return response;
+        resolve();
+        Result retried = rpc.on(m_ph)(m_slot_handle.load(), args...)
+                            .with_serialization_context(ctx).template as<Result>();
+        return retried;
+    }
 };
 
 }
@@ -0,0 +1,40 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_PHONEBOOK_SLOT_H
+#define __YP_PHONEBOOK_SLOT_H
+
+#include <cstdint>
+
+namespace yp {
+
+/**
+ * Data RPCs identify their phonebook with a 32-bit handle rather than
+ * its 16-byte UUID. The provider keeps its phonebooks in an array of
+ * slots; a handle holds the index of the phonebook's slot (low 16 bits)
+ * and the generation of that slot (high 16 bits), which the provider
+ * increments whenever the slot is freed. A handle whose generation does
+ * not match, e.g. because the phonebook was closed and its slot reused,
+ * is rejected with Status::StaleHandle and the client resolves the UUID
+ * into a new handle with the check RPC.
+ */
+constexpr uint32_t kMaxSlots          = 0xFFFF;
+constexpr uint32_t kInvalidSlotHandle = 0xFFFFFFFF; // index 0xFFFF is never used
+
+inline uint32_t makeSlotHandle(uint32_t index, uint16_t generation) {
+    return (static_cast<uint32_t>(generation) << 16) | index;
+}
+
+inline uint32_t slotIndex(uint32_t handle) {
+    return handle & 0xFFFF;
+}
+
+inline uint16_t slotGeneration(uint32_t handle) {
+    return static_cast<uint16_t>(handle >> 16);
+}
+
+}
+
+#endif
@@ -39,6 +39,14 @@ std::string Provider::getConfig() const {
     return self ? self->getConfig() : "{}";
 }
 
+void Provider::setPool(const tl::pool& pool) {
+    if(self) self->setPool(pool);
+}
+
+std::string Provider::getLoad() const {
+    return self ? self->getLoad() : "{}";
+}
+
 Provider::operator bool() const {
     return static_cast<bool>(self);
 }
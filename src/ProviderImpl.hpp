@@ -8,29 +8,89 @@
 
 #include "yp/Backend.hpp"
 #include "yp/UUID.hpp"
+#include "PhonebookSlot.hpp"
+#include "InputString.hpp"
+#include "BatchOp.hpp"
+#include "MemoryQuota.hpp"
+#include "Parallel.hpp"
 
 #include <thallium.hpp>
 #include <thallium/serialization/stl/string.hpp>
 #include <thallium/serialization/stl/vector.hpp>
+#include <thallium/serialization/stl/pair.hpp>
 
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <functional>
 #include <tuple>
+#include <map>
+#include <set>
+#include <unistd.h>
 
 #define FIND_PHONEBOOK(__var__) \
         std::shared_ptr<Backend> __var__;\
+        PhonebookPin __var__##_pin;\
+        do {\
+            SlotRef ref;\
+            auto loaded = ensureLoaded(phonebook_id, &ref);\
+            if(!loaded.success()) {\
+                if(loaded.status() == Status::Error) {\
+                    result.success() = false;\
+                    result.error() = loaded.error();\
+                } else {\
+                    result.fail(loaded.status());\
+                }\
+                req.respond(result);\
+                spdlog::error("[provider:{}] Phonebook {}: {}", id(), phonebook_id.to_string(), result.error());\
+                return;\
+            }\
+            __var__ = std::move(ref.backend);\
+            __var__##_pin = std::move(ref.pin);\
+        }while(0)
+
+#define FIND_PHONEBOOK_BY_HANDLE(__var__) \
+        std::shared_ptr<Backend> __var__;\
+        PhonebookPin __var__##_pin;\
         do {\
             std::lock_guard<tl::mutex> lock(m_backends_mtx);\
-            auto it = m_backends.find(phonebook_id);\
-            if(it == m_backends.end()) {\
-                result.success() = false;\
-                result.error() = "Phonebook with UUID "s + phonebook_id.to_string() + " not found";\
+            auto index = slotIndex(phonebook_handle);\
+            if(index >= m_slots.size()\
+            || m_slots[index].generation != slotGeneration(phonebook_handle)\
+            || !m_slots[index].backend) {\
+                result.fail(Status::StaleHandle);\
                 req.respond(result);\
-                spdlog::error("[provider:{}] Phonebook {} not found", id(), phonebook_id.to_string());\
+                spdlog::trace("[provider:{}] Stale phonebook handle {}", id(), phonebook_handle);\
                 return;\
             }\
-            __var__ = it->second;\
+            m_slots[index].last_access = clock::now().time_since_epoch().count();\
+            __var__ = m_slots[index].backend;\
+            __var__##_pin = PhonebookPin(m_slots[index].pins);\
+        }while(0)
+
+#define FIND_PHONEBOOK_AND_USAGE_BY_HANDLE(__var__) \
+        std::shared_ptr<Backend> __var__;\
+        std::shared_ptr<MemoryQuota::Usage> __var__##_usage;\
+        PhonebookPin __var__##_pin;\
+        do {\
+            std::lock_guard<tl::mutex> lock(m_backends_mtx);\
+            auto index = slotIndex(phonebook_handle);\
+            if(index >= m_slots.size()\
+            || m_slots[index].generation != slotGeneration(phonebook_handle)\
+            || !m_slots[index].backend) {\
+                result.fail(Status::StaleHandle);\
+                req.respond(result);\
+                spdlog::trace("[provider:{}] Stale phonebook handle {}", id(), phonebook_handle);\
+                return;\
+            }\
+            m_slots[index].last_access = clock::now().time_since_epoch().count();\
+            __var__ = m_slots[index].backend;\
+            __var__##_usage = m_slots[index].usage;\
+            __var__##_pin = PhonebookPin(m_slots[index].pins);\
         }while(0)
 
 namespace yp {
@@ -48,31 +108,185 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
 
     tl::engine           m_engine;
     std::string          m_token;
-    tl::pool             m_pool;
+    tl::pool             m_pool; // pool the RPCs are registered with
+    // Pool the RPCs are actually handled in, if the provider was moved
+    std::atomic<ABT_pool> m_target_pool;
+    // Handlers spawned in the target pool that have not completed
+    uint32_t               m_forwarded_pending = 0;
+    tl::mutex              m_forwarded_mtx;
+    tl::condition_variable m_forwarded_cv;
+    // Load
+    using clock = std::chrono::steady_clock;
+    clock::time_point     m_start = clock::now();
+    std::atomic<uint64_t> m_rpcs_handled{0};
+    std::atomic<uint64_t> m_rpcs_forwarded{0};
+    std::atomic<uint64_t> m_busy_ns{0};
+    std::atomic<uint32_t> m_rpcs_in_flight{0};
+    std::atomic<uint64_t> m_evictions{0};
+    std::atomic<uint64_t> m_loads{0};
     // Admin RPC
     tl::remote_procedure m_create_phonebook;
     tl::remote_procedure m_open_phonebook;
     tl::remote_procedure m_close_phonebook;
     tl::remote_procedure m_destroy_phonebook;
+    tl::remote_procedure m_snapshot_phonebook;
+    tl::remote_procedure m_restore_phonebook;
+    tl::remote_procedure m_checkpoint_phonebook;
+    tl::remote_procedure m_get_load;
     // Client RPC
     tl::remote_procedure m_check_phonebook;
     tl::remote_procedure m_say_hello;
     tl::remote_procedure m_compute_sum;
+    tl::remote_procedure m_compute_sum_many;
+    tl::remote_procedure m_insert;
+    tl::remote_procedure m_lookup;
+    tl::remote_procedure m_lookup_multi;
+    tl::remote_procedure m_erase;
+    tl::remote_procedure m_search;
+    tl::remote_procedure m_reverse_lookup;
+    tl::remote_procedure m_reverse_lookup_multi;
+    tl::remote_procedure m_scan;
+    tl::remote_procedure m_get_stats;
+    tl::remote_procedure m_batch;
+    tl::remote_procedure m_insert_noack;
+    tl::remote_procedure m_erase_noack;
+    tl::remote_procedure m_flush_writes;
+    tl::remote_procedure m_end_write_session;
+    tl::remote_procedure m_get_filter;
+    // One-way writes
+    struct WriteSession {
+        tl::mutex                mutex;
+        tl::condition_variable   cv;
+        uint64_t                 next = 0;   // sequence number of the next write to apply
+        uint64_t                 failed = 0; // failed writes not yet reported
+        std::vector<std::string> errors;     // first kMaxWriteErrors of them
+        std::set<uint64_t>       waiting;    // writes that arrived before their turn
+        std::atomic<int64_t>     last_used{0}; // in clock ticks
+    };
+    static constexpr size_t kMaxWriteErrors = 64;
+    static constexpr double kDefaultWriteGapTimeoutMs = 5000.0;
+    static constexpr double kDefaultWriteSessionIdleTtlMs = 600000.0;
+    double  m_write_gap_timeout_ms       = kDefaultWriteGapTimeoutMs;
+    double  m_write_session_idle_ttl_ms  = kDefaultWriteSessionIdleTtlMs;
+    int64_t m_write_sessions_pruned      = 0; // in clock ticks, with m_write_sessions_mtx
+    std::unordered_map<uint64_t, std::shared_ptr<WriteSession>> m_write_sessions;
+    tl::mutex m_write_sessions_mtx;
+    // File I/O of the backends
+    std::shared_ptr<IoEngine>   m_io_engine;
+    std::shared_ptr<BlockCache> m_block_cache;
+    static constexpr size_t   kDefaultBlockCacheCapacity = size_t(64) << 20;
+    static constexpr unsigned kDefaultBlockCacheShards   = 16;
+    // Memory accounting
+    std::unique_ptr<MemoryQuota> m_quota;
+    static constexpr double kDefaultQuotaRefreshIntervalMs = 100.0;
+    // Eviction of idle phonebooks
+    double                       m_idle_ttl_ms = 0; // 0 if disabled
+    double                       m_eviction_interval_ms = 0;
+    std::string                  m_eviction_directory;
+    std::atomic<bool>            m_eviction_stop{false};
+    bool                         m_eviction_running = false;
+    tl::mutex                    m_eviction_mutex;
+    tl::condition_variable       m_eviction_cv;
+    tl::eventual<void>           m_eviction_done;
     // Backends
+    struct Slot {
+        UUID                                   phonebook_id;
+        std::shared_ptr<Backend>               backend;
+        std::shared_ptr<MemoryQuota::Usage>    usage;
+        std::shared_ptr<std::atomic<uint32_t>> pins; // requests using the backend
+        int64_t                                last_access = 0; // in clock ticks
+        bool                                   evictable   = true;
+        bool                                   reserved    = false; // phonebook evicted
+        uint16_t                               generation  = 0;
+    };
+    /**
+     * Use of a phonebook by a request in progress, which keeps the
+     * phonebook from being evicted. Pins are taken with m_backends_mtx
+     * held, so that eviction, which checks that a phonebook has none
+     * under the same lock, cannot race with a request finding it.
+     */
+    class PhonebookPin {
+        std::shared_ptr<std::atomic<uint32_t>> m_pins;
+        public:
+        PhonebookPin() = default;
+        explicit PhonebookPin(std::shared_ptr<std::atomic<uint32_t>> pins)
+        : m_pins(std::move(pins)) {
+            if(m_pins) *m_pins += 1;
+        }
+        PhonebookPin(PhonebookPin&& other) = default;
+        PhonebookPin& operator=(PhonebookPin&& other) {
+            if(this != &other) {
+                release();
+                m_pins = std::move(other.m_pins);
+            }
+            return *this;
+        }
+        ~PhonebookPin() { release(); }
+        void release() {
+            if(m_pins) *m_pins -= 1;
+            m_pins.reset();
+        }
+    };
+    /**
+     * Backend of a slot, pinned, as found by a request (null if the
+     * handle is stale).
+     */
+    struct SlotRef {
+        std::shared_ptr<Backend>            backend;
+        std::shared_ptr<MemoryQuota::Usage> usage;
+        PhonebookPin                        pin;
+    };
     std::unordered_map<UUID, std::shared_ptr<Backend>> m_backends;
+    std::unordered_map<UUID, uint32_t>                 m_slot_handles;
+    std::vector<Slot>                                  m_slots;
+    std::vector<uint32_t>                              m_free_slots;
     tl::mutex m_backends_mtx;
+    // Phonebooks registered without being loaded, loaded on first use
+    struct UnloadedPhonebook {
+        std::string type;
+        json        config;
+        size_t      quota   = 0;
+        bool        open    = false; // opened (rather than created) when loaded
+        bool        loading = false; // or being evicted
+        std::string snapshot;        // to restore when loaded, if evicted
+        uint32_t    handle = kInvalidSlotHandle; // slot kept for it, if evicted
+    };
+    std::unordered_map<UUID, UnloadedPhonebook> m_unloaded;
+    tl::condition_variable                      m_loading_cv; // with m_backends_mtx
 
     ProviderImpl(const tl::engine& engine, uint16_t provider_id, const std::string& config, const tl::pool& pool)
     : tl::provider<ProviderImpl>(engine, provider_id)
     , m_engine(engine)
     , m_pool(pool)
-    , m_create_phonebook(define("yp_create_phonebook", &ProviderImpl::createPhonebookRPC, pool))
-    , m_open_phonebook(define("yp_open_phonebook", &ProviderImpl::openPhonebookRPC, pool))
-    , m_close_phonebook(define("yp_close_phonebook", &ProviderImpl::closePhonebookRPC, pool))
-    , m_destroy_phonebook(define("yp_destroy_phonebook", &ProviderImpl::destroyPhonebookRPC, pool))
-    , m_check_phonebook(define("yp_check_phonebook", &ProviderImpl::checkPhonebookRPC, pool))
-    , m_say_hello(define("yp_say_hello", &ProviderImpl::sayHelloRPC, pool))
-    , m_compute_sum(define("yp_compute_sum",  &ProviderImpl::computeSumRPC, pool))
+    , m_target_pool(pool.native_handle())
+    , m_create_phonebook(define("yp_create_phonebook", routed(&ProviderImpl::createPhonebookRPC), pool))
+    , m_open_phonebook(define("yp_open_phonebook", routed(&ProviderImpl::openPhonebookRPC), pool))
+    , m_close_phonebook(define("yp_close_phonebook", routed(&ProviderImpl::closePhonebookRPC), pool))
+    , m_destroy_phonebook(define("yp_destroy_phonebook", routed(&ProviderImpl::destroyPhonebookRPC), pool))
+    , m_snapshot_phonebook(define("yp_snapshot_phonebook", routed(&ProviderImpl::snapshotPhonebookRPC), pool))
+    , m_restore_phonebook(define("yp_restore_phonebook", routed(&ProviderImpl::restorePhonebookRPC), pool))
+    , m_checkpoint_phonebook(define("yp_checkpoint_phonebook", routed(&ProviderImpl::checkpointPhonebookRPC), pool))
+    // not routed, so that the load can be read while the target pool is busy
+    , m_get_load(define("yp_get_load", &ProviderImpl::getLoadRPC, pool))
+    , m_check_phonebook(define("yp_check_phonebook", routed(&ProviderImpl::checkPhonebookRPC), pool))
+    , m_say_hello(define("yp_say_hello", routed(&ProviderImpl::sayHelloRPC), pool))
+    , m_compute_sum(define("yp_compute_sum", routed(&ProviderImpl::computeSumRPC), pool))
+    , m_compute_sum_many(define("yp_compute_sum_many", routed(&ProviderImpl::computeSumManyRPC), pool))
+    , m_insert(define("yp_insert", routed(&ProviderImpl::insertRPC), pool))
+    , m_lookup(define("yp_lookup", routed(&ProviderImpl::lookupRPC), pool))
+    , m_lookup_multi(define("yp_lookup_multi", routed(&ProviderImpl::lookupMultiRPC), pool))
+    , m_erase(define("yp_erase", routed(&ProviderImpl::eraseRPC), pool))
+    , m_search(define("yp_search", routed(&ProviderImpl::searchRPC), pool))
+    , m_reverse_lookup(define("yp_reverse_lookup", routed(&ProviderImpl::reverseLookupRPC), pool))
+    , m_reverse_lookup_multi(define("yp_reverse_lookup_multi", routed(&ProviderImpl::reverseLookupMultiRPC), pool))
+    , m_scan(define("yp_scan", routed(&ProviderImpl::scanRPC), pool))
+    , m_get_stats(define("yp_get_stats", routed(&ProviderImpl::getStatsRPC), pool))
+    , m_batch(define("yp_batch", routed(&ProviderImpl::batchRPC), pool))
+    , m_insert_noack(define("yp_insert_noack", routed(&ProviderImpl::insertNoAckRPC), pool).disable_response())
+    , m_erase_noack(define("yp_erase_noack", routed(&ProviderImpl::eraseNoAckRPC), pool).disable_response())
+    , m_flush_writes(define("yp_flush_writes", routed(&ProviderImpl::flushWritesRPC), pool))
+    , m_end_write_session(define("yp_end_write_session", routed(&ProviderImpl::endWriteSessionRPC), pool).disable_response())
+    , m_get_filter(define("yp_get_filter", routed(&ProviderImpl::getFilterRPC), pool))
     {
         spdlog::trace("[provider:{0}] Registered provider with id {0}", id());
         json json_config;
@@ -81,35 +295,609 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         } catch(json::parse_error& e) {
             spdlog::error("[provider:{}] Could not parse provider configuration: {}",
                     id(), e.what());
-            return;
+            json_config = json();
         }
+        m_io_engine   = makeIoEngine(json_config);
+        m_block_cache = makeBlockCache(json_config);
+        m_quota       = makeMemoryQuota(json_config);
+        configureOneWayWrites(json_config);
+        startEviction(json_config);
         if(!json_config.is_object()) return;
         if(!json_config.contains("phonebooks")) return;
         auto& phonebooks = json_config["phonebooks"];
         if(!phonebooks.is_array()) return;
+        // lazy phonebooks are only registered, the others are
+        // created concurrently, each in its own ULT
+        std::vector<const json*> eager;
         for(auto& phonebook : phonebooks) {
             if(!(phonebook.contains("type") && phonebook["type"].is_string()))
                 continue;
+            if(phonebook.value("lazy", false))
+                registerLazyPhonebook(phonebook);
+            else
+                eager.push_back(&phonebook);
+        }
+        parallelFor(workPool(), eager.size(), [this, &eager](size_t i) {
+            auto& phonebook = *eager[i];
             const std::string& phonebook_type = phonebook["type"].get_ref<const std::string&>();
             auto phonebook_config = phonebook.contains("config") ? phonebook["config"] : json::object();
-            createPhonebook(phonebook_type, phonebook_config.dump());
+            createPhonebook(phonebook_type, phonebook_config.dump(), configuredId(phonebook));
+        });
+    }
+
+    /**
+     * Returns the UUID given by the "__id__" entry of a phonebook in the
+     * provider configuration (as output by getConfig), or a new one.
+     */
+    UUID configuredId(const json& phonebook) const {
+        if(phonebook.contains("__id__") && phonebook["__id__"].is_string()) {
+            try {
+                return UUID::from_string(phonebook["__id__"].get_ref<const std::string&>().c_str());
+            } catch(const std::exception&) {
+                spdlog::error("[provider:{}] Invalid phonebook id {}, generating a new one",
+                        id(), phonebook["__id__"].get<std::string>());
+            }
+        }
+        return UUID::generate();
+    }
+
+    /**
+     * Registers a phonebook of the provider configuration whose "lazy"
+     * entry is true, without creating it. It is created on first use or,
+     * if it has a "snapshot" entry (it was evicted, see getConfig),
+     * opened and restored from that snapshot.
+     */
+    void registerLazyPhonebook(const json& phonebook) {
+        auto phonebook_id = configuredId(phonebook);
+        UnloadedPhonebook entry;
+        entry.type     = phonebook["type"].get<std::string>();
+        entry.config   = phonebook.contains("config") ? phonebook["config"] : json::object();
+        entry.quota    = phonebookQuota(entry.config);
+        entry.snapshot = phonebook.contains("snapshot") && phonebook["snapshot"].is_string()
+                       ? phonebook["snapshot"].get<std::string>() : std::string();
+        entry.open     = !entry.snapshot.empty();
+        std::lock_guard<tl::mutex> lock(m_backends_mtx);
+        if(m_backends.count(phonebook_id) || m_unloaded.count(phonebook_id)) {
+            spdlog::error("[provider:{}] Phonebook {} is already registered",
+                    id(), phonebook_id.to_string());
+            return;
+        }
+        m_unloaded.emplace(phonebook_id, std::move(entry));
+        spdlog::trace("[provider:{}] Registered lazy phonebook {} of type {}",
+                id(), phonebook_id.to_string(), phonebook["type"].get<std::string>());
+    }
+
+    /**
+     * Loads a phonebook that is registered but not loaded, and returns
+     * its slot handle. Concurrent calls for the same phonebook wait for
+     * a single load. Fails with PhonebookNotFound if the phonebook is
+     * not registered at all. If ref is not null, it receives the pinned
+     * backend, found under the same lock as the handle. Unless admit is
+     * false, loading a lazy phonebook fails with QuotaExceeded when the
+     * provider is over its memory quota. Reloading an evicted phonebook
+     * is never refused this way: it was admitted when first loaded.
+     */
+    RequestResult<uint32_t> ensureLoaded(const UUID& phonebook_id, SlotRef* ref = nullptr,
+                                         bool admit = true) {
+        RequestResult<uint32_t> result;
+        std::unique_lock<tl::mutex> lock(m_backends_mtx);
+        auto it = m_unloaded.end();
+        while(true) {
+            auto handle = m_slot_handles.find(phonebook_id);
+            if(handle != m_slot_handles.end()) {
+                auto found = refSlot(slotIndex(handle->second));
+                if(ref) *ref = std::move(found);
+                result.value() = handle->second;
+                return result;
+            }
+            it = m_unloaded.find(phonebook_id);
+            if(it == m_unloaded.end()) {
+                result.fail(Status::PhonebookNotFound);
+                return result;
+            }
+            if(!it->second.loading) break;
+            m_loading_cv.wait(lock);
+        }
+        // an evicted phonebook has kept its slot, a lazy one has none yet
+        bool evicted = it->second.handle != kInvalidSlotHandle;
+        if(admit && !evicted && !m_quota->admitPhonebook()) {
+            result.fail(Status::QuotaExceeded);
+            return result;
+        }
+        it->second.loading = true;
+        auto entry = it->second;
+        lock.unlock();
+
+        std::unique_ptr<Backend> backend;
+        try {
+            backend = entry.open
+                ? PhonebookFactory::openPhonebook(entry.type, get_engine(), entry.config)
+                : PhonebookFactory::createPhonebook(entry.type, get_engine(), entry.config);
+            if(!backend) result.error() = "Unknown phonebook type "s + entry.type;
+            if(backend && !entry.snapshot.empty()) {
+                auto restored = backend->restore(entry.snapshot, workPool());
+                if(!restored.success()) {
+                    backend.reset();
+                    result.error() = restored.error();
+                }
+            }
+        } catch(const std::exception& ex) {
+            backend.reset();
+            result.error() = ex.what();
+        }
+
+        lock.lock();
+        // the entry stays in place (and may be retried) if the load failed
+        it = m_unloaded.find(phonebook_id);
+        it->second.loading = false;
+        m_loading_cv.notify_all();
+        if(!backend) {
+            result.success() = false;
+            spdlog::error("[provider:{}] Could not load phonebook {}: {}",
+                    id(), phonebook_id.to_string(), result.error());
+            return result;
+        }
+        if(!addBackend(phonebook_id, std::move(backend), entry.quota, entry.handle)) {
+            result.success() = false;
+            result.error() = "Too many phonebooks in provider";
+            return result;
+        }
+        m_unloaded.erase(it);
+        m_loads += 1;
+        if(!entry.snapshot.empty()) ::unlink(entry.snapshot.c_str());
+        result.value() = m_slot_handles[phonebook_id];
+        if(ref) *ref = refSlot(slotIndex(result.value()));
+        spdlog::trace("[provider:{}] Loaded phonebook {} of type {}",
+                id(), phonebook_id.to_string(), entry.type);
+        return result;
+    }
+
+    /**
+     * Wraps an RPC handler so that it runs in the pool the provider was
+     * last moved to (see setPool). The RPC stays registered with its
+     * original pool, in which the wrapper merely spawns the handler in
+     * the target pool, with copies of its arguments that do not refer to
+     * the request's input buffer. Until the provider is moved, the
+     * handler is called directly. The time spent in handlers is counted
+     * in the provider's load either way. The spawned handlers are
+     * counted until they complete, and the destructor waits for them.
+     */
+    template<typename ... Args>
+    std::function<void(const tl::request&, Args...)>
+    routed(void (ProviderImpl::*handler)(const tl::request&, Args...)) {
+        return [this, handler](const tl::request& req, Args... args) {
+            auto target = m_target_pool.load();
+            if(target == m_pool.native_handle()) {
+                measured(handler, req, args...);
+                return;
+            }
+            {
+                std::lock_guard<tl::mutex> lock(m_forwarded_mtx);
+                m_forwarded_pending += 1;
+            }
+            try {
+                tl::pool(target).make_thread(
+                    [this, handler, req, values = std::make_tuple(detached(args)...)]() mutable {
+                        try {
+                            std::apply([&](auto&... a) { measured(handler, req, a...); }, values);
+                        } catch(const std::exception& ex) {
+                            spdlog::error("[provider:{}] Forwarded RPC handler failed: {}", id(), ex.what());
+                        }
+                        forwardedDone();
+                    }, tl::anonymous());
+            } catch(...) {
+                forwardedDone();
+                throw;
+            }
+            m_rpcs_forwarded += 1;
+        };
+    }
+
+    void forwardedDone() {
+        std::lock_guard<tl::mutex> lock(m_forwarded_mtx);
+        m_forwarded_pending -= 1;
+        if(m_forwarded_pending == 0) m_forwarded_cv.notify_all();
+    }
+
+    /**
+     * Waits until the handlers spawned in the target pool have completed.
+     */
+    void waitForForwarded() {
+        std::unique_lock<tl::mutex> lock(m_forwarded_mtx);
+        while(m_forwarded_pending != 0)
+            m_forwarded_cv.wait(lock);
+    }
+
+    template<typename Handler, typename ... Args>
+    void measured(Handler handler, const tl::request& req, Args&... args) {
+        m_rpcs_in_flight += 1;
+        auto start = clock::now();
+        try {
+            (this->*handler)(req, args...);
+        } catch(...) {
+            handled(start);
+            throw;
+        }
+        handled(start);
+    }
+
+    void handled(clock::time_point start) {
+        m_busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+        m_rpcs_in_flight -= 1;
+        m_rpcs_handled += 1;
+    }
+
+    template<typename T>
+    static T detached(const T& arg) {
+        return arg;
+    }
+
+    static InputString detached(const InputString& arg) {
+        return arg.detached();
+    }
+
+    static std::vector<InputString> detached(const std::vector<InputString>& args) {
+        std::vector<InputString> result;
+        result.reserve(args.size());
+        for(auto& arg : args) result.push_back(arg.detached());
+        return result;
+    }
+
+    /**
+     * Moves the handling of the provider's RPCs to another pool (a null
+     * pool moves them back to the pool they were registered with).
+     * Handlers already running complete in their current pool.
+     */
+    void setPool(const tl::pool& pool) {
+        auto target = pool.is_null() ? m_pool.native_handle() : pool.native_handle();
+        m_target_pool = target;
+        spdlog::trace("[provider:{}] Moved RPC handling to {} pool", id(),
+                target == m_pool.native_handle() ? "its original" : "another");
+    }
+
+    /**
+     * Returns the load of the provider as a JSON-formatted string.
+     */
+    std::string getLoad() const {
+        auto uptime = std::chrono::duration<double>(clock::now() - m_start).count();
+        auto busy   = m_busy_ns.load() * 1e-9;
+        json load = {
+            { "rpcs_handled",   m_rpcs_handled.load() },
+            { "rpcs_forwarded", m_rpcs_forwarded.load() },
+            { "rpcs_in_flight", m_rpcs_in_flight.load() },
+            { "busy_seconds",   busy },
+            { "uptime_seconds", uptime },
+            { "utilization",    uptime > 0.0 ? busy / uptime : 0.0 },
+            { "pool_size",      workPool().size() },
+            { "moved",          m_target_pool.load() != m_pool.native_handle() },
+            { "evictions",      m_evictions.load() },
+            { "loads",          m_loads.load() }
+        };
+        return load.dump();
+    }
+
+    /**
+     * Reads the "one_way_writes" object of the provider configuration:
+     * "gap_timeout_ms" is how long a session waits for a missing write
+     * before taking it as lost, and "session_idle_ttl_ms" how long an
+     * unused session is kept when its client did not end it.
+     */
+    void configureOneWayWrites(const json& config) {
+        if(!config.is_object() || !config.contains("one_way_writes")) return;
+        auto& writes_config = config["one_way_writes"];
+        try {
+            m_write_gap_timeout_ms = writes_config.value(
+                "gap_timeout_ms", kDefaultWriteGapTimeoutMs);
+            m_write_session_idle_ttl_ms = writes_config.value(
+                "session_idle_ttl_ms", kDefaultWriteSessionIdleTtlMs);
+        } catch(const std::exception& ex) {
+            spdlog::error("[provider:{}] Invalid one-way write configuration: {}", id(), ex.what());
+        }
+        if(m_write_gap_timeout_ms <= 0)
+            m_write_gap_timeout_ms = kDefaultWriteGapTimeoutMs;
+        // a session must outlive the waits of its writes
+        if(m_write_session_idle_ttl_ms < 2 * m_write_gap_timeout_ms)
+            m_write_session_idle_ttl_ms = 2 * m_write_gap_timeout_ms;
+    }
+
+    /**
+     * Absolute CLOCK_REALTIME time, as expected by wait_until, that is
+     * the provided number of milliseconds from now.
+     */
+    static struct timespec deadlineIn(double ms) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        auto ns = static_cast<long long>(ms * 1e6) + deadline.tv_nsec;
+        deadline.tv_sec  += ns / 1000000000;
+        deadline.tv_nsec  = ns % 1000000000;
+        return deadline;
+    }
+
+    static bool isPast(const struct timespec& deadline) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        return now.tv_sec > deadline.tv_sec
+            || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec);
+    }
+
+    /**
+     * Reads the "eviction" object of the provider configuration and, if
+     * its "idle_ttl_ms" is positive, starts the ULT that evicts the
+     * phonebooks that have not been accessed for that long.
+     */
+    void startEviction(const json& config) {
+        if(!config.is_object() || !config.contains("eviction")) return;
+        auto& eviction_config = config["eviction"];
+        try {
+            m_idle_ttl_ms          = eviction_config.value("idle_ttl_ms", 0.0);
+            m_eviction_interval_ms = eviction_config.value("check_interval_ms",
+                                                           std::min(m_idle_ttl_ms, 1000.0));
+            m_eviction_directory   = eviction_config.value("directory", ".");
+        } catch(const std::exception& ex) {
+            spdlog::error("[provider:{}] Invalid eviction configuration: {}", id(), ex.what());
+            m_idle_ttl_ms = 0;
+        }
+        if(m_idle_ttl_ms <= 0 || m_eviction_interval_ms <= 0) {
+            m_idle_ttl_ms = 0;
+            return;
+        }
+        m_eviction_running = true;
+        workPool().make_thread([this]() { evictionLoop(); }, tl::anonymous());
+        spdlog::trace("[provider:{}] Evicting phonebooks idle for {} ms into {}",
+                id(), m_idle_ttl_ms, m_eviction_directory);
+    }
+
+    void stopEviction() {
+        if(!m_eviction_running) return;
+        {
+            std::lock_guard<tl::mutex> lock(m_eviction_mutex);
+            m_eviction_stop = true;
+            m_eviction_cv.notify_one();
+        }
+        m_eviction_done.wait();
+    }
+
+    void evictionLoop() {
+        std::unique_lock<tl::mutex> lock(m_eviction_mutex);
+        while(!m_eviction_stop) {
+            auto deadline = deadlineIn(m_eviction_interval_ms);
+            m_eviction_cv.wait_until(lock, &deadline);
+            if(m_eviction_stop) break;
+            lock.unlock();
+            evictIdlePhonebooks();
+            lock.lock();
+        }
+        m_eviction_done.set_value();
+    }
+
+    /**
+     * Unloads the phonebooks that have not been accessed for the idle TTL
+     * and that no request is using, keeping their UUID registered: each
+     * one is snapshotted into the eviction directory, and reopened from
+     * its snapshot by the next request for it (see ensureLoaded), which
+     * waits for the snapshot to be complete. The slot of an evicted
+     * phonebook is kept for it, so that its handles remain valid once
+     * it is reloaded. Phonebooks whose backend cannot take snapshots
+     * stay resident.
+     */
+    void evictIdlePhonebooks() {
+        auto now = clock::now().time_since_epoch().count();
+        auto ttl = std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double, std::milli>(m_idle_ttl_ms)).count();
+        std::vector<std::pair<UUID, std::shared_ptr<Backend>>> victims;
+        std::vector<json> configs; // by victim
+        {
+            std::lock_guard<tl::mutex> lock(m_backends_mtx);
+            for(auto& pair : m_slot_handles) {
+                auto& slot = m_slots[slotIndex(pair.second)];
+                if(!slot.evictable || now - slot.last_access < ttl) continue;
+                if(*slot.pins != 0) continue; // in use
+                json config;
+                try {
+                    config = json::parse(slot.backend->getConfig());
+                } catch(const std::exception& ex) {
+                    // it could not be reopened from its snapshot
+                    slot.evictable = false;
+                    spdlog::error("[provider:{}] Phonebook {} cannot be evicted: {}",
+                            id(), pair.first.to_string(), ex.what());
+                    continue;
+                }
+                victims.emplace_back(pair.first, slot.backend);
+                configs.push_back(std::move(config));
+            }
+            for(size_t i = 0; i < victims.size(); i++) {
+                auto& victim = victims[i];
+                UnloadedPhonebook entry;
+                entry.type     = victim.second->name();
+                entry.config   = std::move(configs[i]);
+                entry.quota    = m_slots[slotIndex(m_slot_handles[victim.first])].usage->limit;
+                entry.open     = true;
+                entry.loading  = true;
+                entry.snapshot = m_eviction_directory + "/" + victim.first.to_string() + ".snapshot";
+                entry.handle   = removeBackend(victim.first, true);
+                m_unloaded.emplace(victim.first, std::move(entry));
+            }
+        }
+        for(auto& victim : victims) {
+            auto& phonebook_id = victim.first;
+            auto path = m_eviction_directory + "/" + phonebook_id.to_string() + ".snapshot";
+            auto result = victim.second->snapshot(path, workPool());
+            {
+                std::lock_guard<tl::mutex> lock(m_backends_mtx);
+                auto it = m_unloaded.find(phonebook_id);
+                if(result.success()) {
+                    it->second.loading = false;
+                    m_evictions += 1;
+                    spdlog::trace("[provider:{}] Evicted idle phonebook {} into {}",
+                            id(), phonebook_id.to_string(), path);
+                } else {
+                    // back in service, and never evicted again
+                    auto quota  = it->second.quota;
+                    auto handle = it->second.handle;
+                    m_unloaded.erase(it);
+                    if(addBackend(phonebook_id, victim.second, quota, handle))
+                        m_slots[slotIndex(m_slot_handles[phonebook_id])].evictable = false;
+                    spdlog::trace("[provider:{}] Phonebook {} cannot be evicted: {}",
+                            id(), phonebook_id.to_string(), result.error());
+                }
+                m_loading_cv.notify_all();
+            }
+            // the backend is released outside of the lock
+            victim.second.reset();
         }
     }
 
     ~ProviderImpl() {
         spdlog::trace("[provider:{}] Deregistering provider", id());
+        // the snapshots of evicted phonebooks are kept: getConfig lists
+        // them, so that a provider created with it restores them
+        stopEviction();
         m_create_phonebook.deregister();
         m_open_phonebook.deregister();
         m_close_phonebook.deregister();
         m_destroy_phonebook.deregister();
+        m_snapshot_phonebook.deregister();
+        m_restore_phonebook.deregister();
+        m_checkpoint_phonebook.deregister();
+        m_get_load.deregister();
         m_check_phonebook.deregister();
         m_say_hello.deregister();
         m_compute_sum.deregister();
+        m_compute_sum_many.deregister();
+        m_insert.deregister();
+        m_lookup.deregister();
+        m_lookup_multi.deregister();
+        m_erase.deregister();
+        m_search.deregister();
+        m_reverse_lookup.deregister();
+        m_reverse_lookup_multi.deregister();
+        m_scan.deregister();
+        m_get_stats.deregister();
+        m_batch.deregister();
+        m_insert_noack.deregister();
+        m_erase_noack.deregister();
+        m_flush_writes.deregister();
+        m_end_write_session.deregister();
+        m_get_filter.deregister();
+        // the handlers spawned in another pool refer to the provider
+        waitForForwarded();
         spdlog::trace("[provider:{}]    => done!", id());
     }
 
+    /**
+     * Creates the I/O engine from the "io_engine" object of the provider
+     * configuration, falling back to the default options if it is invalid.
+     */
+    std::shared_ptr<IoEngine> makeIoEngine(const json& config) {
+        std::shared_ptr<IoEngine> engine;
+        if(config.is_object() && config.contains("io_engine")) {
+            auto& io_config = config["io_engine"];
+            IoEngineOptions options;
+            try {
+                options.type        = io_config.value("type", options.type);
+                options.queue_depth = io_config.value("queue_depth", options.queue_depth);
+                options.num_buffers = io_config.value("num_buffers", options.num_buffers);
+                options.buffer_size = io_config.value("buffer_size", options.buffer_size);
+                engine = std::make_shared<IoEngine>(options);
+            } catch(const std::exception& ex) {
+                spdlog::error("[provider:{}] Invalid I/O engine configuration: {}", id(), ex.what());
+            }
+        }
+        if(!engine) engine = std::make_shared<IoEngine>();
+        spdlog::trace("[provider:{}] Using {} I/O engine", id(),
+                engine->usesIoUring() ? "io_uring" : "blocking");
+        return engine;
+    }
+
+    /**
+     * Creates the block cache from the "block_cache" object of the provider
+     * configuration, falling back to the default options if it is invalid.
+     */
+    std::shared_ptr<BlockCache> makeBlockCache(const json& config) {
+        size_t   capacity   = kDefaultBlockCacheCapacity;
+        unsigned num_shards = kDefaultBlockCacheShards;
+        if(config.is_object() && config.contains("block_cache")) {
+            auto& cache_config = config["block_cache"];
+            try {
+                auto cache = std::make_shared<BlockCache>(
+                    cache_config.value("capacity", capacity),
+                    cache_config.value("num_shards", num_shards));
+                spdlog::trace("[provider:{}] Block cache of {} bytes in {} shards", id(),
+                        cache->capacity(), cache->numShards());
+                return cache;
+            } catch(const std::exception& ex) {
+                spdlog::error("[provider:{}] Invalid block cache configuration: {}", id(), ex.what());
+            }
+        }
+        return std::make_shared<BlockCache>(capacity, num_shards);
+    }
+
+    /**
+     * Creates the memory accounting from the "quotas" object of the provider
+     * configuration. Quotas are in bytes, 0 (the default) meaning no quota.
+     */
+    std::unique_ptr<MemoryQuota> makeMemoryQuota(const json& config) {
+        size_t provider_bytes  = 0;
+        size_t phonebook_bytes = 0;
+        double interval_ms     = kDefaultQuotaRefreshIntervalMs;
+        if(config.is_object() && config.contains("quotas")) {
+            auto& quota_config = config["quotas"];
+            try {
+                provider_bytes  = quota_config.value("provider_bytes", provider_bytes);
+                phonebook_bytes = quota_config.value("phonebook_bytes", phonebook_bytes);
+                interval_ms     = quota_config.value("refresh_interval_ms", interval_ms);
+            } catch(const std::exception& ex) {
+                spdlog::error("[provider:{}] Invalid quota configuration: {}", id(), ex.what());
+                provider_bytes  = 0;
+                phonebook_bytes = 0;
+                interval_ms     = kDefaultQuotaRefreshIntervalMs;
+            }
+        }
+        spdlog::trace("[provider:{}] Memory quotas of {} bytes per provider, {} bytes per phonebook",
+                id(), provider_bytes, phonebook_bytes);
+        return std::make_unique<MemoryQuota>(provider_bytes, phonebook_bytes, interval_ms);
+    }
+
+    /**
+     * Per-phonebook quota override, from the "quota_bytes" entry of the
+     * phonebook's configuration (0 if absent or invalid).
+     */
+    static size_t phonebookQuota(const json& config) {
+        if(!config.is_object()) return 0;
+        auto it = config.find("quota_bytes");
+        if(it == config.end() || !it->is_number_unsigned()) return 0;
+        return it->get<size_t>();
+    }
+
     std::string getConfig() const {
         auto config = json::object();
+        auto& options = m_io_engine->options();
+        config["io_engine"] = {
+            { "type",        options.type },
+            { "queue_depth", options.queue_depth },
+            { "num_buffers", options.num_buffers },
+            { "buffer_size", options.buffer_size }
+        };
+        config["block_cache"] = {
+            { "capacity",   m_block_cache->capacity() },
+            { "num_shards", m_block_cache->numShards() }
+        };
+        config["quotas"] = {
+            { "provider_bytes",      m_quota->providerLimit() },
+            { "phonebook_bytes",     m_quota->phonebookLimit() },
+            { "refresh_interval_ms", m_quota->refreshIntervalMs() }
+        };
+        config["one_way_writes"] = {
+            { "gap_timeout_ms",      m_write_gap_timeout_ms },
+            { "session_idle_ttl_ms", m_write_session_idle_ttl_ms }
+        };
+        if(m_idle_ttl_ms > 0) {
+            config["eviction"] = {
+                { "idle_ttl_ms",       m_idle_ttl_ms },
+                { "check_interval_ms", m_eviction_interval_ms },
+                { "directory",         m_eviction_directory }
+            };
+        }
         config["phonebooks"] = json::array();
         for(auto& pair : m_backends) {
             auto phonebook_config = json::object();
@@ -118,13 +906,254 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
             phonebook_config["config"] = json::parse(pair.second->getConfig());
             config["phonebooks"].push_back(phonebook_config);
         }
+        for(auto& pair : m_unloaded) {
+            auto phonebook_config = json::object();
+            phonebook_config["__id__"] = pair.first.to_string();
+            phonebook_config["type"] = pair.second.type;
+            phonebook_config["config"] = pair.second.config;
+            phonebook_config["lazy"] = true;
+            if(!pair.second.snapshot.empty())
+                phonebook_config["snapshot"] = pair.second.snapshot;
+            config["phonebooks"].push_back(phonebook_config);
+        }
         return config.dump();
     }
 
+    /**
+     * Registers a backend under a UUID, gives it a slot (the one kept
+     * for it if handle is the handle of an evicted phonebook), the I/O
+     * engine and the block cache, and starts accounting for its memory
+     * against the provided quota (0 for the provider's default).
+     * Must be called with m_backends_mtx held.
+     */
+    bool addBackend(const UUID& phonebook_id, std::shared_ptr<Backend> backend, size_t quota = 0,
+                    uint32_t handle = kInvalidSlotHandle) {
+        uint32_t index;
+        if(handle != kInvalidSlotHandle) {
+            index = slotIndex(handle);
+        } else if(!m_free_slots.empty()) {
+            index = m_free_slots.back();
+            m_free_slots.pop_back();
+        } else if(m_slots.size() < kMaxSlots) {
+            index = m_slots.size();
+            m_slots.emplace_back();
+        } else {
+            return false;
+        }
+        backend->setIoEngine(m_io_engine);
+        backend->setBlockCache(m_block_cache);
+        m_slots[index].phonebook_id = phonebook_id;
+        m_slots[index].backend      = backend;
+        m_slots[index].usage        = m_quota->track(*backend, quota);
+        m_slots[index].pins         = std::make_shared<std::atomic<uint32_t>>(0);
+        m_slots[index].last_access  = clock::now().time_since_epoch().count();
+        m_slots[index].evictable    = true;
+        m_slots[index].reserved     = false;
+        m_slot_handles[phonebook_id] = makeSlotHandle(index, m_slots[index].generation);
+        m_backends[phonebook_id] = std::move(backend);
+        return true;
+    }
+
+    /**
+     * Unregisters a backend. Its slot is freed, making its handles stale,
+     * unless keep_slot is true (the phonebook is evicted), in which case
+     * the slot is kept for the phonebook and its handle is returned.
+     * Must be called with m_backends_mtx held.
+     */
+    uint32_t removeBackend(const UUID& phonebook_id, bool keep_slot = false) {
+        uint32_t kept = kInvalidSlotHandle;
+        auto it = m_slot_handles.find(phonebook_id);
+        if(it != m_slot_handles.end()) {
+            auto index = slotIndex(it->second);
+            m_slots[index].backend.reset();
+            if(m_slots[index].usage) m_quota->untrack(*m_slots[index].usage);
+            m_slots[index].usage.reset();
+            m_slots[index].pins.reset();
+            if(keep_slot) {
+                m_slots[index].reserved = true;
+                kept = it->second;
+            } else {
+                releaseSlot(it->second);
+            }
+            m_slot_handles.erase(it);
+        }
+        m_backends.erase(phonebook_id);
+        return kept;
+    }
+
+    /**
+     * Frees a slot, making its handles stale (no-op for an invalid handle).
+     * Must be called with m_backends_mtx held.
+     */
+    void releaseSlot(uint32_t handle) {
+        if(handle == kInvalidSlotHandle) return;
+        auto index = slotIndex(handle);
+        m_slots[index].reserved = false;
+        m_slots[index].generation += 1;
+        m_free_slots.push_back(index);
+    }
+
+    /**
+     * Pins the backend of a slot for a request, updating its last access.
+     * Must be called with m_backends_mtx held.
+     */
+    SlotRef refSlot(uint32_t index) {
+        auto& slot = m_slots[index];
+        slot.last_access = clock::now().time_since_epoch().count();
+        SlotRef ref;
+        ref.backend = slot.backend;
+        ref.usage   = slot.usage;
+        ref.pin     = PhonebookPin(slot.pins);
+        return ref;
+    }
+
+    /**
+     * Returns the pinned backend of the slot a handle refers to, which is
+     * null if the handle is stale.
+     */
+    SlotRef findSlot(uint32_t phonebook_handle) {
+        std::lock_guard<tl::mutex> lock(m_backends_mtx);
+        auto index = slotIndex(phonebook_handle);
+        if(index >= m_slots.size()
+        || m_slots[index].generation != slotGeneration(phonebook_handle)
+        || !m_slots[index].backend)
+            return SlotRef();
+        return refSlot(index);
+    }
+
+    /**
+     * Same as findSlot, but if the handle refers to a phonebook that was
+     * evicted, reloads the phonebook (into the same slot). Used by the
+     * one-way writes, whose clients do not resolve stale handles.
+     */
+    SlotRef findSlotOrReload(uint32_t phonebook_handle) {
+        UUID phonebook_id;
+        {
+            std::lock_guard<tl::mutex> lock(m_backends_mtx);
+            auto index = slotIndex(phonebook_handle);
+            if(index >= m_slots.size()
+            || m_slots[index].generation != slotGeneration(phonebook_handle))
+                return SlotRef();
+            if(m_slots[index].backend) return refSlot(index);
+            if(!m_slots[index].reserved) return SlotRef();
+            phonebook_id = m_slots[index].phonebook_id;
+        }
+        SlotRef ref;
+        ensureLoaded(phonebook_id, &ref);
+        return ref;
+    }
+
+    /**
+     * Returns the memory accounting of a phonebook, or null if not found.
+     */
+    std::shared_ptr<MemoryQuota::Usage> findUsage(const UUID& phonebook_id) {
+        std::lock_guard<tl::mutex> lock(m_backends_mtx);
+        auto it = m_slot_handles.find(phonebook_id);
+        if(it == m_slot_handles.end()) return nullptr;
+        return m_slots[slotIndex(it->second)].usage;
+    }
+
+    /**
+     * Returns the state of the one-way writes of a client session,
+     * creating it on first use. A session is dropped when its client
+     * releases its handle (see endWriteSessionRPC) or, failing that,
+     * once it has not been used for the session idle TTL, which is
+     * checked whenever a session is created.
+     */
+    std::shared_ptr<WriteSession> writeSession(uint64_t session_id) {
+        auto now = clock::now().time_since_epoch().count();
+        std::lock_guard<tl::mutex> lock(m_write_sessions_mtx);
+        auto& session = m_write_sessions[session_id];
+        if(!session) {
+            session = std::make_shared<WriteSession>();
+            pruneWriteSessions(now);
+        }
+        session->last_used = now;
+        return session;
+    }
+
+    /**
+     * Drops the sessions unused for the session idle TTL, at most once
+     * per TTL. Must be called with m_write_sessions_mtx held.
+     */
+    void pruneWriteSessions(int64_t now) {
+        auto ttl = std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double, std::milli>(m_write_session_idle_ttl_ms)).count();
+        if(now - m_write_sessions_pruned < ttl) return;
+        m_write_sessions_pruned = now;
+        for(auto it = m_write_sessions.begin(); it != m_write_sessions.end();) {
+            if(now - it->second->last_used >= ttl) it = m_write_sessions.erase(it);
+            else ++it;
+        }
+    }
+
+    /**
+     * Records an error of the session, to be reported by the next flush.
+     * Must be called with the session's mutex held.
+     */
+    static void recordWriteError(WriteSession& session, std::string error) {
+        if(session.errors.size() < kMaxWriteErrors)
+            session.errors.push_back(std::move(error));
+        session.failed += 1;
+    }
+
+    /**
+     * Waits until all the writes of the session that precede seq have
+     * been applied. If none is applied for the gap timeout, the missing
+     * writes are taken as lost (one-way RPCs may be dropped): the session
+     * skips to the first write that arrived, or to seq if none did, and
+     * the loss is reported as an error by the next flush. A lost write
+     * that arrives later is then ignored. Must be called with the
+     * session's mutex held.
+     */
+    void waitForTurn(WriteSession& session, std::unique_lock<tl::mutex>& lock, uint64_t seq) {
+        while(session.next < seq) {
+            uint64_t observed = session.next;
+            auto deadline = deadlineIn(m_write_gap_timeout_ms);
+            session.cv.wait_until(lock, &deadline);
+            if(session.next != observed || !isPast(deadline)) continue;
+            uint64_t target = seq;
+            if(!session.waiting.empty())
+                target = std::min(target, *session.waiting.begin());
+            if(target <= session.next) continue; // its handler is about to run
+            recordWriteError(session, std::to_string(target - session.next)
+                + " one-way writes were lost");
+            spdlog::error("[provider:{}] One-way writes {} to {} were lost",
+                    id(), session.next, target - 1);
+            session.next = target;
+            session.cv.notify_all();
+        }
+    }
+
+    /**
+     * Waits for the turn of the write seq of the session (see
+     * waitForTurn), applies it with the provided function, which returns
+     * its result, and lets the next write go. Writes are thereby applied
+     * in the order in which the client issued them, whichever order
+     * their handlers run in.
+     */
+    template<typename Apply>
+    void applyInOrder(uint64_t session_id, uint64_t seq, const char* op, Apply&& apply) {
+        auto session = writeSession(session_id);
+        std::unique_lock<tl::mutex> lock(session->mutex);
+        if(session->next < seq) {
+            session->waiting.insert(seq);
+            waitForTurn(*session, lock, seq);
+            session->waiting.erase(seq);
+        }
+        if(session->next > seq) return; // duplicate, or taken as lost
+        RequestResult<bool> result = apply();
+        if(!result.success())
+            recordWriteError(*session, op + ": "s + result.error());
+        session->next += 1;
+        session->last_used = clock::now().time_since_epoch().count();
+        session->cv.notify_all();
+    }
+
     RequestResult<UUID> createPhonebook(const std::string& phonebook_type,
-                                       const std::string& phonebook_config) {
+                                       const std::string& phonebook_config,
+                                       const UUID& phonebook_id = UUID::generate()) {
 
-        auto phonebook_id = UUID::generate();
         RequestResult<UUID> result;
 
         json json_config;
@@ -138,6 +1167,13 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
             return result;
         }
 
+        if(!m_quota->admitPhonebook()) {
+            result.fail(Status::QuotaExceeded);
+            spdlog::error("[provider:{}] Could not create phonebook {}: {}",
+                    id(), phonebook_id.to_string(), result.error());
+            return result;
+        }
+
         std::unique_ptr<Backend> backend;
         try {
             backend = PhonebookFactory::createPhonebook(phonebook_type, get_engine(), json_config);
@@ -158,7 +1194,19 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
             return result;
         } else {
             std::lock_guard<tl::mutex> lock(m_backends_mtx);
-            m_backends[phonebook_id] = std::move(backend);
+            if(m_backends.count(phonebook_id) || m_unloaded.count(phonebook_id)) {
+                result.success() = false;
+                result.error() = "Phonebook "s + phonebook_id.to_string() + " is already registered";
+                spdlog::error("[provider:{}] {}", id(), result.error());
+                return result;
+            }
+            if(!addBackend(phonebook_id, std::move(backend), phonebookQuota(json_config))) {
+                result.success() = false;
+                result.error() = "Too many phonebooks in provider";
+                spdlog::error("[provider:{}] Could not add phonebook {}: {}",
+                        id(), phonebook_id.to_string(), result.error());
+                return result;
+            }
             result.value() = phonebook_id;
         }
 
@@ -179,8 +1227,7 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         RequestResult<UUID> result;
 
         if(m_token.size() > 0 && m_token != token) {
-            result.success() = false;
-            result.error() = "Invalid security token";
+            result.fail(Status::InvalidToken);
             req.respond(result);
             spdlog::error("[provider:{}] Invalid security token {}", id(), token);
             return;
@@ -204,8 +1251,7 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         RequestResult<UUID> result;
 
         if(m_token.size() > 0 && m_token != token) {
-            result.success() = false;
-            result.error() = "Invalid security token";
+            result.fail(Status::InvalidToken);
             req.respond(result);
             spdlog::error("[provider:{}] Invalid security token {}", id(), token);
             return;
@@ -223,6 +1269,14 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
             return;
         }
 
+        if(!m_quota->admitPhonebook()) {
+            result.fail(Status::QuotaExceeded);
+            spdlog::error("[provider:{}] Could not open phonebook {}: {}",
+                    id(), phonebook_id.to_string(), result.error());
+            req.respond(result);
+            return;
+        }
+
         std::unique_ptr<Backend> backend;
         try {
             backend = PhonebookFactory::openPhonebook(phonebook_type, get_engine(), json_config);
@@ -245,7 +1299,14 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
             return;
         } else {
             std::lock_guard<tl::mutex> lock(m_backends_mtx);
-            m_backends[phonebook_id] = std::move(backend);
+            if(!addBackend(phonebook_id, std::move(backend), phonebookQuota(json_config))) {
+                result.success() = false;
+                result.error() = "Too many phonebooks in provider";
+                spdlog::error("[provider:{}] Could not add phonebook {}: {}",
+                        id(), phonebook_id.to_string(), result.error());
+                req.respond(result);
+                return;
+            }
             result.value() = phonebook_id;
         }
 
@@ -263,25 +1324,33 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         RequestResult<bool> result;
 
         if(m_token.size() > 0 && m_token != token) {
-            result.success() = false;
-            result.error() = "Invalid security token";
+            result.fail(Status::InvalidToken);
             req.respond(result);
             spdlog::error("[provider:{}] Invalid security token {}", id(), token);
             return;
         }
 
         {
-            std::lock_guard<tl::mutex> lock(m_backends_mtx);
+            std::unique_lock<tl::mutex> lock(m_backends_mtx);
 
-            if(m_backends.count(phonebook_id) == 0) {
-                result.success() = false;
-                result.error() = "Phonebook "s + phonebook_id.to_string() + " not found";
+            // a phonebook that was never loaded is simply forgotten
+            auto it = m_unloaded.find(phonebook_id);
+            while(it != m_unloaded.end() && it->second.loading) {
+                m_loading_cv.wait(lock);
+                it = m_unloaded.find(phonebook_id);
+            }
+            if(it != m_unloaded.end()) {
+                if(!it->second.snapshot.empty()) ::unlink(it->second.snapshot.c_str());
+                releaseSlot(it->second.handle);
+                m_unloaded.erase(it);
+            } else if(m_backends.count(phonebook_id) == 0) {
+                result.fail(Status::PhonebookNotFound);
                 req.respond(result);
                 spdlog::error("[provider:{}] Phonebook {} not found", id(), phonebook_id.to_string());
                 return;
+            } else {
+                removeBackend(phonebook_id);
             }
-
-            m_backends.erase(phonebook_id);
         }
         req.respond(result);
         spdlog::trace("[provider:{}] Phonebook {} successfully closed", id(), phonebook_id.to_string());
@@ -294,60 +1363,526 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         spdlog::trace("[provider:{}] Received destroyPhonebook request for phonebook {}", id(), phonebook_id.to_string());
 
         if(m_token.size() > 0 && m_token != token) {
-            result.success() = false;
-            result.error() = "Invalid security token";
+            result.fail(Status::InvalidToken);
             req.respond(result);
             spdlog::error("[provider:{}] Invalid security token {}", id(), token);
             return;
         }
 
+        // the backend knows what to destroy, even if it was never loaded;
+        // it is loaded regardless of the memory quota, which destroying
+        // it relieves
+        auto loaded = ensureLoaded(phonebook_id, nullptr, false);
+        if(!loaded.success() && loaded.status() != Status::PhonebookNotFound) {
+            // a phonebook that cannot be loaded cannot be destroyed
+            // either, it is only forgotten: the provider no longer knows
+            // it, but whatever its backend stored is left in place
+            {
+                std::unique_lock<tl::mutex> lock(m_backends_mtx);
+                auto it = m_unloaded.find(phonebook_id);
+                while(it != m_unloaded.end() && it->second.loading) {
+                    m_loading_cv.wait(lock);
+                    it = m_unloaded.find(phonebook_id);
+                }
+                if(it != m_unloaded.end()) {
+                    if(!it->second.snapshot.empty()) ::unlink(it->second.snapshot.c_str());
+                    releaseSlot(it->second.handle);
+                    m_unloaded.erase(it);
+                }
+            }
+            result.success() = false;
+            result.error() = "Phonebook was removed from the provider but its data "
+                             "could not be destroyed: "s + loaded.error();
+            req.respond(result);
+            spdlog::error("[provider:{}] Could not destroy phonebook {}: {}",
+                    id(), phonebook_id.to_string(), result.error());
+            return;
+        }
+
         {
             std::lock_guard<tl::mutex> lock(m_backends_mtx);
 
             if(m_backends.count(phonebook_id) == 0) {
-                result.success() = false;
-                result.error() = "Phonebook "s + phonebook_id.to_string() + " not found";
+                result.fail(Status::PhonebookNotFound);
                 req.respond(result);
                 spdlog::error("[provider:{}] Phonebook {} not found", id(), phonebook_id.to_string());
                 return;
             }
 
             result = m_backends[phonebook_id]->destroy();
-            m_backends.erase(phonebook_id);
+            removeBackend(phonebook_id);
         }
 
         req.respond(result);
         spdlog::trace("[provider:{}] Phonebook {} successfully destroyed", id(), phonebook_id.to_string());
     }
 
+    /**
+     * @brief Pool in which backends may spread work across ULTs
+     * (e.g. to take or restore a snapshot in parallel).
+     */
+    tl::pool workPool() const {
+        auto target = m_target_pool.load();
+        return target == ABT_POOL_NULL ? m_engine.get_handler_pool() : tl::pool(target);
+    }
+
+    void snapshotPhonebookRPC(const tl::request& req,
+                              const std::string& token,
+                              const UUID& phonebook_id,
+                              const std::string& path) {
+        spdlog::trace("[provider:{}] Received snapshotPhonebook request for phonebook {}",
+                id(), phonebook_id.to_string());
+        spdlog::trace("[provider:{}]    => path = {}", id(), path);
+
+        RequestResult<bool> result;
+
+        if(m_token.size() > 0 && m_token != token) {
+            result.fail(Status::InvalidToken);
+            req.respond(result);
+            spdlog::error("[provider:{}] Invalid security token {}", id(), token);
+            return;
+        }
+
+        FIND_PHONEBOOK(phonebook);
+        result = phonebook->snapshot(path, workPool());
+        req.respond(result);
+        if(result.success())
+            spdlog::trace("[provider:{}] Phonebook {} successfully written to {}",
+                    id(), phonebook_id.to_string(), path);
+        else
+            spdlog::error("[provider:{}] Could not snapshot phonebook {}: {}",
+                    id(), phonebook_id.to_string(), result.error());
+    }
+
+    void restorePhonebookRPC(const tl::request& req,
+                             const std::string& token,
+                             const UUID& phonebook_id,
+                             const std::string& path) {
+        spdlog::trace("[provider:{}] Received restorePhonebook request for phonebook {}",
+                id(), phonebook_id.to_string());
+        spdlog::trace("[provider:{}]    => path = {}", id(), path);
+
+        RequestResult<bool> result;
+
+        if(m_token.size() > 0 && m_token != token) {
+            result.fail(Status::InvalidToken);
+            req.respond(result);
+            spdlog::error("[provider:{}] Invalid security token {}", id(), token);
+            return;
+        }
+
+        FIND_PHONEBOOK(phonebook);
+        result = phonebook->restore(path, workPool());
+        // the content was replaced wholesale, account for it right away
+        auto usage = findUsage(phonebook_id);
+        if(usage) m_quota->refresh(*phonebook, *usage);
+        req.respond(result);
+        if(result.success())
+            spdlog::trace("[provider:{}] Phonebook {} successfully restored from {}",
+                    id(), phonebook_id.to_string(), path);
+        else
+            spdlog::error("[provider:{}] Could not restore phonebook {}: {}",
+                    id(), phonebook_id.to_string(), result.error());
+    }
+
+    void checkpointPhonebookRPC(const tl::request& req,
+                                const std::string& token,
+                                const UUID& phonebook_id,
+                                const std::string& directory) {
+        spdlog::trace("[provider:{}] Received checkpointPhonebook request for phonebook {}",
+                id(), phonebook_id.to_string());
+        spdlog::trace("[provider:{}]    => directory = {}", id(), directory);
+
+        RequestResult<bool> result;
+
+        if(m_token.size() > 0 && m_token != token) {
+            result.fail(Status::InvalidToken);
+            req.respond(result);
+            spdlog::error("[provider:{}] Invalid security token {}", id(), token);
+            return;
+        }
+
+        FIND_PHONEBOOK(phonebook);
+        result = phonebook->checkpoint(directory, workPool());
+        req.respond(result);
+        if(result.success())
+            spdlog::trace("[provider:{}] Phonebook {} successfully checkpointed in {}",
+                    id(), phonebook_id.to_string(), directory);
+        else
+            spdlog::error("[provider:{}] Could not checkpoint phonebook {}: {}",
+                    id(), phonebook_id.to_string(), result.error());
+    }
+
+    void getLoadRPC(const tl::request& req,
+                    const std::string& token) {
+        spdlog::trace("[provider:{}] Received getLoad request", id());
+        RequestResult<std::string> result;
+        if(m_token.size() > 0 && m_token != token) {
+            result.fail(Status::InvalidToken);
+            req.respond(result);
+            spdlog::error("[provider:{}] Invalid security token {}", id(), token);
+            return;
+        }
+        result.value() = getLoad();
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully sent the load", id());
+    }
+
     void checkPhonebookRPC(const tl::request& req,
                           const UUID& phonebook_id) {
         spdlog::trace("[provider:{}] Received checkPhonebook request for phonebook {}", id(), phonebook_id.to_string());
-        RequestResult<bool> result;
-        FIND_PHONEBOOK(phonebook);
-        result.success() = true;
+        // the first request for a lazy phonebook loads it
+        auto result = ensureLoaded(phonebook_id);
+        if(!result.success()) {
+            req.respond(result);
+            spdlog::error("[provider:{}] Phonebook {}: {}", id(), phonebook_id.to_string(), result.error());
+            return;
+        }
         req.respond(result);
         spdlog::trace("[provider:{}] Code successfully executed on phonebook {}", id(), phonebook_id.to_string());
     }
 
     void sayHelloRPC(const tl::request& req,
-                     const UUID& phonebook_id) {
-        spdlog::trace("[provider:{}] Received sayHello request for phonebook {}", id(), phonebook_id.to_string());
+                     uint32_t phonebook_handle) {
+        spdlog::trace("[provider:{}] Received sayHello request for phonebook handle {}", id(), phonebook_handle);
         RequestResult<bool> result;
-        FIND_PHONEBOOK(phonebook);
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
         phonebook->sayHello();
-        spdlog::trace("[provider:{}] Successfully executed sayHello on phonebook {}", id(), phonebook_id.to_string());
+        spdlog::trace("[provider:{}] Successfully executed sayHello on phonebook handle {}", id(), phonebook_handle);
     }
 
     void computeSumRPC(const tl::request& req,
-                       const UUID& phonebook_id,
+                       uint32_t phonebook_handle,
                        int32_t x, int32_t y) {
-        spdlog::trace("[provider:{}] Received computeSum request for phonebook {}", id(), phonebook_id.to_string());
+        spdlog::trace("[provider:{}] Received computeSum request for phonebook handle {}", id(), phonebook_handle);
         RequestResult<int32_t> result;
-        FIND_PHONEBOOK(phonebook);
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
         result = phonebook->computeSum(x, y);
         req.respond(result);
-        spdlog::trace("[provider:{}] Successfully executed computeSum on phonebook {}", id(), phonebook_id.to_string());
+        spdlog::trace("[provider:{}] Successfully executed computeSum on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void batchRPC(const tl::request& req,
+                  uint32_t phonebook_handle,
+                  const BatchOpList& list) {
+        auto& ops = list.ops;
+        spdlog::trace("[provider:{}] Received batch of {} operations for phonebook handle {}",
+                      id(), ops.size(), phonebook_handle);
+        RequestResult<std::vector<BatchOpResult>> result;
+        if(!list.valid) {
+            // none is executed, since the batch could not be fully decoded
+            result.success() = false;
+            result.error() = "Unknown operation in batch";
+            req.respond(result);
+            spdlog::error("[provider:{}] {}", id(), result.error());
+            return;
+        }
+        FIND_PHONEBOOK_AND_USAGE_BY_HANDLE(phonebook);
+        auto& results = result.value();
+        results.resize(ops.size());
+        // operations are executed in the order in which they were issued
+        for(size_t i = 0; i < ops.size(); i++) {
+            auto& op = ops[i];
+            auto& r  = results[i];
+            r.kind = op.kind;
+            switch(op.kind) {
+                case BatchOp::Kind::ComputeSum:
+                    r.sum = phonebook->computeSum(op.x, op.y);
+                    break;
+                case BatchOp::Kind::Insert:
+                    if(m_quota->admit(*phonebook, *phonebook_usage))
+                        r.done = phonebook->insert(op.name, op.number);
+                    else
+                        r.done.fail(Status::QuotaExceeded);
+                    break;
+                case BatchOp::Kind::Lookup:
+                    r.number = phonebook->lookup(op.name);
+                    break;
+                case BatchOp::Kind::Erase:
+                    r.done = phonebook->erase(op.name);
+                    break;
+                case BatchOp::Kind::Unknown:
+                    break; // rejected when decoded
+            }
+        }
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed batch on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void computeSumManyRPC(const tl::request& req,
+                           uint32_t phonebook_handle,
+                           uint64_t n,
+                           bool with_overflow,
+                           tl::bulk data) {
+        spdlog::trace("[provider:{}] Received computeSumMany request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<bool> result;
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
+        if(n == 0) {
+            req.respond(result);
+            return;
+        }
+        // the client's buffer holds x, y, out, then the overflow bitmap;
+        // n is bounded first, so that none of the sizes below can overflow
+        size_t words       = (n + 63) / 64;
+        size_t in_size     = 0;
+        size_t out_size    = 0;
+        size_t bitmap_size = 0;
+        if(n <= data.size() / (3 * sizeof(int32_t))) {
+            in_size     = 2 * n * sizeof(int32_t);
+            out_size    = n * sizeof(int32_t);
+            bitmap_size = with_overflow ? words * sizeof(uint64_t) : 0;
+        }
+        if(in_size == 0 || data.size() < in_size + out_size + bitmap_size) {
+            result.success() = false;
+            result.error() = "Bulk handle is too small for "s + std::to_string(n) + " pairs";
+            req.respond(result);
+            spdlog::error("[provider:{}] {}", id(), result.error());
+            return;
+        }
+        try {
+            std::vector<int32_t> values(3 * n);
+            std::vector<uint64_t> overflow(words);
+            std::vector<std::pair<void*, size_t>> segments = {
+                { values.data(), values.size() * sizeof(int32_t) },
+                { overflow.data(), overflow.size() * sizeof(uint64_t) }
+            };
+            auto local = m_engine.expose(segments, tl::bulk_mode::read_write);
+            auto remote = data.on(req.get_endpoint());
+            remote(0, in_size) >> local(0, in_size);
+            result = phonebook->computeSumMany(values.data(), values.data() + n,
+                                               values.data() + 2 * n, overflow.data(), n);
+            if(result.success())
+                remote(in_size, out_size + bitmap_size) << local(in_size, out_size + bitmap_size);
+        } catch(const std::exception& ex) {
+            result.success() = false;
+            result.error() = ex.what();
+        }
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed computeSumMany on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void insertRPC(const tl::request& req,
+                   uint32_t phonebook_handle,
+                   const InputString& name,
+                   const InputString& number) {
+        spdlog::trace("[provider:{}] Received insert request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<bool> result;
+        FIND_PHONEBOOK_AND_USAGE_BY_HANDLE(phonebook);
+        if(!m_quota->admit(*phonebook, *phonebook_usage)) {
+            result.fail(Status::QuotaExceeded);
+            req.respond(result);
+            spdlog::trace("[provider:{}] Rejected insert on phonebook handle {}: {}",
+                    id(), phonebook_handle, result.error());
+            return;
+        }
+        result = phonebook->insert(name.view(), number.view());
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed insert on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void lookupRPC(const tl::request& req,
+                   uint32_t phonebook_handle,
+                   const InputString& name) {
+        spdlog::trace("[provider:{}] Received lookup request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<std::string> result;
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
+        result = phonebook->lookup(name.view());
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed lookup on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void lookupMultiRPC(const tl::request& req,
+                        uint32_t phonebook_handle,
+                        const std::vector<InputString>& names) {
+        spdlog::trace("[provider:{}] Received lookupMulti request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<LookupBuffer> result;
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
+        std::vector<std::string_view> views(names.begin(), names.end());
+        result = phonebook->lookupMulti(views);
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed lookupMulti on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void eraseRPC(const tl::request& req,
+                  uint32_t phonebook_handle,
+                  const InputString& name) {
+        spdlog::trace("[provider:{}] Received erase request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<bool> result;
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
+        result = phonebook->erase(name.view());
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed erase on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void searchRPC(const tl::request& req,
+                   uint32_t phonebook_handle,
+                   const std::string& pattern,
+                   uint32_t max_edit_distance,
+                   uint64_t limit) {
+        spdlog::trace("[provider:{}] Received search request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<std::vector<std::pair<std::string, std::string>>> result;
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
+        result = phonebook->search(pattern, max_edit_distance, limit);
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed search on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void reverseLookupRPC(const tl::request& req,
+                          uint32_t phonebook_handle,
+                          const std::string& number) {
+        spdlog::trace("[provider:{}] Received reverseLookup request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<std::vector<std::string>> result;
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
+        result = phonebook->reverseLookup(number);
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed reverseLookup on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void insertNoAckRPC(const tl::request&,
+                        uint32_t phonebook_handle,
+                        uint64_t session_id,
+                        uint64_t seq,
+                        const InputString& name,
+                        const InputString& number) {
+        spdlog::trace("[provider:{}] Received insertNoAck request {} for phonebook handle {}", id(), seq, phonebook_handle);
+        applyInOrder(session_id, seq, "insert", [&]() {
+            RequestResult<bool> result;
+            auto slot = findSlotOrReload(phonebook_handle);
+            if(!slot.backend) result.fail(Status::StaleHandle);
+            else if(!m_quota->admit(*slot.backend, *slot.usage)) result.fail(Status::QuotaExceeded);
+            else result = slot.backend->insert(name.view(), number.view());
+            return result;
+        });
+        spdlog::trace("[provider:{}] Applied insertNoAck request {} on phonebook handle {}", id(), seq, phonebook_handle);
+    }
+
+    void eraseNoAckRPC(const tl::request&,
+                       uint32_t phonebook_handle,
+                       uint64_t session_id,
+                       uint64_t seq,
+                       const InputString& name) {
+        spdlog::trace("[provider:{}] Received eraseNoAck request {} for phonebook handle {}", id(), seq, phonebook_handle);
+        applyInOrder(session_id, seq, "erase", [&]() {
+            RequestResult<bool> result;
+            auto phonebook = findSlotOrReload(phonebook_handle).backend;
+            if(!phonebook) result.fail(Status::StaleHandle);
+            else result = phonebook->erase(name.view());
+            return result;
+        });
+        spdlog::trace("[provider:{}] Applied eraseNoAck request {} on phonebook handle {}", id(), seq, phonebook_handle);
+    }
+
+    void flushWritesRPC(const tl::request& req,
+                        uint32_t phonebook_handle,
+                        uint64_t session_id,
+                        uint64_t count) {
+        spdlog::trace("[provider:{}] Received flush request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<std::vector<std::string>> result;
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
+        auto session = writeSession(session_id);
+        {
+            std::unique_lock<tl::mutex> lock(session->mutex);
+            waitForTurn(*session, lock, count);
+            if(session->failed > session->errors.size())
+                session->errors.push_back("... and "s
+                    + std::to_string(session->failed - session->errors.size())
+                    + " more errors");
+            result.value().swap(session->errors);
+            session->failed = 0;
+        }
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully flushed writes on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void endWriteSessionRPC(const tl::request&,
+                            uint64_t session_id,
+                            uint64_t count) {
+        spdlog::trace("[provider:{}] Received end of write session after {} writes", id(), count);
+        std::shared_ptr<WriteSession> session;
+        {
+            std::lock_guard<tl::mutex> lock(m_write_sessions_mtx);
+            auto it = m_write_sessions.find(session_id);
+            if(it == m_write_sessions.end()) return;
+            session = it->second;
+        }
+        {
+            // the writes that precede the end are applied first
+            std::unique_lock<tl::mutex> lock(session->mutex);
+            waitForTurn(*session, lock, count);
+        }
+        std::lock_guard<tl::mutex> lock(m_write_sessions_mtx);
+        auto it = m_write_sessions.find(session_id);
+        if(it != m_write_sessions.end() && it->second == session)
+            m_write_sessions.erase(it);
+        spdlog::trace("[provider:{}] Ended write session after {} writes", id(), count);
+    }
+
+    void reverseLookupMultiRPC(const tl::request& req,
+                               uint32_t phonebook_handle,
+                               const std::vector<std::string>& numbers) {
+        spdlog::trace("[provider:{}] Received reverseLookupMulti request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<std::vector<std::vector<std::string>>> result;
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
+        result = phonebook->reverseLookupMulti(numbers);
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed reverseLookupMulti on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void scanRPC(const tl::request& req,
+                 uint32_t phonebook_handle,
+                 const ScanQuery& query) {
+        spdlog::trace("[provider:{}] Received scan request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<ScanResult> result;
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
+        result = phonebook->scan(query, workPool());
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed scan on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void getFilterRPC(const tl::request& req,
+                      uint32_t phonebook_handle,
+                      uint64_t epoch,
+                      uint64_t version) {
+        spdlog::trace("[provider:{}] Received getFilter request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<FilterUpdate> result;
+        FIND_PHONEBOOK_BY_HANDLE(phonebook);
+        result = phonebook->getFilter(epoch, version);
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed getFilter on phonebook handle {}", id(), phonebook_handle);
+    }
+
+    void getStatsRPC(const tl::request& req,
+                     uint32_t phonebook_handle) {
+        spdlog::trace("[provider:{}] Received getStats request for phonebook handle {}", id(), phonebook_handle);
+        RequestResult<std::string> result;
+        FIND_PHONEBOOK_AND_USAGE_BY_HANDLE(phonebook);
+        result.value() = phonebook->getStats();
+        // usage of the provider-wide block cache, whatever the backend
+        auto stats = json::parse(result.value(), nullptr, false);
+        if(stats.is_object()) {
+            auto usage  = m_block_cache->stats(phonebook->blockCacheOwner());
+            auto total  = m_block_cache->totals();
+            auto reads  = usage.hits + usage.misses;
+            stats["block_cache"] = {
+                { "bytes",          usage.bytes },
+                { "blocks",         usage.blocks },
+                { "hits",           usage.hits },
+                { "misses",         usage.misses },
+                { "hit_rate",       reads == 0 ? 0.0 : static_cast<double>(usage.hits) / reads },
+                { "provider_bytes", total.bytes },
+                { "capacity",       m_block_cache->capacity() }
+            };
+            // memory accounting, as of the last refresh
+            stats["memory"] = {
+                { "resident_bytes",       phonebook_usage->bytes.load() },
+                { "quota_bytes",          phonebook_usage->limit },
+                { "provider_bytes",       m_quota->totalBytes() },
+                { "provider_quota_bytes", m_quota->providerLimit() }
+            };
+            result.value() = stats.dump();
+        }
+        req.respond(result);
+        spdlog::trace("[provider:{}] Successfully executed getStats on phonebook handle {}", id(), phonebook_handle);
     }
 
 };
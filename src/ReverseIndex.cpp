@@ -0,0 +1,64 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "ReverseIndex.hpp"
+#include "Hash.hpp"
+#include <algorithm>
+
+namespace yp {
+
+static size_t heapSize(const std::string& str) {
+    // strings that fit in the small-string buffer do not allocate
+    auto self = reinterpret_cast<const char*>(&str);
+    if(str.data() >= self && str.data() < self + sizeof(str)) return 0;
+    return str.capacity() + 1;
+}
+
+void ReverseIndex::add(std::string_view number, std::string_view name) {
+    auto& names = m_names[hashBytes(number.data(), number.size())];
+    m_heap_bytes -= names.capacity() * sizeof(std::string);
+    names.emplace_back(name);
+    m_heap_bytes += names.capacity() * sizeof(std::string) + heapSize(names.back());
+}
+
+void ReverseIndex::remove(std::string_view number, std::string_view name) {
+    auto it = m_names.find(hashBytes(number.data(), number.size()));
+    if(it == m_names.end()) return;
+    auto& names = it->second;
+    auto pos = std::find(names.begin(), names.end(), name);
+    if(pos == names.end()) return;
+    if(names.size() == 1) {
+        m_heap_bytes -= names.capacity() * sizeof(std::string) + heapSize(names[0]);
+        m_names.erase(it);
+        return;
+    }
+    m_heap_bytes -= heapSize(names.back());
+    if(pos + 1 != names.end()) {
+        // moving a short string into a long one keeps the long one's buffer
+        m_heap_bytes -= heapSize(*pos);
+        *pos = std::move(names.back());
+        m_heap_bytes += heapSize(*pos);
+    }
+    names.pop_back();
+}
+
+void ReverseIndex::find(std::string_view number,
+                        const std::function<void(const std::string&)>& f) const {
+    auto it = m_names.find(hashBytes(number.data(), number.size()));
+    if(it == m_names.end()) return;
+    for(auto& name : it->second)
+        f(name);
+}
+
+size_t ReverseIndex::memoryUsage() const {
+    // estimate of libstdc++'s unordered_map layout, as in MapStore::stats
+    constexpr size_t node_size = sizeof(void*)
+                               + sizeof(std::pair<const uint64_t, std::vector<std::string>>);
+    return m_names.bucket_count() * sizeof(void*)
+         + m_names.size() * node_size
+         + m_heap_bytes;
+}
+
+}
@@ -0,0 +1,61 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_REVERSE_INDEX_H
+#define __YP_REVERSE_INDEX_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace yp {
+
+/**
+ * @brief Secondary index from numbers to the names associated with them.
+ * Like EntryStore, it is not thread-safe and is meant to be updated under
+ * the same lock as the store it indexes.
+ *
+ * Numbers are not stored: names are bucketed by the 64-bit hash of their
+ * number, so find() may report names whose number merely has the same
+ * hash, and callers must check the number of each name it reports.
+ */
+class ReverseIndex {
+
+    public:
+
+    /**
+     * @brief Records that name is associated with number.
+     */
+    void add(std::string_view number, std::string_view name);
+
+    /**
+     * @brief Removes the association between name and number, if present.
+     */
+    void remove(std::string_view number, std::string_view name);
+
+    /**
+     * @brief Calls f(name) for the names that may be associated with number.
+     */
+    void find(std::string_view number,
+              const std::function<void(const std::string&)>& f) const;
+
+    /**
+     * @brief Approximate number of bytes used by the index, in constant time.
+     */
+    size_t memoryUsage() const;
+
+    private:
+
+    // most numbers belong to a single name
+    std::unordered_map<uint64_t, std::vector<std::string>> m_names;
+    size_t m_heap_bytes = 0; // allocated by the vectors and strings, so that memoryUsage() is O(1)
+};
+
+}
+
+#endif
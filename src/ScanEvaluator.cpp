@@ -0,0 +1,171 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "ScanEvaluator.hpp"
+#include "yp/Exception.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <string>
+
+namespace yp {
+
+using Field     = ScanQuery::Field;
+using Op        = ScanQuery::Op;
+using Aggregate = ScanQuery::Aggregate;
+
+// Regex predicates come from clients and are evaluated in ULTs with small
+// stacks, so both the pattern and the values they are matched against are
+// bounded. libstdc++ otherwise matches by recursive backtracking (depth
+// growing with the value, time exponential in the pattern); its polynomial
+// mode uses a breadth-first executor instead and rejects back-references,
+// but still recurses over the automaton, which counted repetitions expand.
+static constexpr size_t kMaxRegexLength = 256;
+static constexpr size_t kMaxRegexValue  = 1024;
+static constexpr size_t kMaxRegexStates = 4096;
+#ifdef __GLIBCXX__
+static constexpr auto kRegexFlags = std::regex::ECMAScript | std::regex::optimize
+                                  | std::regex_constants::__polynomial;
+#else
+static constexpr auto kRegexFlags = std::regex::ECMAScript | std::regex::optimize;
+#endif
+
+// Over-estimates the size of the automaton of a pattern: its length
+// multiplied by the bound of every counted repetition ({n}, {n,}, {n,m}).
+static size_t estimateRegexStates(const std::string& pattern) {
+    size_t states = std::max<size_t>(pattern.size(), 1);
+    bool in_class = false;
+    for(size_t i = 0; i < pattern.size(); i++) {
+        char c = pattern[i];
+        if(c == '\\') { i += 1; continue; }
+        if(in_class) { in_class = c != ']'; continue; }
+        if(c == '[') { in_class = true; continue; }
+        if(c != '{') continue;
+        size_t bound = 0, count = 0;
+        size_t j = i + 1;
+        for(; j < pattern.size(); j++) {
+            if(pattern[j] == ',') { count = 0; continue; }
+            if(!std::isdigit(static_cast<unsigned char>(pattern[j]))) break;
+            count = std::min<size_t>(count * 10 + (pattern[j] - '0'), kMaxRegexStates + 1);
+            bound = std::max(bound, count);
+        }
+        if(j == pattern.size() || pattern[j] != '}') continue;
+        states = std::min<size_t>(states * std::max<size_t>(bound, 1), kMaxRegexStates + 1);
+        i = j;
+    }
+    return states;
+}
+
+ScanEvaluator::ScanEvaluator(const ScanQuery& query)
+: m_query(query) {
+    if(query.field() > Field::Number || query.aggregate() > Aggregate::CountDistinct)
+        throw Exception("Invalid scan query");
+    m_regexes.resize(query.predicates().size());
+    for(size_t i = 0; i < query.predicates().size(); i++) {
+        auto& predicate = query.predicates()[i];
+        if(predicate.field > Field::Number || predicate.op > Op::Regex)
+            throw Exception("Invalid scan query");
+        if(predicate.op != Op::Regex) continue;
+        if(predicate.operand.size() > kMaxRegexLength)
+            throw Exception("Regular expression longer than "
+                            + std::to_string(kMaxRegexLength) + " characters");
+        if(estimateRegexStates(predicate.operand) > kMaxRegexStates)
+            throw Exception("Regular expression \"" + predicate.operand + "\" repeats too much");
+        try {
+            m_regexes[i] = std::regex(predicate.operand, kRegexFlags);
+        } catch(const std::regex_error& ex) {
+            throw Exception("Invalid regular expression \"" + predicate.operand + "\": " + ex.what());
+        }
+    }
+}
+
+bool ScanEvaluator::matches(const std::string& name, const std::string& number) const {
+    auto& predicates = m_query.predicates();
+    for(size_t i = 0; i < predicates.size(); i++) {
+        auto& p = predicates[i];
+        const std::string& value = p.field == Field::Name ? name : number;
+        bool ok = false;
+        switch(p.op) {
+            case Op::Equal:        ok = value == p.operand; break;
+            case Op::NotEqual:     ok = value != p.operand; break;
+            case Op::Less:         ok = value <  p.operand; break;
+            case Op::LessEqual:    ok = value <= p.operand; break;
+            case Op::Greater:      ok = value >  p.operand; break;
+            case Op::GreaterEqual: ok = value >= p.operand; break;
+            case Op::Prefix:       ok = value.compare(0, p.operand.size(), p.operand) == 0; break;
+            case Op::Regex:
+                ok = value.size() <= kMaxRegexValue
+                  && std::regex_search(value, m_regexes[i]);
+                break;
+        }
+        if(!ok) return false;
+    }
+    return true;
+}
+
+ScanEvaluator::Partial ScanEvaluator::makePartial() const {
+    Partial partial;
+    if(m_query.aggregate() == Aggregate::CountDistinct)
+        partial.distinct.reset(new HyperLogLog());
+    return partial;
+}
+
+void ScanEvaluator::accumulate(Partial& partial, const std::string& name, const std::string& number) const {
+    if(!matches(name, number)) return;
+    partial.count += 1;
+    const std::string& value = m_query.field() == Field::Name ? name : number;
+    switch(m_query.aggregate()) {
+        case Aggregate::None:
+            partial.entries.emplace_back(name, number);
+            if(m_query.limit() && partial.entries.size() > 2 * m_query.limit())
+                trimEntries(partial);
+            break;
+        case Aggregate::Count:
+            break;
+        case Aggregate::GroupByCount:
+            if(m_query.offset() < value.size())
+                partial.groups[value.substr(m_query.offset(), m_query.length())] += 1;
+            else
+                partial.groups[std::string()] += 1;
+            break;
+        case Aggregate::CountDistinct:
+            partial.distinct->add(value);
+            break;
+    }
+}
+
+void ScanEvaluator::merge(Partial& into, Partial&& from) const {
+    into.count += from.count;
+    for(auto& group : from.groups)
+        into.groups[group.first] += group.second;
+    if(into.distinct && from.distinct)
+        into.distinct->merge(*from.distinct);
+    std::move(from.entries.begin(), from.entries.end(), std::back_inserter(into.entries));
+    if(m_query.limit() && into.entries.size() > 2 * m_query.limit())
+        trimEntries(into);
+}
+
+void ScanEvaluator::trimEntries(Partial& partial) const {
+    // keep the first entries by name, which are the ones returned
+    auto middle = partial.entries.begin() + m_query.limit();
+    std::partial_sort(partial.entries.begin(), middle, partial.entries.end());
+    partial.entries.erase(middle, partial.entries.end());
+}
+
+ScanResult ScanEvaluator::finish(Partial&& partial) const {
+    ScanResult result;
+    result.count = partial.count;
+    if(partial.distinct)
+        result.distinct = partial.distinct->estimate();
+    result.groups.assign(partial.groups.begin(), partial.groups.end());
+    std::sort(result.groups.begin(), result.groups.end());
+    std::sort(partial.entries.begin(), partial.entries.end());
+    if(m_query.limit() && partial.entries.size() > m_query.limit())
+        partial.entries.resize(m_query.limit());
+    result.entries = std::move(partial.entries);
+    return result;
+}
+
+}
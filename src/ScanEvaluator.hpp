@@ -0,0 +1,79 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_SCAN_EVALUATOR_H
+#define __YP_SCAN_EVALUATOR_H
+
+#include "yp/Scan.hpp"
+#include "HyperLogLog.hpp"
+#include <memory>
+#include <regex>
+#include <unordered_map>
+
+namespace yp {
+
+/**
+ * @brief Server-side evaluation of a ScanQuery. Backends split their
+ * entries into chunks, feed each chunk's entries to accumulate() with
+ * a Partial of its own (possibly in parallel, the evaluator itself
+ * being read-only), then merge the Partials and call finish().
+ */
+class ScanEvaluator {
+
+    public:
+
+    /**
+     * @brief Partial result over a subset of the entries.
+     */
+    struct Partial {
+        uint64_t                                         count = 0;
+        std::unordered_map<std::string, uint64_t>        groups;
+        std::unique_ptr<HyperLogLog>                     distinct;
+        std::vector<std::pair<std::string, std::string>> entries;
+    };
+
+    /**
+     * @brief Constructor. Compiles the regular expressions of the query.
+     *
+     * @throw yp::Exception if the query is invalid.
+     */
+    explicit ScanEvaluator(const ScanQuery& query);
+
+    /**
+     * @brief Whether an entry passes the filter.
+     */
+    bool matches(const std::string& name, const std::string& number) const;
+
+    /**
+     * @brief Creates an empty Partial.
+     */
+    Partial makePartial() const;
+
+    /**
+     * @brief Adds an entry to a Partial if it passes the filter.
+     */
+    void accumulate(Partial& partial, const std::string& name, const std::string& number) const;
+
+    /**
+     * @brief Merges a Partial into another.
+     */
+    void merge(Partial& into, Partial&& from) const;
+
+    /**
+     * @brief Converts the Partial covering all the entries into the result.
+     */
+    ScanResult finish(Partial&& partial) const;
+
+    private:
+
+    const ScanQuery&        m_query;
+    std::vector<std::regex> m_regexes; // by predicate, unused unless Op::Regex
+
+    void trimEntries(Partial& partial) const;
+};
+
+}
+
+#endif
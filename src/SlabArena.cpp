@@ -0,0 +1,122 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "SlabArena.hpp"
+#include "yp/Exception.hpp"
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace yp {
+
+// the last slab id would make kNone a valid reference
+static constexpr size_t kMaxSlabs = (size_t(1) << (32 - SlabArena::kSlabShift)) - 1;
+
+static size_t pageSize() {
+    static const size_t page_size = ::sysconf(_SC_PAGESIZE);
+    return page_size;
+}
+
+SlabArena::~SlabArena() {
+    for(auto& slab : m_slabs)
+        if(slab.data) ::munmap(slab.data, kSlabSize);
+}
+
+void SlabArena::openSlab() {
+    uint32_t id;
+    if(!m_free_ids.empty()) {
+        id = m_free_ids.back();
+    } else if(m_slabs.size() < kMaxSlabs) {
+        id = m_slabs.size();
+    } else {
+        throw Exception("Slab arena is full");
+    }
+    void* data = ::mmap(nullptr, kSlabSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(data == MAP_FAILED)
+        throw Exception("Could not map a new slab");
+    if(!m_free_ids.empty()) m_free_ids.pop_back();
+    else m_slabs.emplace_back();
+    m_slabs[id].data = static_cast<char*>(data);
+    m_num_slabs += 1;
+    // the previous slab will not be filled anymore, release it if nothing lives in it
+    uint32_t previous = m_current;
+    m_current = id;
+    if(previous != kNone && m_slabs[previous].live == 0)
+        releaseSlab(previous);
+}
+
+void SlabArena::reserve(size_t size, uint32_t avoid) {
+    if(size > kSlabSize)
+        throw Exception("Allocation of " + std::to_string(size)
+                      + " bytes exceeds the slab size");
+    if(m_current == kNone || m_current == avoid
+    || m_slabs[m_current].used + size > kSlabSize)
+        openSlab();
+}
+
+uint32_t SlabArena::allocate(size_t size) {
+    reserve(size);
+    auto& slab = m_slabs[m_current];
+    uint32_t ref = (m_current << kSlabShift) | slab.used;
+    slab.used += size;
+    slab.live += size;
+    m_used += size;
+    m_live += size;
+    return ref;
+}
+
+void SlabArena::free(uint32_t ref, size_t size) {
+    uint32_t id = slabOf(ref);
+    auto& slab = m_slabs[id];
+    slab.live -= size;
+    m_live -= size;
+    if(slab.live > 0) return;
+    if(id == m_current) {
+        // nothing lives in the current slab, rewind it and drop its pages
+        ::madvise(slab.data, slab.used, MADV_DONTNEED);
+        m_used -= slab.used;
+        slab.used = 0;
+    } else {
+        releaseSlab(id);
+    }
+}
+
+size_t SlabArena::residentBytes() const {
+    size_t page_size = pageSize();
+    size_t resident = 0;
+    for(auto& slab : m_slabs)
+        resident += (slab.used + page_size - 1) / page_size * page_size;
+    return resident;
+}
+
+uint32_t SlabArena::pickSlab(double threshold) const {
+    uint32_t best = kNone;
+    double best_ratio = threshold;
+    for(uint32_t id = 0; id < m_slabs.size(); id++) {
+        auto& slab = m_slabs[id];
+        if(slab.data == nullptr || slab.used == 0) continue;
+        if(id == m_current && slab.used < kSlabSize / 4) continue;
+        double ratio = static_cast<double>(slab.live) / slab.used;
+        if(ratio < best_ratio) {
+            best = id;
+            best_ratio = ratio;
+        }
+    }
+    return best;
+}
+
+void SlabArena::releaseSlab(uint32_t id) {
+    auto& slab = m_slabs[id];
+    ::munmap(slab.data, kSlabSize);
+    m_used -= slab.used;
+    m_live -= slab.live;
+    slab = Slab();
+    m_num_slabs -= 1;
+    if(id == m_current) m_current = kNone;
+    if(id + 1 == m_slabs.size()) m_slabs.pop_back();
+    else m_free_ids.push_back(id);
+}
+
+}
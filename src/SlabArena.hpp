@@ -0,0 +1,150 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_SLAB_ARENA_H
+#define __YP_SLAB_ARENA_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace yp {
+
+/**
+ * @brief Bump allocator over fixed-size slabs mapped directly from the
+ * operating system. Allocations are addressed by 32-bit references made
+ * of a 12-bit slab id and a 20-bit offset in the slab, so they remain
+ * valid when other slabs are added or removed. Slabs are mapped lazily
+ * by the OS, so only the pages that were written to are resident.
+ *
+ * Freed bytes are only accounted for; a slab is unmapped, returning its
+ * memory to the OS, once none of its bytes are live. Owners reclaim
+ * partially-used slabs by moving the live allocations out of the slab
+ * returned by pickSlab() and calling releaseSlab().
+ */
+class SlabArena {
+
+    public:
+
+    static constexpr size_t   kSlabShift = 20;
+    static constexpr size_t   kSlabSize  = size_t(1) << kSlabShift;
+    static constexpr uint32_t kNone      = UINT32_MAX;
+
+    SlabArena() = default;
+
+    SlabArena(const SlabArena&) = delete;
+
+    SlabArena& operator=(const SlabArena&) = delete;
+
+    ~SlabArena();
+
+    /**
+     * @brief Allocates size bytes (at most kSlabSize) in the current slab,
+     * starting a new slab if needed.
+     *
+     * @throw yp::Exception if all the slab ids are used.
+     */
+    uint32_t allocate(size_t size);
+
+    /**
+     * @brief Ensures that the next allocations totalling at most size
+     * bytes fit in the current slab, so they cannot fail. If the current
+     * slab is avoid, a new slab is started.
+     *
+     * @throw yp::Exception if a new slab is needed and cannot be mapped.
+     */
+    void reserve(size_t size, uint32_t avoid = kNone);
+
+    /**
+     * @brief Marks size bytes allocated at ref as free.
+     */
+    void free(uint32_t ref, size_t size);
+
+    char* data(uint32_t ref) {
+        return m_slabs[slabOf(ref)].data + (ref & (kSlabSize - 1));
+    }
+
+    const char* data(uint32_t ref) const {
+        return m_slabs[slabOf(ref)].data + (ref & (kSlabSize - 1));
+    }
+
+    static uint32_t slabOf(uint32_t ref) {
+        return ref >> kSlabShift;
+    }
+
+    /**
+     * @brief Returns the slab with the smallest fraction of live bytes
+     * among its allocated bytes, if that fraction is below threshold,
+     * or kNone. The slab currently used for allocations is only returned
+     * once at least a quarter of it has been allocated.
+     */
+    uint32_t pickSlab(double threshold) const;
+
+    /**
+     * @brief Bytes of live allocations in a slab.
+     */
+    size_t liveBytes(uint32_t slab) const {
+        return m_slabs[slab].live;
+    }
+
+    /**
+     * @brief Unmaps a slab. The caller must have moved its live allocations.
+     */
+    void releaseSlab(uint32_t slab);
+
+    /**
+     * @brief Number of slabs mapped.
+     */
+    size_t numSlabs() const {
+        return m_num_slabs;
+    }
+
+    /**
+     * @brief Bytes mapped from the OS.
+     */
+    size_t mappedBytes() const {
+        return m_num_slabs * kSlabSize;
+    }
+
+    /**
+     * @brief Bytes of the pages of the slabs that were written to.
+     */
+    size_t residentBytes() const;
+
+    /**
+     * @brief Bytes of live allocations.
+     */
+    size_t liveBytes() const {
+        return m_live;
+    }
+
+    /**
+     * @brief Bytes that were allocated and freed but not yet reclaimed.
+     */
+    size_t garbageBytes() const {
+        return m_used - m_live;
+    }
+
+    private:
+
+    struct Slab {
+        char*    data = nullptr;
+        uint32_t used = 0;
+        uint32_t live = 0;
+    };
+
+    void openSlab();
+
+    std::vector<Slab>     m_slabs;
+    std::vector<uint32_t> m_free_ids;
+    uint32_t              m_current   = kNone;
+    size_t                m_num_slabs = 0;
+    size_t                m_used      = 0;
+    size_t                m_live      = 0;
+};
+
+}
+
+#endif
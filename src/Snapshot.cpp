@@ -0,0 +1,344 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "yp/Exception.hpp"
+
+#include "Snapshot.hpp"
+#include "Parallel.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace yp {
+
+using namespace std::string_literals;
+
+namespace {
+
+constexpr char     kMagic[8]       = { 'Y', 'P', 'S', 'N', 'A', 'P', '\0', '\0' };
+constexpr uint32_t kVersion        = 1;
+constexpr size_t   kHeaderSize     = 40;
+constexpr size_t   kTableEntrySize = 32;
+constexpr uint32_t kManifestFormat = 1;
+
+struct Crc32cTables {
+    uint32_t t[8][256];
+    Crc32cTables() {
+        for(uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for(int k = 0; k < 8; k++)
+                c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : (c >> 1);
+            t[0][i] = c;
+        }
+        for(uint32_t i = 0; i < 256; i++)
+            for(int k = 1; k < 8; k++)
+                t[k][i] = (t[k-1][i] >> 8) ^ t[0][t[k-1][i] & 0xFF];
+    }
+};
+
+const Crc32cTables s_crc_tables;
+
+inline void putU32(char* p, uint32_t v) {
+    for(int i = 0; i < 4; i++) p[i] = static_cast<char>(v >> (8*i));
+}
+
+inline void putU64(char* p, uint64_t v) {
+    for(int i = 0; i < 8; i++) p[i] = static_cast<char>(v >> (8*i));
+}
+
+inline uint32_t getU32(const char* p) {
+    uint32_t v = 0;
+    for(int i = 0; i < 4; i++) v |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (8*i);
+    return v;
+}
+
+inline uint64_t getU64(const char* p) {
+    uint64_t v = 0;
+    for(int i = 0; i < 8; i++) v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8*i);
+    return v;
+}
+
+std::string systemError(const std::string& what, const std::string& path) {
+    return what + " "s + path + ": " + std::strerror(errno);
+}
+
+void writeAll(int fd, const char* data, size_t size, off_t offset, const std::string& path) {
+    while(size > 0) {
+        ssize_t n = ::pwrite(fd, data, size, offset);
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            throw Exception(systemError("Could not write to", path));
+        }
+        data   += n;
+        size   -= n;
+        offset += n;
+    }
+}
+
+void readAll(int fd, char* data, size_t size, off_t offset, const std::string& path) {
+    while(size > 0) {
+        ssize_t n = ::pread(fd, data, size, offset);
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            throw Exception(systemError("Could not read from", path));
+        }
+        if(n == 0) throw Exception("Unexpected end of snapshot file "s + path);
+        data   += n;
+        size   -= n;
+        offset += n;
+    }
+}
+
+struct FileDescriptor {
+    int fd = -1;
+    explicit FileDescriptor(int f) : fd(f) {}
+    ~FileDescriptor() { if(fd >= 0) ::close(fd); }
+};
+
+}
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc) {
+    auto p = static_cast<const unsigned char*>(data);
+    auto& t = s_crc_tables.t;
+    crc = ~crc;
+    while(size >= 8) {
+        uint32_t lo = crc ^ (static_cast<uint32_t>(p[0])       | static_cast<uint32_t>(p[1]) << 8
+                          | static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+            ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+        p    += 8;
+        size -= 8;
+    }
+    while(size--) crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+void SnapshotChunk::append(const std::string& name, const std::string& number) {
+    char len[4];
+    putU32(len, static_cast<uint32_t>(name.size()));
+    m_name_lengths.append(len, 4);
+    m_names.append(name);
+    putU32(len, static_cast<uint32_t>(number.size()));
+    m_number_lengths.append(len, 4);
+    m_numbers.append(number);
+    m_count += 1;
+}
+
+void SnapshotChunk::forEach(const std::function<void(std::string&&, std::string&&)>& f) const {
+    size_t name_offset = 0, number_offset = 0;
+    for(uint64_t i = 0; i < m_count; i++) {
+        auto name_size   = getU32(m_name_lengths.data() + 4*i);
+        auto number_size = getU32(m_number_lengths.data() + 4*i);
+        f(m_names.substr(name_offset, name_size),
+          m_numbers.substr(number_offset, number_size));
+        name_offset   += name_size;
+        number_offset += number_size;
+    }
+}
+
+void writeSnapshot(const std::string& path,
+                   const std::vector<SnapshotChunk>& chunks,
+                   uint32_t num_shards,
+                   const tl::pool& pool) {
+    const std::string tmp_path = path + ".tmp";
+    FileDescriptor file(::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    if(file.fd < 0) throw Exception(systemError("Could not create", tmp_path));
+
+    try {
+        std::vector<uint64_t> offsets(chunks.size());
+        std::vector<uint32_t> crcs(chunks.size());
+        uint64_t offset = kHeaderSize + kTableEntrySize * chunks.size();
+        uint64_t num_entries = 0;
+        for(size_t i = 0; i < chunks.size(); i++) {
+            offsets[i]   = offset;
+            offset      += chunks[i].byteSize();
+            num_entries += chunks[i].size();
+        }
+
+        parallelFor(pool, chunks.size(), [&](size_t i) {
+            auto& c = chunks[i];
+            uint64_t off = offsets[i];
+            uint32_t crc = 0;
+            for(auto* column : { &c.m_name_lengths, &c.m_names, &c.m_number_lengths, &c.m_numbers }) {
+                crc = crc32c(column->data(), column->size(), crc);
+                writeAll(file.fd, column->data(), column->size(), off, tmp_path);
+                off += column->size();
+            }
+            crcs[i] = crc;
+        });
+
+        std::string head(kHeaderSize + kTableEntrySize * chunks.size(), '\0');
+        char* table = &head[kHeaderSize];
+        for(size_t i = 0; i < chunks.size(); i++) {
+            char* e = table + kTableEntrySize * i;
+            putU64(e,      offsets[i]);
+            putU64(e + 8,  chunks[i].byteSize());
+            putU64(e + 16, chunks[i].size());
+            putU32(e + 24, chunks[i].shard());
+            putU32(e + 28, crcs[i]);
+        }
+        std::memcpy(&head[0], kMagic, 8);
+        putU32(&head[8],  kVersion);
+        putU32(&head[12], num_shards);
+        putU64(&head[16], chunks.size());
+        putU64(&head[24], num_entries);
+        putU32(&head[32], crc32c(table, kTableEntrySize * chunks.size()));
+        putU32(&head[36], crc32c(head.data(), 36));
+        writeAll(file.fd, head.data(), head.size(), 0, tmp_path);
+
+        if(::fsync(file.fd) != 0)
+            throw Exception(systemError("Could not sync", tmp_path));
+    } catch(...) {
+        ::unlink(tmp_path.c_str());
+        throw;
+    }
+
+    if(::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        auto error = systemError("Could not rename snapshot to", path);
+        ::unlink(tmp_path.c_str());
+        throw Exception(error);
+    }
+}
+
+SnapshotInfo readSnapshot(const std::string& path,
+                          const tl::pool& pool,
+                          const std::function<void(const SnapshotInfo&, SnapshotChunk&)>& consume) {
+    FileDescriptor file(::open(path.c_str(), O_RDONLY));
+    if(file.fd < 0) throw Exception(systemError("Could not open", path));
+    // sizes read from the file are checked against it before allocating
+    struct stat st;
+    if(::fstat(file.fd, &st) != 0) throw Exception(systemError("Could not stat", path));
+    const uint64_t file_size = st.st_size;
+    if(file_size < kHeaderSize)
+        throw Exception(path + " is not a yp snapshot");
+
+    char header[kHeaderSize];
+    readAll(file.fd, header, kHeaderSize, 0, path);
+    if(std::memcmp(header, kMagic, 8) != 0)
+        throw Exception(path + " is not a yp snapshot");
+    if(crc32c(header, 36) != getU32(header + 36))
+        throw Exception("Corrupted header in snapshot "s + path);
+
+    SnapshotInfo info;
+    info.version     = getU32(header + 8);
+    info.num_shards  = getU32(header + 12);
+    info.num_chunks  = getU64(header + 16);
+    info.num_entries = getU64(header + 24);
+    if(info.version > kVersion)
+        throw Exception("Unsupported version "s + std::to_string(info.version)
+                        + " for snapshot " + path);
+
+    if(info.num_chunks > (file_size - kHeaderSize) / kTableEntrySize)
+        throw Exception("Truncated chunk table in snapshot "s + path);
+    std::string table(kTableEntrySize * info.num_chunks, '\0');
+    readAll(file.fd, &table[0], table.size(), kHeaderSize, path);
+    if(crc32c(table.data(), table.size()) != getU32(header + 32))
+        throw Exception("Corrupted chunk table in snapshot "s + path);
+
+    parallelFor(pool, info.num_chunks, [&](size_t i) {
+        const char* e      = table.data() + kTableEntrySize * i;
+        uint64_t offset    = getU64(e);
+        uint64_t size      = getU64(e + 8);
+        uint64_t count     = getU64(e + 16);
+        if(offset > file_size || size > file_size - offset)
+            throw Exception("Truncated chunk "s + std::to_string(i) + " in snapshot " + path);
+
+        std::string buffer(size, '\0');
+        readAll(file.fd, &buffer[0], size, offset, path);
+        if(crc32c(buffer.data(), size) != getU32(e + 28))
+            throw Exception("Corrupted chunk "s + std::to_string(i) + " in snapshot " + path);
+
+        SnapshotChunk chunk(getU32(e + 24));
+        chunk.m_count = count;
+        size_t pos = 0;
+        for(auto column : { std::make_pair(&chunk.m_name_lengths, &chunk.m_names),
+                             std::make_pair(&chunk.m_number_lengths, &chunk.m_numbers) }) {
+            if(count > (size - pos) / 4)
+                throw Exception("Malformed chunk "s + std::to_string(i) + " in snapshot " + path);
+            column.first->assign(buffer, pos, 4*count);
+            pos += 4*count;
+            uint64_t bytes = 0;
+            for(uint64_t j = 0; j < count; j++)
+                bytes += getU32(column.first->data() + 4*j);
+            if(bytes > size - pos)
+                throw Exception("Malformed chunk "s + std::to_string(i) + " in snapshot " + path);
+            column.second->assign(buffer, pos, bytes);
+            pos += bytes;
+        }
+        consume(info, chunk);
+    });
+
+    return info;
+}
+
+bool CheckpointManifest::load(const std::string& directory) {
+    using json = nlohmann::json;
+    const std::string path = directory + "/MANIFEST";
+    std::ifstream file(path);
+    if(!file.good()) return false;
+    try {
+        std::stringstream content;
+        content << file.rdbuf();
+        auto manifest = json::parse(content.str());
+        if(manifest.value("format", 0u) > kManifestFormat)
+            throw Exception("Unsupported checkpoint manifest format in "s + path);
+        num_shards = manifest.at("num_shards").get<uint32_t>();
+        sequence   = manifest.at("sequence").get<uint64_t>();
+        base       = manifest.at("base").get<std::string>();
+        deltas     = manifest.at("deltas").get<std::vector<std::string>>();
+        chain      = manifest.value("chain", std::string());
+    } catch(const json::exception& ex) {
+        throw Exception("Invalid checkpoint manifest "s + path + ": " + ex.what());
+    }
+    return true;
+}
+
+void CheckpointManifest::save(const std::string& directory) const {
+    using json = nlohmann::json;
+    auto manifest = json::object();
+    manifest["format"]     = kManifestFormat;
+    manifest["num_shards"] = num_shards;
+    manifest["sequence"]   = sequence;
+    manifest["base"]       = base;
+    manifest["deltas"]     = deltas;
+    manifest["chain"]      = chain;
+    const std::string content  = manifest.dump();
+    const std::string path     = directory + "/MANIFEST";
+    const std::string tmp_path = path + ".tmp";
+    try {
+        FileDescriptor file(::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+        if(file.fd < 0) throw Exception(systemError("Could not create", tmp_path));
+        writeAll(file.fd, content.data(), content.size(), 0, tmp_path);
+        if(::fsync(file.fd) != 0)
+            throw Exception(systemError("Could not sync", tmp_path));
+    } catch(...) {
+        ::unlink(tmp_path.c_str());
+        throw;
+    }
+    if(::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        auto error = systemError("Could not rename manifest to", path);
+        ::unlink(tmp_path.c_str());
+        throw Exception(error);
+    }
+}
+
+bool CheckpointManifest::isCheckpoint(const std::string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+void CheckpointManifest::createDirectory(const std::string& directory) {
+    if(::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+        throw Exception(systemError("Could not create directory", directory));
+}
+
+}
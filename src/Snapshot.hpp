@@ -0,0 +1,212 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_SNAPSHOT_H
+#define __YP_SNAPSHOT_H
+
+#include <thallium.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace yp {
+
+namespace tl = thallium;
+
+/**
+ * Snapshot files have the following layout (integers are little-endian):
+ *
+ *   header (40 bytes):
+ *     magic "YPSNAP\0\0" | version u32 | num_shards u32 | num_chunks u64
+ *     | num_entries u64 | table_crc u32 | header_crc u32
+ *   chunk table (num_chunks x 32 bytes):
+ *     offset u64 | size u64 | num_entries u64 | shard u32 | crc u32
+ *   chunks:
+ *     name lengths (num_entries x u32) | names
+ *     | number lengths (num_entries x u32) | numbers
+ *
+ * Chunks are independent from one another, so they can be encoded,
+ * written, read and decoded in parallel. All checksums are CRC32C.
+ */
+
+/**
+ * @brief Computes the CRC32C (Castagnoli) checksum of a buffer.
+ *
+ * @param data Data to checksum.
+ * @param size Size of the data.
+ * @param crc Previous CRC, to checksum data in multiple calls.
+ *
+ * @return the updated CRC.
+ */
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+/**
+ * @brief Information found in the header of a snapshot.
+ */
+struct SnapshotInfo {
+    uint32_t version     = 0;
+    uint32_t num_shards  = 0;
+    uint64_t num_chunks  = 0;
+    uint64_t num_entries = 0;
+};
+
+/**
+ * @brief A SnapshotChunk holds a column-encoded set of entries
+ * that all belong to the same shard of a phonebook.
+ */
+class SnapshotChunk {
+
+    friend void writeSnapshot(const std::string&, const std::vector<SnapshotChunk>&,
+                              uint32_t, const tl::pool&);
+    friend SnapshotInfo readSnapshot(const std::string&, const tl::pool&,
+                                     const std::function<void(const SnapshotInfo&, SnapshotChunk&)>&);
+
+    public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param shard Shard the entries belong to.
+     */
+    SnapshotChunk(uint32_t shard = 0)
+    : m_shard(shard) {}
+
+    /**
+     * @brief Appends an entry to the chunk.
+     */
+    void append(const std::string& name, const std::string& number);
+
+    /**
+     * @brief Shard the entries of this chunk belong to.
+     */
+    uint32_t shard() const {
+        return m_shard;
+    }
+
+    /**
+     * @brief Number of entries in the chunk.
+     */
+    uint64_t size() const {
+        return m_count;
+    }
+
+    /**
+     * @brief Size of the chunk once encoded.
+     */
+    uint64_t byteSize() const {
+        return m_name_lengths.size() + m_names.size()
+             + m_number_lengths.size() + m_numbers.size();
+    }
+
+    /**
+     * @brief Calls f(name, number) on every entry of the chunk.
+     */
+    void forEach(const std::function<void(std::string&&, std::string&&)>& f) const;
+
+    private:
+
+    uint32_t    m_shard = 0;
+    uint64_t    m_count = 0;
+    std::string m_name_lengths;
+    std::string m_names;
+    std::string m_number_lengths;
+    std::string m_numbers;
+};
+
+/**
+ * @brief Writes a snapshot file. Chunks are checksummed and written
+ * concurrently by ULTs pushed into the provided pool. The file is
+ * written under a temporary name and renamed once complete, so an
+ * existing snapshot at the same path is only replaced on success.
+ *
+ * @param path Path of the file to write.
+ * @param chunks Chunks to write.
+ * @param num_shards Number of shards of the phonebook.
+ * @param pool Pool in which to spawn the ULTs.
+ *
+ * @throw yp::Exception on failure.
+ */
+void writeSnapshot(const std::string& path,
+                   const std::vector<SnapshotChunk>& chunks,
+                   uint32_t num_shards,
+                   const tl::pool& pool);
+
+/**
+ * @brief Reads a snapshot file. The header and chunk table are
+ * validated first, then chunks are read, verified and decoded
+ * concurrently by ULTs pushed into the provided pool, each of which
+ * calls consume on the chunk it decoded. consume must therefore be
+ * thread-safe.
+ *
+ * @param path Path of the file to read.
+ * @param pool Pool in which to spawn the ULTs.
+ * @param consume Function to call on each chunk.
+ *
+ * @return the information from the snapshot's header.
+ *
+ * @throw yp::Exception on failure.
+ */
+SnapshotInfo readSnapshot(const std::string& path,
+                          const tl::pool& pool,
+                          const std::function<void(const SnapshotInfo&, SnapshotChunk&)>& consume);
+
+/**
+ * @brief A checkpoint directory contains a MANIFEST file and a chain
+ * of snapshot files: a full snapshot (base) followed by deltas, each of
+ * which only contains the shards that were modified since the previous
+ * file of the chain. A shard that appears in a delta replaces the
+ * content of that shard entirely, so an empty shard is written as an
+ * empty chunk rather than omitted.
+ *
+ * Each chain carries a random identifier, chosen when its base is
+ * written, so that a writer can tell whether the chain in a directory
+ * is the one its own change tracking is relative to.
+ */
+struct CheckpointManifest {
+
+    uint32_t                 num_shards = 0;
+    uint64_t                 sequence   = 0;
+    std::string              chain;
+    std::string              base;
+    std::vector<std::string> deltas;
+
+    /**
+     * @brief Loads the manifest of a checkpoint directory.
+     *
+     * @param directory Checkpoint directory.
+     *
+     * @return false if the directory has no manifest.
+     *
+     * @throw yp::Exception if the manifest exists but cannot be parsed.
+     */
+    bool load(const std::string& directory);
+
+    /**
+     * @brief Atomically replaces the manifest of a checkpoint directory.
+     *
+     * @param directory Checkpoint directory.
+     *
+     * @throw yp::Exception on failure.
+     */
+    void save(const std::string& directory) const;
+
+    /**
+     * @brief Checks whether a path is a checkpoint directory
+     * (as opposed to a single snapshot file).
+     */
+    static bool isCheckpoint(const std::string& path);
+
+    /**
+     * @brief Creates a checkpoint directory if it does not exist.
+     *
+     * @throw yp::Exception on failure.
+     */
+    static void createDirectory(const std::string& directory);
+};
+
+}
+
+#endif
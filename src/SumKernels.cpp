@@ -0,0 +1,127 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "SumKernels.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define YP_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace yp {
+
+// Signed addition overflows iff both operands have the same sign
+// and the sign of the result differs, i.e. iff the sign bit of
+// (x ^ s) & (y ^ s) is set, where s is the wrapped-around sum.
+
+static uint64_t sumBlockScalar(const int32_t* x, const int32_t* y, int32_t* out, size_t n) {
+    uint64_t word = 0;
+    for(size_t i = 0; i < n; i++) {
+        uint32_t a = static_cast<uint32_t>(x[i]);
+        uint32_t b = static_cast<uint32_t>(y[i]);
+        uint32_t s = a + b;
+        out[i] = static_cast<int32_t>(s);
+        word |= static_cast<uint64_t>(((a ^ s) & (b ^ s)) >> 31) << i;
+    }
+    return word;
+}
+
+static void sumScalar(const int32_t* x, const int32_t* y, int32_t* out,
+                      uint64_t* overflow, size_t n) {
+    for(size_t i = 0; i < n; i += 64) {
+        size_t count = n - i < 64 ? n - i : 64;
+        overflow[i / 64] = sumBlockScalar(x + i, y + i, out + i, count);
+    }
+}
+
+#ifdef YP_X86_KERNELS
+
+__attribute__((target("avx2")))
+static void sumAvx2(const int32_t* x, const int32_t* y, int32_t* out,
+                    uint64_t* overflow, size_t n) {
+    size_t blocks = n / 64;
+    for(size_t b = 0; b < blocks; b++) {
+        uint64_t word = 0;
+        for(size_t k = 0; k < 8; k++) {
+            size_t i = b * 64 + k * 8;
+            __m256i vx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+            __m256i vy = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i));
+            __m256i s  = _mm256_add_epi32(vx, vy);
+            __m256i t  = _mm256_and_si256(_mm256_xor_si256(vx, s), _mm256_xor_si256(vy, s));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), s);
+            uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(t));
+            word |= static_cast<uint64_t>(mask) << (k * 8);
+        }
+        overflow[b] = word;
+    }
+    size_t done = blocks * 64;
+    if(done < n)
+        overflow[blocks] = sumBlockScalar(x + done, y + done, out + done, n - done);
+}
+
+__attribute__((target("avx512f")))
+static void sumAvx512(const int32_t* x, const int32_t* y, int32_t* out,
+                      uint64_t* overflow, size_t n) {
+    size_t blocks = n / 64;
+    const __m512i zero = _mm512_setzero_si512();
+    for(size_t b = 0; b < blocks; b++) {
+        uint64_t word = 0;
+        for(size_t k = 0; k < 4; k++) {
+            size_t i = b * 64 + k * 16;
+            __m512i vx = _mm512_loadu_si512(x + i);
+            __m512i vy = _mm512_loadu_si512(y + i);
+            __m512i s  = _mm512_add_epi32(vx, vy);
+            __m512i t  = _mm512_and_si512(_mm512_xor_si512(vx, s), _mm512_xor_si512(vy, s));
+            _mm512_storeu_si512(out + i, s);
+            __mmask16 mask = _mm512_cmplt_epi32_mask(t, zero);
+            word |= static_cast<uint64_t>(mask) << (k * 16);
+        }
+        overflow[b] = word;
+    }
+    size_t done = blocks * 64;
+    if(done < n)
+        overflow[blocks] = sumBlockScalar(x + done, y + done, out + done, n - done);
+}
+
+#endif
+
+namespace {
+
+SumInt32Kernel pickSumKernel() {
+#ifdef YP_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+        return { "avx512", sumAvx512 };
+    if(__builtin_cpu_supports("avx2"))
+        return { "avx2", sumAvx2 };
+#endif
+    return { "scalar", sumScalar };
+}
+
+const SumInt32Kernel& sumKernel() {
+    static const SumInt32Kernel kernel = pickSumKernel();
+    return kernel;
+}
+
+}
+
+void sumInt32(const int32_t* x, const int32_t* y, int32_t* out,
+              uint64_t* overflow, size_t n) {
+    sumKernel().fn(x, y, out, overflow, n);
+}
+
+std::vector<SumInt32Kernel> sumInt32Kernels() {
+    std::vector<SumInt32Kernel> kernels = { { "scalar", sumScalar } };
+#ifdef YP_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        kernels.push_back({ "avx2", sumAvx2 });
+    if(__builtin_cpu_supports("avx512f"))
+        kernels.push_back({ "avx512", sumAvx512 });
+#endif
+    return kernels;
+}
+
+}
@@ -0,0 +1,43 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_SUM_KERNELS_H
+#define __YP_SUM_KERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace yp {
+
+/**
+ * @brief Computes out[i] = x[i] + y[i] for i in [0, n), wrapping around
+ * on overflow, and sets bit i % 64 of overflow[i / 64] if the sum of
+ * x[i] and y[i] overflowed. overflow must hold (n + 63) / 64 words,
+ * all of which are overwritten.
+ *
+ * The implementation is picked on first use depending on the CPU:
+ * AVX-512, AVX2, or a portable scalar loop.
+ */
+void sumInt32(const int32_t* x, const int32_t* y, int32_t* out,
+              uint64_t* overflow, size_t n);
+
+/**
+ * @brief An implementation of sumInt32.
+ */
+struct SumInt32Kernel {
+    const char* name; // "avx512", "avx2" or "scalar"
+    void (*fn)(const int32_t*, const int32_t*, int32_t*, uint64_t*, size_t);
+};
+
+/**
+ * @brief Implementations of sumInt32 that the CPU supports, the scalar
+ * one first, so that they can be checked against each other.
+ */
+std::vector<SumInt32Kernel> sumInt32Kernels();
+
+}
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "TrigramIndex.hpp"
+#include "Intersect.hpp"
+#include <algorithm>
+#include <iterator>
+
+namespace yp {
+
+// estimate of libstdc++'s unordered_map layout, as in MapStore::stats
+static constexpr size_t kNodeOverhead = 2 * sizeof(void*);
+
+static inline unsigned char lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : static_cast<unsigned char>(c);
+}
+
+std::vector<uint32_t> TrigramIndex::trigrams(const std::string& str) {
+    std::vector<uint32_t> result;
+    if(str.size() < 3) return result;
+    result.reserve(str.size() - 2);
+    for(size_t i = 0; i + 3 <= str.size(); i++) {
+        result.push_back((uint32_t(lower(str[i])) << 16)
+                       | (uint32_t(lower(str[i+1])) << 8)
+                       |  uint32_t(lower(str[i+2])));
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+void TrigramIndex::PostingList::merge() {
+    std::vector<uint32_t> ids;
+    decode(ids);
+    m_encoded.clear();
+    uint32_t previous = 0;
+    for(auto id : ids) {
+        uint32_t delta = id - previous;
+        previous = id;
+        while(delta >= 0x80) {
+            m_encoded.push_back(static_cast<char>((delta & 0x7F) | 0x80));
+            delta >>= 7;
+        }
+        m_encoded.push_back(static_cast<char>(delta));
+    }
+    m_encoded.shrink_to_fit();
+    m_count = ids.size();
+    m_added.clear();
+    m_added.shrink_to_fit();
+    m_removed.clear();
+    m_removed.shrink_to_fit();
+}
+
+void TrigramIndex::PostingList::mergeIfNeeded() {
+    if(m_added.size() + m_removed.size() > std::max<size_t>(16, m_count / 8))
+        merge();
+}
+
+void TrigramIndex::PostingList::add(uint32_t id) {
+    auto it = std::lower_bound(m_removed.begin(), m_removed.end(), id);
+    if(it != m_removed.end() && *it == id) {
+        m_removed.erase(it);
+        return;
+    }
+    m_added.insert(std::lower_bound(m_added.begin(), m_added.end(), id), id);
+    mergeIfNeeded();
+}
+
+void TrigramIndex::PostingList::remove(uint32_t id) {
+    auto it = std::lower_bound(m_added.begin(), m_added.end(), id);
+    if(it != m_added.end() && *it == id) {
+        m_added.erase(it);
+        return;
+    }
+    m_removed.insert(std::lower_bound(m_removed.begin(), m_removed.end(), id), id);
+    mergeIfNeeded();
+}
+
+void TrigramIndex::PostingList::decode(std::vector<uint32_t>& ids) const {
+    std::vector<uint32_t> encoded;
+    encoded.reserve(m_count);
+    uint32_t id = 0;
+    for(size_t i = 0; i < m_encoded.size();) {
+        uint32_t delta = 0;
+        int shift = 0;
+        unsigned char byte;
+        do {
+            byte = static_cast<unsigned char>(m_encoded[i++]);
+            delta |= uint32_t(byte & 0x7F) << shift;
+            shift += 7;
+        } while(byte & 0x80);
+        id += delta;
+        encoded.push_back(id);
+    }
+    std::vector<uint32_t> remaining;
+    remaining.reserve(encoded.size());
+    std::set_difference(encoded.begin(), encoded.end(),
+                        m_removed.begin(), m_removed.end(),
+                        std::back_inserter(remaining));
+    ids.clear();
+    ids.reserve(remaining.size() + m_added.size());
+    std::merge(remaining.begin(), remaining.end(),
+               m_added.begin(), m_added.end(),
+               std::back_inserter(ids));
+}
+
+size_t TrigramIndex::PostingList::memoryUsage() const {
+    return sizeof(*this) + m_encoded.capacity()
+         + (m_added.capacity() + m_removed.capacity()) * sizeof(uint32_t);
+}
+
+void TrigramIndex::add(const std::string& name) {
+    uint32_t id;
+    if(!m_free_ids.empty()) {
+        id = m_free_ids.back();
+        m_free_ids.pop_back();
+    } else {
+        id = m_names.size();
+        m_names.push_back(nullptr);
+    }
+    auto it = m_ids.emplace(name, id).first;
+    m_names[id] = &it->first;
+    m_node_bytes += kNodeOverhead + sizeof(*it) + it->first.capacity() + 1;
+    for(auto trigram : trigrams(name)) {
+        auto posting = m_postings.emplace(trigram, PostingList());
+        auto& list = posting.first->second;
+        if(posting.second)
+            m_node_bytes += kNodeOverhead + sizeof(uint32_t);
+        else
+            m_node_bytes -= list.memoryUsage();
+        list.add(id);
+        m_node_bytes += list.memoryUsage();
+    }
+}
+
+void TrigramIndex::remove(const std::string& name) {
+    auto it = m_ids.find(name);
+    if(it == m_ids.end()) return;
+    uint32_t id = it->second;
+    for(auto trigram : trigrams(name)) {
+        auto posting = m_postings.find(trigram);
+        m_node_bytes -= posting->second.memoryUsage();
+        posting->second.remove(id);
+        if(posting->second.size() == 0) {
+            m_node_bytes -= kNodeOverhead + sizeof(uint32_t);
+            m_postings.erase(posting);
+        } else {
+            m_node_bytes += posting->second.memoryUsage();
+        }
+    }
+    m_names[id] = nullptr;
+    m_free_ids.push_back(id);
+    m_node_bytes -= kNodeOverhead + sizeof(*it) + it->first.capacity() + 1;
+    m_ids.erase(it);
+}
+
+void TrigramIndex::search(const std::string& pattern, unsigned max_edits,
+                          const std::function<void(const std::string&, unsigned)>& f) const {
+    auto verify = [&](uint32_t id) {
+        const std::string& name = *m_names[id];
+        int distance = substringDistance(pattern, name, max_edits);
+        if(distance >= 0) f(name, distance);
+    };
+    auto grams = trigrams(pattern);
+    long required = static_cast<long>(grams.size()) - 3 * static_cast<long>(max_edits);
+    if(required <= 0) {
+        for(uint32_t id = 0; id < m_names.size(); id++)
+            if(m_names[id]) verify(id);
+        return;
+    }
+    std::vector<std::vector<uint32_t>> lists;
+    lists.reserve(grams.size());
+    for(auto trigram : grams) {
+        auto it = m_postings.find(trigram);
+        if(it == m_postings.end()) {
+            if(max_edits == 0) return;
+            continue;
+        }
+        lists.emplace_back();
+        it->second.decode(lists.back());
+    }
+    if(static_cast<long>(lists.size()) < required) return;
+
+    std::vector<uint32_t> candidates;
+    if(max_edits == 0) {
+        // intersect from the shortest list, so intermediate results stay small
+        std::sort(lists.begin(), lists.end(),
+            [](const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+                return a.size() < b.size();
+            });
+        candidates = std::move(lists[0]);
+        std::vector<uint32_t> tmp;
+        for(size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+            tmp.resize(candidates.size());
+            tmp.resize(intersectSorted(candidates.data(), candidates.size(),
+                                       lists[i].data(), lists[i].size(),
+                                       tmp.data()));
+            candidates.swap(tmp);
+        }
+    } else {
+        // keep the ids that appear in at least "required" lists
+        std::vector<uint32_t> all;
+        for(auto& list : lists)
+            all.insert(all.end(), list.begin(), list.end());
+        std::sort(all.begin(), all.end());
+        for(size_t i = 0; i < all.size();) {
+            size_t j = i;
+            while(j < all.size() && all[j] == all[i]) j++;
+            if(static_cast<long>(j - i) >= required)
+                candidates.push_back(all[i]);
+            i = j;
+        }
+    }
+    for(auto id : candidates) verify(id);
+}
+
+size_t TrigramIndex::memoryUsage() const {
+    return m_postings.bucket_count() * sizeof(void*)
+         + m_ids.bucket_count() * sizeof(void*)
+         + m_names.capacity() * sizeof(const std::string*)
+         + m_free_ids.capacity() * sizeof(uint32_t)
+         + m_node_bytes;
+}
+
+int TrigramIndex::substringDistance(const std::string& pattern,
+                                    const std::string& text,
+                                    unsigned max_edits) {
+    // Sellers' algorithm: edit distance in which the match may start
+    // and end anywhere in the text, computed one text column at a time
+    size_t m = pattern.size();
+    std::vector<unsigned> column(m + 1);
+    for(size_t i = 0; i <= m; i++) column[i] = i;
+    unsigned best = m;
+    for(char c : text) {
+        unsigned diagonal = column[0];
+        column[0] = 0;
+        for(size_t i = 1; i <= m; i++) {
+            unsigned cost = lower(pattern[i-1]) == lower(c) ? 0 : 1;
+            unsigned value = std::min({ diagonal + cost, column[i] + 1, column[i-1] + 1 });
+            diagonal = column[i];
+            column[i] = value;
+        }
+        best = std::min(best, column[m]);
+        if(best == 0) break;
+    }
+    return best <= max_edits ? static_cast<int>(best) : -1;
+}
+
+}
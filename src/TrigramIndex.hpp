@@ -0,0 +1,117 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_TRIGRAM_INDEX_H
+#define __YP_TRIGRAM_INDEX_H
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace yp {
+
+/**
+ * @brief Inverted index from the trigrams (3-byte substrings, ASCII
+ * case-insensitive) of names to the names that contain them, used to
+ * find names containing a pattern, possibly with a few edits, without
+ * looking at every name. Like EntryStore, it is not thread-safe.
+ *
+ * Each name gets a 32-bit id. A posting list holds the sorted ids of
+ * the names containing a trigram, delta and varint encoded, plus small
+ * sorted vectors of ids added and removed since it was last encoded,
+ * which are merged into the encoded list once they grow past 1/8 of it.
+ */
+class TrigramIndex {
+
+    public:
+
+    /**
+     * @brief Adds a name to the index. The name must not be in the index.
+     */
+    void add(const std::string& name);
+
+    /**
+     * @brief Removes a name from the index, if present.
+     */
+    void remove(const std::string& name);
+
+    /**
+     * @brief Calls f(name, distance) for every name that contains
+     * a substring within max_edits edits (insertions, deletions,
+     * substitutions) of pattern, distance being the smallest number
+     * of edits. Comparisons ignore ASCII case.
+     *
+     * Names sharing too few trigrams with the pattern are discarded
+     * using the index: each edit changes at most 3 trigrams, so a match
+     * contains at least (distinct trigrams of pattern - 3 * max_edits)
+     * of them. With max_edits = 0, candidates are the intersection of
+     * the posting lists. Patterns too short for that bound to be
+     * positive are checked against every name.
+     */
+    void search(const std::string& pattern, unsigned max_edits,
+                const std::function<void(const std::string&, unsigned)>& f) const;
+
+    /**
+     * @brief Number of names in the index.
+     */
+    size_t size() const {
+        return m_ids.size();
+    }
+
+    /**
+     * @brief Approximate number of bytes used by the index, in constant time.
+     */
+    size_t memoryUsage() const;
+
+    /**
+     * @brief Smallest number of edits between pattern and any substring
+     * of text (ASCII case-insensitive), or -1 if it exceeds max_edits.
+     */
+    static int substringDistance(const std::string& pattern,
+                                 const std::string& text,
+                                 unsigned max_edits);
+
+    private:
+
+    class PostingList {
+
+        std::string           m_encoded;
+        uint32_t              m_count = 0;
+        std::vector<uint32_t> m_added;
+        std::vector<uint32_t> m_removed;
+
+        void merge();
+
+        void mergeIfNeeded();
+
+        public:
+
+        void add(uint32_t id);
+
+        void remove(uint32_t id);
+
+        size_t size() const {
+            return m_count + m_added.size() - m_removed.size();
+        }
+
+        void decode(std::vector<uint32_t>& ids) const;
+
+        size_t memoryUsage() const;
+    };
+
+    std::unordered_map<uint32_t, PostingList>  m_postings;
+    std::unordered_map<std::string, uint32_t>  m_ids;
+    std::vector<const std::string*>            m_names; // by id, null if unused
+    std::vector<uint32_t>                      m_free_ids;
+    size_t                                     m_node_bytes = 0; // in the nodes of both maps, so that memoryUsage() is O(1)
+
+    static std::vector<uint32_t> trigrams(const std::string& str);
+};
+
+}
+
+#endif
@@ -4,14 +4,136 @@
  * See COPYRIGHT in top-level directory.
  */
 #include "DummyBackend.hpp"
+#include <yp/Exception.hpp>
+#include <yp/UUID.hpp>
+#include "../Hash.hpp"
+#include "../Parallel.hpp"
+#include "../ScanEvaluator.hpp"
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+#include <ctime>
+#include <unistd.h>
 
 YP_REGISTER_BACKEND(dummy, DummyPhonebook);
 
 DummyPhonebook::DummyPhonebook(thallium::engine engine, const json& config)
 : m_engine(std::move(engine)),
-  m_config(config) {
+  m_config(config),
+  m_storage(config.value("storage", "map")),
+  m_trigram_index(config.value("trigram_index", false)),
+  m_reverse_index(config.value("reverse_index", false)),
+  m_shards(config.value("num_shards", 64)),
+  m_chunk_size(config.value("snapshot_chunk_size", 65536)),
+  m_dirty(m_shards.size()),
+  m_max_deltas(config.value("checkpoint_max_deltas", 8)),
+  m_compaction_threshold(config.value("compaction_threshold", 0.5)),
+  m_compaction_interval(config.value("compaction_interval_ms", 1000.0)) {
+    if(m_shards.empty())
+        throw yp::Exception("num_shards must be at least 1");
+    if(m_chunk_size == 0)
+        throw yp::Exception("snapshot_chunk_size must be at least 1");
+    initShards(m_shards);
+    if(config.value("name_filter", false))
+        m_filter.reset(new yp::NameFilter());
+    if(m_storage == "compact" && m_compaction_interval > 0) {
+        m_compaction_running = true;
+        m_engine.get_handler_pool().make_thread(
+            [this]() { compactionLoop(); }, thallium::anonymous());
+    }
+}
+
+DummyPhonebook::~DummyPhonebook() {
+    if(!m_compaction_running) return;
+    {
+        std::lock_guard<thallium::mutex> lock(m_compaction_mutex);
+        m_compaction_stop = true;
+        m_compaction_cv.notify_one();
+    }
+    m_compaction_done.wait();
+}
+
+void DummyPhonebook::compactionLoop() {
+    std::unique_lock<thallium::mutex> lock(m_compaction_mutex);
+    while(!m_compaction_stop) {
+        lock.unlock();
+        compact(m_compaction_threshold);
+        lock.lock();
+        if(m_compaction_stop) break;
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        auto ns = static_cast<long long>(m_compaction_interval * 1e6) + deadline.tv_nsec;
+        deadline.tv_sec  += ns / 1000000000;
+        deadline.tv_nsec  = ns % 1000000000;
+        m_compaction_cv.wait_until(lock, &deadline);
+    }
+    m_compaction_done.set_value();
+}
+
+size_t DummyPhonebook::compact(double threshold) {
+    size_t total = 0;
+    bool progress = true;
+    while(progress && !m_compaction_stop) {
+        progress = false;
+        for(auto& shard : m_shards) {
+            size_t reclaimed;
+            {
+                std::lock_guard<thallium::mutex> lock(shard.mutex);
+                reclaimed = shard.entries->compact(threshold);
+            }
+            if(reclaimed) {
+                progress = true;
+                total += reclaimed;
+                m_compaction_steps += 1;
+            }
+            // let RPCs run between steps
+            thallium::thread::yield();
+        }
+    }
+    m_reclaimed_bytes += total;
+    return total;
+}
+
+void DummyPhonebook::initShards(std::vector<Shard>& shards) const {
+    for(auto& shard : shards) {
+        shard.entries = yp::EntryStore::create(m_storage);
+        if(m_trigram_index)
+            shard.trigrams.reset(new yp::TrigramIndex());
+        if(m_reverse_index)
+            shard.numbers.reset(new yp::ReverseIndex());
+    }
+}
 
+void DummyPhonebook::Shard::insert(std::string_view name, std::string_view number) {
+    std::string previous;
+    bool replaced = numbers && entries->lookup(name, &previous);
+    bool added = entries->insert(name, number);
+    if(added && trigrams) trigrams->add(std::string(name));
+    if(numbers && !(replaced && previous == number)) {
+        if(replaced) numbers->remove(previous, name);
+        numbers->add(number, name);
+    }
+}
+
+bool DummyPhonebook::Shard::erase(std::string_view name) {
+    std::string number;
+    if(numbers && !entries->lookup(name, &number)) return false;
+    if(!entries->erase(name)) return false;
+    if(trigrams) trigrams->remove(std::string(name));
+    if(numbers) numbers->remove(number, name);
+    return true;
+}
+
+void DummyPhonebook::Shard::swap(Shard& other) {
+    entries.swap(other.entries);
+    trigrams.swap(other.trigrams);
+    numbers.swap(other.numbers);
+}
+
+size_t DummyPhonebook::shardIndex(std::string_view name) const {
+    return yp::hashBytes(name.data(), name.size()) % m_shards.size();
 }
 
 void DummyPhonebook::sayHello() {
@@ -28,6 +150,435 @@ yp::RequestResult<int32_t> DummyPhonebook::computeSum(int32_t x, int32_t y) {
     return result;
 }
 
+yp::RequestResult<bool> DummyPhonebook::insert(const std::string& name,
+                                               const std::string& number) {
+    return insert(std::string_view(name), std::string_view(number));
+}
+
+yp::RequestResult<bool> DummyPhonebook::insert(std::string_view name,
+                                               std::string_view number) {
+    yp::RequestResult<bool> result;
+    auto index = shardIndex(name);
+    auto& shard = m_shards[index];
+    {
+        std::lock_guard<thallium::mutex> lock(shard.mutex);
+        try {
+            shard.insert(name, number);
+        } catch(const std::exception& ex) {
+            result.success() = false;
+            result.error() = ex.what();
+            return result;
+        }
+        // under the shard's lock, so that a rebuild either sees the
+        // name in the shard or gets it added to the new filter
+        if(m_filter) m_filter->add(name);
+    }
+    m_dirty.set(index);
+    if(m_filter && m_filter->overloaded())
+        rebuildFilter(false);
+    return result;
+}
+
+void DummyPhonebook::rebuildFilter(bool wait) {
+    size_t count = 0;
+    for(auto& shard : m_shards) {
+        std::lock_guard<thallium::mutex> lock(shard.mutex);
+        count += shard.entries->size();
+    }
+    // room for as many new names as there are names now
+    while(!m_filter->beginRebuild(2 * count)) {
+        if(!wait) return; // the rebuild in progress will do
+        thallium::thread::yield();
+    }
+    for(auto& shard : m_shards) {
+        std::lock_guard<thallium::mutex> lock(shard.mutex);
+        shard.entries->forEach([this](const std::string& name, const std::string&) {
+            m_filter->addToNext(name);
+        });
+    }
+    m_filter->endRebuild();
+}
+
+yp::RequestResult<yp::FilterUpdate> DummyPhonebook::getFilter(uint64_t epoch, uint64_t version) {
+    if(!m_filter) return yp::Backend::getFilter(epoch, version);
+    yp::RequestResult<yp::FilterUpdate> result;
+    result.value() = m_filter->changesSince(epoch, version);
+    return result;
+}
+
+yp::RequestResult<std::string> DummyPhonebook::lookup(const std::string& name) {
+    return lookup(std::string_view(name));
+}
+
+yp::RequestResult<std::string> DummyPhonebook::lookup(std::string_view name) {
+    yp::RequestResult<std::string> result;
+    auto& shard = m_shards[shardIndex(name)];
+    std::lock_guard<thallium::mutex> lock(shard.mutex);
+    if(!shard.entries->lookup(name, &result.value())) {
+        result.fail(yp::Status::NotFound);
+    }
+    return result;
+}
+
+yp::RequestResult<yp::LookupBuffer> DummyPhonebook::lookupMulti(const std::vector<std::string_view>& names) {
+    yp::RequestResult<yp::LookupBuffer> result;
+    std::string number;
+    for(auto name : names) {
+        auto& shard = m_shards[shardIndex(name)];
+        std::lock_guard<thallium::mutex> lock(shard.mutex);
+        if(shard.entries->lookup(name, &number))
+            result.value().append(yp::Status::Success, number);
+        else
+            result.value().append(yp::Status::NotFound);
+    }
+    return result;
+}
+
+yp::RequestResult<bool> DummyPhonebook::erase(const std::string& name) {
+    return erase(std::string_view(name));
+}
+
+yp::RequestResult<bool> DummyPhonebook::erase(std::string_view name) {
+    yp::RequestResult<bool> result;
+    auto index = shardIndex(name);
+    auto& shard = m_shards[index];
+    std::lock_guard<thallium::mutex> lock(shard.mutex);
+    if(!shard.erase(name)) {
+        result.fail(yp::Status::NotFound);
+    } else {
+        m_dirty.set(index);
+    }
+    return result;
+}
+
+std::vector<yp::SnapshotChunk> DummyPhonebook::makeChunks(const std::vector<size_t>& shards,
+                                                          bool keep_empty,
+                                                          const thallium::pool& pool) {
+    std::vector<std::vector<yp::SnapshotChunk>> shard_chunks(shards.size());
+    yp::parallelFor(pool, shards.size(), [&](size_t i) {
+        auto& chunks = shard_chunks[i];
+        auto& shard  = m_shards[shards[i]];
+        std::lock_guard<thallium::mutex> lock(shard.mutex);
+        if(keep_empty && shard.entries->size() == 0)
+            chunks.emplace_back(shards[i]);
+        shard.entries->forEach([&](const std::string& name, const std::string& number) {
+            if(chunks.empty() || chunks.back().size() == m_chunk_size)
+                chunks.emplace_back(shards[i]);
+            chunks.back().append(name, number);
+        });
+    });
+    std::vector<yp::SnapshotChunk> chunks;
+    for(auto& c : shard_chunks)
+        std::move(c.begin(), c.end(), std::back_inserter(chunks));
+    return chunks;
+}
+
+std::vector<bool> DummyPhonebook::readShards(const std::string& path,
+                                             const thallium::pool& pool,
+                                             std::vector<Shard>& shards,
+                                             bool same_sharding_only) {
+    // vector<char> rather than vector<bool> since ULTs set distinct elements concurrently
+    std::vector<char> touched(shards.size(), 0);
+    auto info = yp::readSnapshot(path, pool,
+        [&](const yp::SnapshotInfo& header, yp::SnapshotChunk& chunk) {
+            if(header.num_shards == shards.size()) {
+                // same sharding, the whole chunk goes to the same shard
+                auto& shard = shards[chunk.shard() % shards.size()];
+                std::lock_guard<thallium::mutex> lock(shard.mutex);
+                touched[chunk.shard() % shards.size()] = 1;
+                shard.entries->reserve(shard.entries->size() + chunk.size());
+                chunk.forEach([&shard](std::string&& name, std::string&& number) {
+                    shard.insert(name, number);
+                });
+            } else if(same_sharding_only) {
+                throw yp::Exception("Snapshot " + path + " has "
+                    + std::to_string(header.num_shards) + " shards, expected "
+                    + std::to_string(shards.size()));
+            } else {
+                chunk.forEach([&](std::string&& name, std::string&& number) {
+                    auto& shard = shards[yp::hashBytes(name) % shards.size()];
+                    std::lock_guard<thallium::mutex> lock(shard.mutex);
+                    shard.insert(name, number);
+                });
+            }
+        });
+    if(info.num_shards != shards.size())
+        return std::vector<bool>(shards.size(), true);
+    return std::vector<bool>(touched.begin(), touched.end());
+}
+
+yp::RequestResult<bool> DummyPhonebook::snapshot(const std::string& path,
+                                                 const thallium::pool& pool) {
+    yp::RequestResult<bool> result;
+    std::vector<size_t> shards(m_shards.size());
+    std::iota(shards.begin(), shards.end(), 0);
+    try {
+        auto chunks = makeChunks(shards, false, pool);
+        yp::writeSnapshot(path, chunks, m_shards.size(), pool);
+    } catch(const std::exception& ex) {
+        result.success() = false;
+        result.error() = ex.what();
+    }
+    return result;
+}
+
+yp::RequestResult<bool> DummyPhonebook::restore(const std::string& path,
+                                                const thallium::pool& pool) {
+    yp::RequestResult<bool> result;
+    std::vector<Shard> restored(m_shards.size());
+    try {
+        initShards(restored);
+        if(yp::CheckpointManifest::isCheckpoint(path)) {
+            yp::CheckpointManifest manifest;
+            if(!manifest.load(path))
+                throw yp::Exception("No checkpoint manifest in " + path);
+            // deltas replace whole shards, so the chain is replayed with the
+            // sharding it was written with and rehashed afterwards if needed
+            std::vector<Shard> chain(manifest.num_shards);
+            initShards(chain);
+            readShards(path + "/" + manifest.base, pool, chain, false);
+            for(auto& delta : manifest.deltas) {
+                std::vector<Shard> changes(chain.size());
+                initShards(changes);
+                auto touched = readShards(path + "/" + delta, pool, changes, true);
+                for(size_t i = 0; i < chain.size(); i++)
+                    if(touched[i]) chain[i].swap(changes[i]);
+            }
+            if(chain.size() == restored.size()) {
+                for(size_t i = 0; i < chain.size(); i++)
+                    restored[i].swap(chain[i]);
+            } else {
+                for(auto& shard : chain)
+                    shard.entries->forEach([&](const std::string& name, const std::string& number) {
+                        restored[shardIndex(name)].insert(name, number);
+                    });
+            }
+        } else {
+            readShards(path, pool, restored, false);
+        }
+    } catch(const std::exception& ex) {
+        result.success() = false;
+        result.error() = ex.what();
+        return result;
+    }
+    for(size_t i = 0; i < m_shards.size(); i++) {
+        std::lock_guard<thallium::mutex> lock(m_shards[i].mutex);
+        m_shards[i].swap(restored[i]);
+    }
+    m_dirty.setAll();
+    if(m_filter) rebuildFilter(true);
+    return result;
+}
+
+yp::RequestResult<bool> DummyPhonebook::checkpoint(const std::string& directory,
+                                                   const thallium::pool& pool) {
+    yp::RequestResult<bool> result;
+    std::lock_guard<thallium::mutex> guard(m_checkpoint_mutex);
+    std::vector<size_t> dirty;
+    try {
+        yp::CheckpointManifest::createDirectory(directory);
+        yp::CheckpointManifest manifest;
+        bool chained = manifest.load(directory);
+        // the dirty bitmap only tells what changed since the last checkpoint
+        // into m_checkpoint_chain, any other chain needs a new full snapshot
+        bool full = !chained
+                 || m_checkpoint_chain.empty()
+                 || manifest.chain != m_checkpoint_chain
+                 || manifest.num_shards != m_shards.size()
+                 || manifest.deltas.size() >= m_max_deltas;
+        dirty = m_dirty.collect();
+        if(!full && dirty.empty()) return result;
+
+        std::vector<size_t> shards;
+        if(full) {
+            shards.resize(m_shards.size());
+            std::iota(shards.begin(), shards.end(), 0);
+        } else {
+            shards = dirty;
+        }
+        auto chunks = makeChunks(shards, !full, pool);
+
+        manifest.sequence += 1;
+        std::string filename = std::to_string(manifest.sequence) + (full ? ".full" : ".delta");
+        yp::writeSnapshot(directory + "/" + filename, chunks, m_shards.size(), pool);
+
+        std::vector<std::string> obsolete;
+        if(full) {
+            if(chained) {
+                obsolete = std::move(manifest.deltas);
+                obsolete.push_back(manifest.base);
+            }
+            manifest.base = filename;
+            manifest.deltas.clear();
+            manifest.chain = yp::UUID::generate().to_string();
+        } else {
+            manifest.deltas.push_back(filename);
+        }
+        manifest.num_shards = m_shards.size();
+        manifest.save(directory);
+        m_checkpoint_chain = manifest.chain;
+        for(auto& file : obsolete)
+            ::unlink((directory + "/" + file).c_str());
+    } catch(const std::exception& ex) {
+        // the shards collected were not persisted, mark them dirty again
+        for(auto i : dirty) m_dirty.set(i);
+        result.success() = false;
+        result.error() = ex.what();
+    }
+    return result;
+}
+
+yp::RequestResult<std::vector<std::pair<std::string, std::string>>>
+DummyPhonebook::search(const std::string& pattern, uint32_t max_edit_distance, size_t limit) {
+    yp::RequestResult<std::vector<std::pair<std::string, std::string>>> result;
+    struct Match {
+        unsigned    distance;
+        std::string name;
+        std::string number;
+        bool operator<(const Match& other) const {
+            return distance != other.distance ? distance < other.distance : name < other.name;
+        }
+    };
+    std::vector<Match> matches;
+    for(auto& shard : m_shards) {
+        std::lock_guard<thallium::mutex> lock(shard.mutex);
+        auto onMatch = [&](const std::string& name, unsigned distance) {
+            Match match{distance, name, std::string()};
+            shard.entries->lookup(name, &match.number);
+            matches.push_back(std::move(match));
+        };
+        if(shard.trigrams) {
+            shard.trigrams->search(pattern, max_edit_distance, onMatch);
+        } else {
+            shard.entries->forEach([&](const std::string& name, const std::string& number) {
+                int distance = yp::TrigramIndex::substringDistance(pattern, name, max_edit_distance);
+                if(distance >= 0) matches.push_back(Match{static_cast<unsigned>(distance), name, number});
+            });
+        }
+        // keep only the best matches found so far
+        if(limit && matches.size() > 2 * limit) {
+            std::partial_sort(matches.begin(), matches.begin() + limit, matches.end());
+            matches.resize(limit);
+        }
+    }
+    std::sort(matches.begin(), matches.end());
+    if(limit && matches.size() > limit) matches.resize(limit);
+    result.value().reserve(matches.size());
+    for(auto& match : matches)
+        result.value().emplace_back(std::move(match.name), std::move(match.number));
+    return result;
+}
+
+yp::RequestResult<std::vector<std::vector<std::string>>>
+DummyPhonebook::reverseLookupMulti(const std::vector<std::string>& numbers) {
+    yp::RequestResult<std::vector<std::vector<std::string>>> result;
+    auto& names = result.value();
+    names.resize(numbers.size());
+    // positions of each distinct number in the request, for the scans
+    std::unordered_map<std::string, std::vector<size_t>> positions;
+    if(!m_reverse_index) {
+        for(size_t i = 0; i < numbers.size(); i++)
+            positions[numbers[i]].push_back(i);
+    }
+    for(auto& shard : m_shards) {
+        std::lock_guard<thallium::mutex> lock(shard.mutex);
+        if(shard.numbers) {
+            std::string number;
+            for(size_t i = 0; i < numbers.size(); i++) {
+                shard.numbers->find(numbers[i], [&](const std::string& name) {
+                    // the index only knows the hash of the numbers
+                    if(shard.entries->lookup(name, &number) && number == numbers[i])
+                        names[i].push_back(name);
+                });
+            }
+        } else {
+            shard.entries->forEach([&](const std::string& name, const std::string& number) {
+                auto it = positions.find(number);
+                if(it == positions.end()) return;
+                for(auto i : it->second) names[i].push_back(name);
+            });
+        }
+    }
+    for(auto& list : names)
+        std::sort(list.begin(), list.end());
+    return result;
+}
+
+yp::RequestResult<yp::ScanResult> DummyPhonebook::scan(const yp::ScanQuery& query,
+                                                       const thallium::pool& pool) {
+    yp::RequestResult<yp::ScanResult> result;
+    try {
+        yp::ScanEvaluator evaluator(query);
+        std::vector<yp::ScanEvaluator::Partial> partials(m_shards.size());
+        yp::parallelFor(pool, m_shards.size(), [&](size_t i) {
+            auto& partial = partials[i];
+            partial = evaluator.makePartial();
+            auto& shard = m_shards[i];
+            std::lock_guard<thallium::mutex> lock(shard.mutex);
+            shard.entries->forEach([&](const std::string& name, const std::string& number) {
+                evaluator.accumulate(partial, name, number);
+            });
+        });
+        for(size_t i = 1; i < partials.size(); i++)
+            evaluator.merge(partials[0], std::move(partials[i]));
+        result.value() = evaluator.finish(std::move(partials[0]));
+    } catch(const std::exception& ex) {
+        result.success() = false;
+        result.error() = ex.what();
+    }
+    return result;
+}
+
+size_t DummyPhonebook::residentBytes() {
+    size_t total = 0;
+    for(auto& shard : m_shards) {
+        std::lock_guard<thallium::mutex> lock(shard.mutex);
+        total += shard.entries->stats().memory_bytes;
+        if(shard.trigrams) total += shard.trigrams->memoryUsage();
+        if(shard.numbers)  total += shard.numbers->memoryUsage();
+    }
+    if(m_filter) total += m_filter->memoryUsage();
+    return total;
+}
+
+std::string DummyPhonebook::getStats() {
+    yp::EntryStore::Stats stats;
+    size_t trigram_bytes = 0;
+    size_t reverse_bytes = 0;
+    for(auto& shard : m_shards) {
+        std::lock_guard<thallium::mutex> lock(shard.mutex);
+        stats += shard.entries->stats();
+        if(shard.trigrams) trigram_bytes += shard.trigrams->memoryUsage();
+        if(shard.numbers)  reverse_bytes += shard.numbers->memoryUsage();
+    }
+    json result;
+    result["storage"]         = m_storage;
+    result["num_shards"]      = m_shards.size();
+    result["num_entries"]     = stats.num_entries;
+    result["memory_bytes"]    = stats.memory_bytes;
+    result["bytes_per_entry"] = stats.num_entries == 0 ? 0.0
+        : static_cast<double>(stats.memory_bytes) / stats.num_entries;
+    if(m_trigram_index)
+        result["trigram_index_bytes"] = trigram_bytes;
+    if(m_reverse_index)
+        result["reverse_index_bytes"] = reverse_bytes;
+    if(m_filter)
+        result["name_filter_bytes"] = m_filter->memoryUsage();
+    if(m_storage == "compact") {
+        result["arena_bytes"]      = stats.arena_bytes;
+        result["live_bytes"]       = stats.live_bytes;
+        result["garbage_bytes"]    = stats.garbage_bytes;
+        result["slabs"]            = stats.slabs;
+        result["fragmentation"]    = stats.arena_bytes == 0 ? 0.0
+            : static_cast<double>(stats.garbage_bytes) / stats.arena_bytes;
+        result["compaction_steps"] = m_compaction_steps.load();
+        result["reclaimed_bytes"]  = m_reclaimed_bytes.load();
+        result["interned"]         = stats.interned;
+        result["packed_numbers"]   = stats.packed;
+    }
+    return result.dump();
+}
+
 yp::RequestResult<bool> DummyPhonebook::destroy() {
     yp::RequestResult<bool> result;
     result.value() = true;
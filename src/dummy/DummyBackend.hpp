@@ -7,19 +7,103 @@
 #define __DUMMY_BACKEND_HPP
 
 #include <yp/Backend.hpp>
+#include "../DirtyBitmap.hpp"
+#include "../EntryStore.hpp"
+#include "../NameFilter.hpp"
+#include "../ReverseIndex.hpp"
+#include "../Snapshot.hpp"
+#include "../TrigramIndex.hpp"
+#include <atomic>
+#include <vector>
 
 using json = nlohmann::json;
 
 /**
- * Dummy implementation of an yp Backend.
+ * Dummy implementation of an yp Backend. Entries are kept in memory,
+ * in a set of independently locked shards (the "num_shards" field of
+ * the configuration, 64 by default) so that requests on different names
+ * rarely contend and snapshots can be taken and restored in parallel.
+ * Modified shards are tracked in a dirty bitmap so that checkpoints
+ * only need to write the shards that changed since the previous one.
+ * The "storage" field selects how shards hold their entries: "map"
+ * (default) uses std::unordered_map, "compact" packs numbers into
+ * integers and interns names in a byte arena (see yp::CompactStore).
+ * If "trigram_index" is true, each shard also maintains a trigram index
+ * of its names to speed up search(). If "reverse_index" is true, each
+ * shard also maps numbers to names, updated under the shard's lock along
+ * with its entries, so reverse lookups do not scan the phonebook.
+ * With compact storage, a background ULT reclaims the arena slabs in
+ * which less than "compaction_threshold" (0.5 by default) of the bytes
+ * are live, every "compaction_interval_ms" milliseconds (1000 by default,
+ * 0 disables it), one slab and one shard at a time. If "name_filter" is
+ * true, a Bloom filter over the names (see yp::NameFilter) is maintained
+ * for clients to download, and rebuilt from the shards whenever it holds
+ * more names than it was sized for, or after a restore.
  */
 class DummyPhonebook : public yp::Backend {
 
-    thallium::engine m_engine;
-    json             m_config;
+    struct Shard {
+        thallium::mutex                   mutex;
+        std::unique_ptr<yp::EntryStore>   entries;
+        std::unique_ptr<yp::TrigramIndex> trigrams; // null unless "trigram_index" is true
+        std::unique_ptr<yp::ReverseIndex> numbers;  // null unless "reverse_index" is true
+
+        void insert(std::string_view name, std::string_view number);
+        bool erase(std::string_view name);
+        void swap(Shard& other);
+    };
+
+    thallium::engine   m_engine;
+    json               m_config;
+    std::string        m_storage;
+    bool               m_trigram_index;
+    bool               m_reverse_index;
+    std::vector<Shard> m_shards;
+    size_t             m_chunk_size;
+    yp::DirtyBitmap    m_dirty;
+    size_t             m_max_deltas;
+    std::string        m_checkpoint_chain;
+    thallium::mutex    m_checkpoint_mutex;
+    std::unique_ptr<yp::NameFilter> m_filter; // null unless "name_filter" is true
+
+    double                       m_compaction_threshold;
+    double                       m_compaction_interval;
+    std::atomic<bool>            m_compaction_stop{false};
+    bool                         m_compaction_running = false;
+    thallium::mutex              m_compaction_mutex;
+    thallium::condition_variable m_compaction_cv;
+    thallium::eventual<void>     m_compaction_done;
+    std::atomic<size_t>          m_compaction_steps{0};
+    std::atomic<size_t>          m_reclaimed_bytes{0};
+
+    void compactionLoop();
+
+    /**
+     * Rebuilds the name filter from the shards. If another rebuild is
+     * in progress, waits for it to end first if wait is true, or does
+     * nothing otherwise.
+     */
+    void rebuildFilter(bool wait);
+
+    size_t shardIndex(std::string_view name) const;
+
+    void initShards(std::vector<Shard>& shards) const;
+
+    std::vector<yp::SnapshotChunk> makeChunks(const std::vector<size_t>& shards,
+                                              bool keep_empty,
+                                              const thallium::pool& pool);
+
+    std::vector<bool> readShards(const std::string& path,
+                                 const thallium::pool& pool,
+                                 std::vector<Shard>& shards,
+                                 bool same_sharding_only);
 
     public:
 
+    using yp::Backend::insert;
+    using yp::Backend::lookup;
+    using yp::Backend::erase;
+
     /**
      * @brief Constructor.
      */
@@ -46,9 +130,9 @@ class DummyPhonebook : public yp::Backend {
     DummyPhonebook& operator=(const DummyPhonebook&) = default;
 
     /**
-     * @brief Destructor.
+     * @brief Destructor. Stops the compaction ULT, if any.
      */
-    virtual ~DummyPhonebook() = default;
+    virtual ~DummyPhonebook();
 
     /**
      * @brief Get the phonebook's configuration as a JSON-formatted string.
@@ -70,6 +154,129 @@ class DummyPhonebook : public yp::Backend {
      */
     yp::RequestResult<int32_t> computeSum(int32_t x, int32_t y) override;
 
+    /**
+     * @brief Inserts a name/number pair in the phonebook.
+     */
+    yp::RequestResult<bool> insert(const std::string& name,
+                                   const std::string& number) override;
+
+    /**
+     * @brief Inserts a name/number pair in the phonebook.
+     */
+    yp::RequestResult<bool> insert(std::string_view name,
+                                   std::string_view number) override;
+
+    /**
+     * @brief Looks up the number associated with a name.
+     */
+    yp::RequestResult<std::string> lookup(const std::string& name) override;
+
+    /**
+     * @brief Looks up the number associated with a name. With compact
+     * storage, this does not allocate unless the number is too long
+     * for std::string's small-string buffer.
+     */
+    yp::RequestResult<std::string> lookup(std::string_view name) override;
+
+    /**
+     * @brief Erases a name from the phonebook.
+     */
+    yp::RequestResult<bool> erase(const std::string& name) override;
+
+    /**
+     * @brief Erases a name from the phonebook.
+     */
+    yp::RequestResult<bool> erase(std::string_view name) override;
+
+    /**
+     * @brief Looks up a batch of names, reusing a single string
+     * to read the numbers out of the shards.
+     */
+    yp::RequestResult<yp::LookupBuffer> lookupMulti(const std::vector<std::string_view>& names) override;
+
+    /**
+     * @brief Returns the memory used by the entries, the secondary
+     * indexes and the name filter.
+     */
+    size_t residentBytes() override;
+
+    /**
+     * @brief Returns the number of entries and the memory they use,
+     * in total and per entry, as a JSON-formatted string.
+     */
+    std::string getStats() override;
+
+    /**
+     * @brief Searches for names containing the pattern with at most
+     * max_edit_distance edits, using the shards' trigram indexes if
+     * enabled, or by checking every name otherwise. The best matches
+     * (fewest edits, then by name) are returned first.
+     */
+    yp::RequestResult<std::vector<std::pair<std::string, std::string>>>
+        search(const std::string& pattern, uint32_t max_edit_distance, size_t limit) override;
+
+    /**
+     * @brief Finds the names associated with each number, locking each
+     * shard once for all the numbers. Uses the shards' reverse indexes if
+     * enabled, or goes over every entry otherwise. Names are sorted.
+     */
+    yp::RequestResult<std::vector<std::vector<std::string>>>
+        reverseLookupMulti(const std::vector<std::string>& numbers) override;
+
+    /**
+     * @brief Evaluates a scan query with one ULT per shard in the pool,
+     * each reducing its shard (under the shard's lock) to a partial
+     * result, the partial results being merged at the end.
+     */
+    yp::RequestResult<yp::ScanResult> scan(const yp::ScanQuery& query,
+                                           const thallium::pool& pool) override;
+
+    /**
+     * @brief Returns the changes to the name filter since the given
+     * version, if "name_filter" is enabled.
+     */
+    yp::RequestResult<yp::FilterUpdate> getFilter(uint64_t epoch, uint64_t version) override;
+
+    /**
+     * @brief Goes over the shards, reclaiming at most one sparse arena
+     * slab per shard and yielding between shards, until there is nothing
+     * left to reclaim. Only does something with compact storage.
+     *
+     * @param threshold Fraction of live bytes under which a slab is reclaimed.
+     *
+     * @return the number of bytes returned to the OS.
+     */
+    size_t compact(double threshold);
+
+    /**
+     * @brief Writes the content of the phonebook into a snapshot file,
+     * with one ULT per shard. Shards are locked only while their
+     * entries are copied into snapshot chunks of at most "snapshot_chunk_size"
+     * entries (65536 by default).
+     */
+    yp::RequestResult<bool> snapshot(const std::string& path,
+                                     const thallium::pool& pool) override;
+
+    /**
+     * @brief Replaces the content of the phonebook with that of a snapshot file.
+     * Chunks are decoded in parallel into new shards, which are swapped in
+     * only once the whole snapshot has been read successfully.
+     */
+    yp::RequestResult<bool> restore(const std::string& path,
+                                    const thallium::pool& pool) override;
+
+    /**
+     * @brief Writes an incremental checkpoint into a directory. Only the
+     * shards marked dirty since the previous checkpoint are written, unless
+     * the chain already has "checkpoint_max_deltas" deltas (8 by default),
+     * in which case a full snapshot is written and the old chain is removed.
+     * The dirty bitmap is only relative to the chain this phonebook last
+     * checkpointed into, so a directory holding any other chain (or none)
+     * always gets a full snapshot that starts a new chain.
+     */
+    yp::RequestResult<bool> checkpoint(const std::string& directory,
+                                       const thallium::pool& pool) override;
+
     /**
      * @brief Destroys the underlying phonebook.
      *
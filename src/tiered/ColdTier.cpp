@@ -0,0 +1,423 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "ColdTier.hpp"
+#include "yp/Backend.hpp"
+#include "yp/Exception.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace yp {
+
+using namespace std::string_literals;
+
+namespace {
+
+// records are [name size][number size][name][number], sizes being
+// little-endian 32-bit integers and a tombstone having no number
+constexpr uint32_t kTombstone    = 0xFFFFFFFF;
+constexpr size_t   kRecordHeader = 8;
+constexpr size_t   kWriteBuffer  = 1 << 20;
+constexpr size_t   kReadBuffer   = 1 << 16;
+
+inline void putU32(std::string& out, uint32_t v) {
+    for(int i = 0; i < 4; i++) out.push_back(static_cast<char>(v >> (8*i)));
+}
+
+inline uint32_t getU32(const char* p) {
+    uint32_t v = 0;
+    for(int i = 0; i < 4; i++) v |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (8*i);
+    return v;
+}
+
+std::string systemError(const std::string& what, const std::string& path) {
+    return what + " "s + path + ": " + std::strerror(errno);
+}
+
+void writeAll(IoEngine& io, int fd, const char* data, size_t size, off_t offset,
+              const std::string& path) {
+    while(size > 0) {
+        ssize_t n = io.pwrite(fd, data, size, offset);
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            throw Exception(systemError("Could not write to", path));
+        }
+        data   += n;
+        size   -= n;
+        offset += n;
+    }
+}
+
+size_t readSome(IoEngine& io, int fd, char* data, size_t size, off_t offset,
+                const std::string& path) {
+    size_t total = 0;
+    while(total < size) {
+        ssize_t n = io.pread(fd, data + total, size - total, offset + total);
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            throw Exception(systemError("Could not read from", path));
+        }
+        if(n == 0) break;
+        total += n;
+    }
+    return total;
+}
+
+/**
+ * Parses the record at p, of which at most size bytes are available.
+ * Returns its size, or 0 if it is not complete.
+ */
+size_t parseRecord(const char* p, size_t size,
+                   std::string_view* name, std::string_view* number, bool* erased) {
+    if(size < kRecordHeader) return 0;
+    uint32_t name_size   = getU32(p);
+    uint32_t number_size = getU32(p + 4);
+    *erased = number_size == kTombstone;
+    if(*erased) number_size = 0;
+    size_t total = kRecordHeader + name_size + number_size;
+    if(size < total) return 0;
+    *name   = std::string_view(p + kRecordHeader, name_size);
+    *number = std::string_view(p + kRecordHeader + name_size, number_size);
+    return total;
+}
+
+/**
+ * Writes records, sorted by name, into a new run file.
+ */
+class RunWriter {
+
+    public:
+
+    RunWriter(IoEngine& io, const std::string& path)
+    : m_io(io) {
+        m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(m_fd < 0) throw Exception(systemError("Could not create", path));
+        m_path = path;
+    }
+
+    ~RunWriter() {
+        if(m_fd >= 0) {
+            ::close(m_fd);
+            ::unlink(m_path.c_str());
+        }
+    }
+
+    void add(std::string_view name, std::string_view number, bool erased) {
+        if(m_count % ColdTier::kIndexInterval == 0)
+            m_index.emplace_back(std::string(name), m_size + m_buffer.size());
+        putU32(m_buffer, static_cast<uint32_t>(name.size()));
+        putU32(m_buffer, erased ? kTombstone : static_cast<uint32_t>(number.size()));
+        m_buffer.append(name);
+        if(!erased) m_buffer.append(number);
+        m_count += 1;
+        if(m_buffer.size() >= kWriteBuffer) flush();
+    }
+
+    template<typename Run>
+    void finish(Run& run) {
+        flush();
+        run.path  = m_path;
+        run.fd    = m_fd;
+        run.size  = m_size;
+        run.count = m_count;
+        run.index = std::move(m_index);
+        m_fd = -1;
+    }
+
+    private:
+
+    void flush() {
+        writeAll(m_io, m_fd, m_buffer.data(), m_buffer.size(), m_size, m_path);
+        m_size += m_buffer.size();
+        m_buffer.clear();
+    }
+
+    IoEngine&   m_io;
+    std::string m_path;
+    int         m_fd    = -1;
+    uint64_t    m_size  = 0;
+    uint64_t    m_count = 0;
+    std::string m_buffer;
+    std::vector<std::pair<std::string, uint64_t>> m_index;
+};
+
+/**
+ * Reads the records of a run in order.
+ */
+class RunReader {
+
+    public:
+
+    RunReader(IoEngine& io, int fd, uint64_t size, const std::string& path)
+    : m_io(io), m_fd(fd), m_size(size), m_path(path) {}
+
+    /**
+     * Moves to the next record, returning false at the end of the run.
+     * The views remain valid until the next call.
+     */
+    bool next() {
+        m_pos += m_current;
+        m_current = parseRecord(m_buffer.data() + m_pos, m_buffer.size() - m_pos,
+                                &name, &number, &erased);
+        if(m_current) return true;
+        // the record is not (completely) in the buffer
+        m_buffer.erase(0, m_pos);
+        m_pos = 0;
+        while(true) {
+            if(m_offset >= m_size) {
+                if(!m_buffer.empty())
+                    throw Exception("Truncated record in "s + m_path);
+                return false;
+            }
+            size_t old_size = m_buffer.size();
+            size_t wanted = std::max(kReadBuffer, old_size);
+            m_buffer.resize(old_size + wanted);
+            size_t n = readSome(m_io, m_fd, &m_buffer[old_size], wanted, m_offset, m_path);
+            m_buffer.resize(old_size + n);
+            m_offset += n;
+            if(n == 0) m_offset = m_size;
+            m_current = parseRecord(m_buffer.data(), m_buffer.size(), &name, &number, &erased);
+            if(m_current) return true;
+        }
+    }
+
+    std::string_view name;
+    std::string_view number;
+    bool             erased = false;
+
+    private:
+
+    IoEngine&   m_io;
+    int         m_fd;
+    uint64_t    m_size;
+    uint64_t    m_offset  = 0;
+    size_t      m_pos     = 0;
+    size_t      m_current = 0;
+    std::string m_buffer;
+    std::string m_path;
+};
+
+}
+
+ColdTier::ColdTier(std::string path, const Backend& backend)
+: m_path(std::move(path))
+, m_backend(backend) {}
+
+ColdTier::~ColdTier() {
+    clear();
+}
+
+void ColdTier::closeRun(Run& run) {
+    if(run.fd < 0) return;
+    ::close(run.fd);
+    ::unlink(run.path.c_str());
+    run.fd = -1;
+    m_backend.blockCache().forgetFile(run.cache_id);
+}
+
+void ColdTier::clear() {
+    for(auto& run : m_runs) closeRun(run);
+    m_runs.clear();
+    if(m_merge.output.fd >= 0) {
+        // written but never swapped in
+        ::close(m_merge.output.fd);
+        ::unlink(m_merge.output.path.c_str());
+    }
+    m_merge = Merge();
+}
+
+std::string ColdTier::nextPath() {
+    return m_path + "." + std::to_string(m_next_id++) + ".run";
+}
+
+void ColdTier::appendRun(std::vector<Record>& records) {
+    if(records.empty()) return;
+    std::sort(records.begin(), records.end(),
+              [](const Record& a, const Record& b) { return a.name < b.name; });
+    Run run;
+    {
+        RunWriter writer(m_backend.ioEngine(), nextPath());
+        for(auto& r : records)
+            writer.add(r.name, r.number, r.erased);
+        writer.finish(run);
+    }
+    run.cache_id = m_backend.blockCache().newFileId();
+    m_runs.push_back(std::move(run));
+}
+
+bool ColdTier::startMerge() {
+    size_t last = m_runs.size();
+    if(last < 2) return false;
+    size_t   first = last - 1;
+    uint64_t tail  = m_runs[first].count;
+    while(first > 0 && m_runs[first - 1].count <= 2 * tail) {
+        first -= 1;
+        tail  += m_runs[first].count;
+    }
+    if(first + 1 == last) return false;
+    m_merge = Merge();
+    m_merge.first           = first;
+    m_merge.last            = last;
+    m_merge.drop_tombstones = first == 0;
+    for(size_t i = first; i < last; i++) {
+        Run input;
+        input.path = m_runs[i].path;
+        input.fd   = m_runs[i].fd;
+        input.size = m_runs[i].size;
+        m_merge.inputs.push_back(std::move(input));
+    }
+    m_merge.path = nextPath();
+    return true;
+}
+
+void ColdTier::runMerge() {
+    // runs appended meanwhile are newer than the merged ones and their
+    // files are never modified, so only the copies in m_merge are used
+    try {
+        auto& inputs = m_merge.inputs;
+        // the readers' views point into their buffers, so they must not move
+        std::vector<RunReader> readers;
+        readers.reserve(inputs.size());
+        std::vector<bool> valid;
+        for(auto& input : inputs) {
+            readers.emplace_back(m_backend.ioEngine(), input.fd, input.size, input.path);
+            valid.push_back(readers.back().next());
+        }
+        RunWriter writer(m_backend.ioEngine(), m_merge.path);
+        while(true) {
+            // smallest name, the newest run winning ties
+            size_t best = readers.size();
+            for(size_t i = readers.size(); i-- > 0; ) {
+                if(!valid[i]) continue;
+                if(best == readers.size() || readers[i].name < readers[best].name)
+                    best = i;
+            }
+            if(best == readers.size()) break;
+            std::string name(readers[best].name);
+            if(!(m_merge.drop_tombstones && readers[best].erased))
+                writer.add(name, readers[best].number, readers[best].erased);
+            for(size_t i = 0; i < readers.size(); i++)
+                while(valid[i] && readers[i].name == name)
+                    valid[i] = readers[i].next();
+        }
+        writer.finish(m_merge.output);
+        m_merge.done = true;
+    } catch(const std::exception&) {
+        // the runs are still there, they will be merged next time
+    }
+}
+
+bool ColdTier::finishMerge() {
+    if(!m_merge.done) {
+        m_merge = Merge();
+        return false;
+    }
+    size_t first = m_merge.first;
+    size_t last  = m_merge.last;
+    Run merged = std::move(m_merge.output);
+    m_merge = Merge();
+    merged.cache_id = m_backend.blockCache().newFileId();
+    for(size_t i = first; i < last; i++) closeRun(m_runs[i]);
+    m_runs.erase(m_runs.begin() + first, m_runs.begin() + last);
+    if(merged.count) {
+        m_runs.insert(m_runs.begin() + first, std::move(merged));
+    } else {
+        closeRun(merged);
+    }
+    return true;
+}
+
+bool ColdTier::find(std::string_view name, std::string* number, bool* erased) const {
+    auto& io    = m_backend.ioEngine();
+    auto& cache = m_backend.blockCache();
+    auto& owner = m_backend.blockCacheOwner();
+    IoEngine::Buffer  buffer;
+    BlockCache::Block block;
+    for(auto run = m_runs.rbegin(); run != m_runs.rend(); ++run) {
+        auto& index = run->index;
+        auto it = std::upper_bound(index.begin(), index.end(), name,
+            [](std::string_view n, const std::pair<std::string, uint64_t>& e) { return n < e.first; });
+        if(it == index.begin()) continue; // before the first name of the run
+        uint64_t begin = std::prev(it)->second;
+        uint64_t end   = it == index.end() ? run->size : it->second;
+        size_t   group_size = end - begin;
+        const char* data;
+        size_t      read;
+        if(cache.capacity() > 0) {
+            block = cache.find(owner, run->cache_id, begin);
+            if(!block) {
+                auto group = std::make_shared<std::string>(group_size, '\0');
+                if(readSome(io, run->fd, &(*group)[0], group_size, begin, run->path) != group_size)
+                    throw Exception("Truncated run "s + run->path);
+                block = std::move(group);
+                cache.insert(owner, run->cache_id, begin, block);
+            }
+            read = block->size();
+            data = block->data();
+        } else if(group_size <= io.bufferSize() && io.options().num_buffers > 0) {
+            // groups usually fit in a registered buffer, which regular
+            // files fill completely unless the read reaches their end
+            if(!buffer.data()) buffer = io.acquireBuffer();
+            ssize_t r;
+            do {
+                r = io.pread(run->fd, buffer, group_size, begin);
+            } while(r < 0 && errno == EINTR);
+            if(r < 0) throw Exception(systemError("Could not read from", run->path));
+            read = r;
+            data = buffer.data();
+        } else {
+            auto group = std::make_shared<std::string>(group_size, '\0');
+            read  = readSome(io, run->fd, &(*group)[0], group_size, begin, run->path);
+            data  = group->data();
+            block = std::move(group);
+        }
+        if(read != group_size)
+            throw Exception("Truncated run "s + run->path);
+        size_t pos = 0;
+        std::string_view n, v;
+        bool e;
+        while(pos < group_size) {
+            size_t size = parseRecord(data + pos, group_size - pos, &n, &v, &e);
+            if(size == 0) throw Exception("Truncated record in "s + run->path);
+            if(n == name) {
+                *erased = e;
+                if(!e && number) number->assign(v.data(), v.size());
+                return true;
+            }
+            if(n > name) break;
+            pos += size;
+        }
+    }
+    return false;
+}
+
+uint64_t ColdTier::numRecords() const {
+    uint64_t total = 0;
+    for(auto& run : m_runs) total += run.count;
+    return total;
+}
+
+uint64_t ColdTier::fileBytes() const {
+    uint64_t total = 0;
+    for(auto& run : m_runs) total += run.size;
+    return total;
+}
+
+size_t ColdTier::indexBytes() const {
+    size_t total = 0;
+    for(auto& run : m_runs) {
+        total += run.index.capacity() * sizeof(run.index[0]);
+        for(auto& entry : run.index)
+            if(entry.first.capacity() > 15) total += entry.first.capacity() + 1;
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,148 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __YP_COLD_TIER_H
+#define __YP_COLD_TIER_H
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace yp {
+
+class Backend;
+
+/**
+ * @brief File-backed store for the entries that the tiered backend
+ * demotes out of memory. Entries are written in runs: each batch of
+ * demoted entries is sorted by name and written to a new append-only
+ * file, along with an in-memory sparse index holding the first name of
+ * every kIndexInterval records and its offset. A lookup goes over the
+ * runs from the newest to the oldest, reading at most one group of
+ * records per run. Runs are merged as they accumulate, like a binary
+ * counter: whenever a run is at most twice as large as the run after
+ * it, both are merged into one, keeping only the newest record of each
+ * name. Erasures are recorded as tombstones, which are dropped by the
+ * merges that include the oldest run. Merges are left to the owner of
+ * the tier (see startMerge), so that it may write them in the background
+ * while runs are appended and looked up. The files are scratch space and
+ * are removed by the destructor. All the file I/O goes through the
+ * IoEngine of the backend, and the groups of records read by lookups
+ * are kept in its BlockCache.
+ */
+class ColdTier {
+
+    public:
+
+    static constexpr size_t kIndexInterval = 16;
+
+    struct Record {
+        std::string name;
+        std::string number;
+        bool        erased = false;
+    };
+
+    /**
+     * @brief Constructor. Run files are named path.<n>.run. The backend
+     * provides the IoEngine and BlockCache, which it may only be given
+     * after the construction of the tier.
+     */
+    ColdTier(std::string path, const Backend& backend);
+
+    ~ColdTier();
+
+    ColdTier(const ColdTier&) = delete;
+    ColdTier& operator=(const ColdTier&) = delete;
+
+    /**
+     * @brief Writes the records as a new run, sorting them by name
+     * first. Names must be unique. Throws an Exception if the run cannot
+     * be written, in which case the tier is unchanged. The runs are not
+     * merged until the next call to startMerge.
+     */
+    void appendRun(std::vector<Record>& records);
+
+    /**
+     * @brief Picks the newest runs to merge, if they need to be, and
+     * returns whether they do. The merge is then written by runMerge,
+     * which may run concurrently with appendRun and find, and swapped in
+     * by finishMerge. Only one merge may be in progress at a time.
+     */
+    bool startMerge();
+
+    /**
+     * @brief Writes the merged run picked by startMerge. Never throws:
+     * a failure is reported by finishMerge.
+     */
+    void runMerge();
+
+    /**
+     * @brief Replaces the merged runs with the run written by runMerge.
+     * Returns false if the merge failed, in which case the runs are left
+     * unmerged until the next merge.
+     */
+    bool finishMerge();
+
+    /**
+     * @brief Finds the newest record of a name. Returns false if there
+     * is none, otherwise sets erased and, for a live record, number.
+     */
+    bool find(std::string_view name, std::string* number, bool* erased) const;
+
+    size_t numRuns() const {
+        return m_runs.size();
+    }
+
+    /**
+     * @brief Total number of records in the runs, including the
+     * shadowed ones and tombstones.
+     */
+    uint64_t numRecords() const;
+
+    uint64_t fileBytes() const;
+
+    size_t indexBytes() const;
+
+    /**
+     * @brief Removes all the runs.
+     */
+    void clear();
+
+    private:
+
+    struct Run {
+        std::string path;
+        int         fd       = -1;
+        uint64_t    size     = 0;
+        uint64_t    count    = 0;
+        uint64_t    cache_id = 0; // file id in the block cache
+        std::vector<std::pair<std::string, uint64_t>> index; // first name of each group
+    };
+
+    struct Merge {
+        size_t           first = 0; // merges m_runs[first, last)
+        size_t           last  = 0;
+        bool             drop_tombstones = false;
+        std::vector<Run> inputs;    // copies of the merged runs, without their index
+        std::string      path;
+        Run              output;
+        bool             done  = false;
+    };
+
+    std::string      m_path;
+    const Backend&   m_backend;
+    uint64_t         m_next_id = 0;
+    std::vector<Run> m_runs; // oldest first
+    Merge            m_merge;
+
+    std::string nextPath();
+    void closeRun(Run& run);
+};
+
+}
+
+#endif
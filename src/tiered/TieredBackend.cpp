@@ -0,0 +1,311 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "TieredBackend.hpp"
+#include <yp/Exception.hpp>
+#include <iostream>
+#include <mutex>
+
+YP_REGISTER_BACKEND(tiered, TieredPhonebook);
+
+namespace {
+
+constexpr size_t kNotFound      = static_cast<size_t>(-1);
+constexpr size_t kIndexOverhead = 64; // node of the hash table
+
+std::string coldTierPath(const json& config) {
+    auto path = config.find("path");
+    if(path == config.end() || !path->is_string()
+    || path->get_ref<const std::string&>().empty())
+        throw yp::Exception("path must be a non-empty string");
+    return path->get<std::string>();
+}
+
+}
+
+TieredPhonebook::TieredPhonebook(thallium::engine engine, const json& config)
+: m_engine(std::move(engine)),
+  m_config(config),
+  m_hot_limit(config.value("hot_bytes", size_t(64) << 20)),
+  m_cold(coldTierPath(config), *this) {}
+
+TieredPhonebook::~TieredPhonebook() {
+    stopMerges();
+}
+
+size_t TieredPhonebook::entryBytes(const HotEntry& entry) {
+    return sizeof(HotEntry) + kIndexOverhead + entry.name.size() + entry.number.size();
+}
+
+size_t TieredPhonebook::findHot(std::string_view name) {
+    auto it = m_hot_index.find(name);
+    return it == m_hot_index.end() ? kNotFound : it->second;
+}
+
+TieredPhonebook::HotEntry& TieredPhonebook::addHot(std::string_view name, std::string_view number) {
+    size_t index;
+    if(!m_free_entries.empty()) {
+        index = m_free_entries.back();
+        m_free_entries.pop_back();
+    } else {
+        index = m_hot_entries.size();
+        m_hot_entries.emplace_back();
+    }
+    auto& entry = m_hot_entries[index];
+    entry.name.assign(name.data(), name.size());
+    entry.number.assign(number.data(), number.size());
+    entry.used       = true;
+    entry.referenced = true;
+    m_hot_index.emplace(entry.name, index);
+    m_hot_bytes += entryBytes(entry);
+    return entry;
+}
+
+void TieredPhonebook::removeHot(size_t index) {
+    auto& entry = m_hot_entries[index];
+    m_hot_bytes -= entryBytes(entry);
+    m_hot_index.erase(entry.name);
+    entry = HotEntry(); // releases the strings
+    m_free_entries.push_back(index);
+}
+
+void TieredPhonebook::demoteIfNeeded() {
+    if(m_hot_bytes <= m_hot_limit) return;
+    // demote down to a low watermark, so that runs are not too small
+    size_t target = m_hot_limit / 10 * 9;
+    size_t n = m_hot_entries.size();
+    std::vector<bool>                 selected(n, false);
+    std::vector<size_t>               victims;
+    std::vector<yp::ColdTier::Record> records;
+    size_t freed = 0;
+    // after one turn every entry has lost its second chance
+    for(size_t step = 0; step < 2 * n && m_hot_bytes - freed > target; step++) {
+        size_t index = m_clock_hand;
+        m_clock_hand = (m_clock_hand + 1) % n;
+        auto& entry = m_hot_entries[index];
+        if(!entry.used || selected[index]) continue;
+        if(entry.referenced) {
+            entry.referenced = false;
+            continue;
+        }
+        selected[index] = true;
+        victims.push_back(index);
+        freed += entryBytes(entry);
+        // clean entries are already in the cold tier
+        if(entry.dirty)
+            records.push_back({ entry.name, entry.number, entry.erased });
+    }
+    try {
+        m_cold.appendRun(records);
+    } catch(const std::exception&) {
+        // the entries stay in memory, over the limit, until the next attempt
+        m_demote_errors += 1;
+        return;
+    }
+    for(auto index : victims) removeHot(index);
+    m_demoted += victims.size();
+    scheduleMerge();
+}
+
+void TieredPhonebook::scheduleMerge() {
+    if(m_merging || m_merges_stopped || !m_cold.startMerge()) return;
+    m_merging = true;
+    // the previous merger has released the mutex for the last time,
+    // joining it only reclaims it
+    if(m_merger) (*m_merger)->join();
+    m_merger.emplace(m_engine.get_handler_pool().make_thread([this]() { mergeRuns(); }));
+}
+
+void TieredPhonebook::mergeRuns() {
+    std::unique_lock<thallium::mutex> lock(m_mutex);
+    do {
+        lock.unlock();
+        m_cold.runMerge();
+        lock.lock();
+    } while(m_cold.finishMerge() && !m_merges_stopped && m_cold.startMerge());
+    m_merging = false;
+}
+
+void TieredPhonebook::stopMerges() {
+    {
+        std::lock_guard<thallium::mutex> lock(m_mutex);
+        m_merges_stopped = true;
+    }
+    // no merger is started once stopped, and the last one needs the mutex
+    if(m_merger) (*m_merger)->join();
+    m_merger.reset();
+}
+
+void TieredPhonebook::sayHello() {
+    std::cout << "Hello World" << std::endl;
+}
+
+std::string TieredPhonebook::getConfig() const {
+    return m_config.dump();
+}
+
+yp::RequestResult<int32_t> TieredPhonebook::computeSum(int32_t x, int32_t y) {
+    yp::RequestResult<int32_t> result;
+    result.value() = x + y;
+    return result;
+}
+
+yp::RequestResult<bool> TieredPhonebook::insert(const std::string& name,
+                                                const std::string& number) {
+    return insert(std::string_view(name), std::string_view(number));
+}
+
+yp::RequestResult<bool> TieredPhonebook::insert(std::string_view name,
+                                                std::string_view number) {
+    yp::RequestResult<bool> result;
+    std::lock_guard<thallium::mutex> lock(m_mutex);
+    auto index = findHot(name);
+    if(index != kNotFound) {
+        auto& entry = m_hot_entries[index];
+        m_hot_bytes -= entryBytes(entry);
+        entry.number.assign(number.data(), number.size());
+        entry.referenced = true;
+        entry.dirty      = true;
+        entry.erased     = false;
+        m_hot_bytes += entryBytes(entry);
+    } else {
+        addHot(name, number).dirty = true;
+    }
+    demoteIfNeeded();
+    return result;
+}
+
+yp::RequestResult<std::string> TieredPhonebook::lookup(const std::string& name) {
+    return lookup(std::string_view(name));
+}
+
+yp::RequestResult<std::string> TieredPhonebook::lookup(std::string_view name) {
+    yp::RequestResult<std::string> result;
+    std::lock_guard<thallium::mutex> lock(m_mutex);
+    auto index = findHot(name);
+    if(index != kNotFound) {
+        auto& entry = m_hot_entries[index];
+        if(entry.erased) {
+            m_misses += 1;
+            result.fail(yp::Status::NotFound);
+            return result;
+        }
+        entry.referenced = true;
+        m_hot_hits += 1;
+        result.value() = entry.number;
+        return result;
+    }
+    bool found, erased = false;
+    try {
+        found = m_cold.find(name, &result.value(), &erased);
+    } catch(const std::exception& ex) {
+        result.success() = false;
+        result.error() = ex.what();
+        return result;
+    }
+    if(!found || erased) {
+        m_misses += 1;
+        result.fail(yp::Status::NotFound);
+        return result;
+    }
+    m_cold_hits += 1;
+    m_promoted  += 1;
+    addHot(name, result.value()).dirty = false;
+    demoteIfNeeded();
+    return result;
+}
+
+yp::RequestResult<bool> TieredPhonebook::erase(const std::string& name) {
+    return erase(std::string_view(name));
+}
+
+yp::RequestResult<bool> TieredPhonebook::erase(std::string_view name) {
+    yp::RequestResult<bool> result;
+    std::lock_guard<thallium::mutex> lock(m_mutex);
+    auto index = findHot(name);
+    if(index != kNotFound && m_hot_entries[index].erased) {
+        result.fail(yp::Status::NotFound);
+        return result;
+    }
+    bool in_cold = index != kNotFound && !m_hot_entries[index].dirty;
+    if(!in_cold) {
+        bool erased = false;
+        try {
+            in_cold = m_cold.find(name, nullptr, &erased) && !erased;
+        } catch(const std::exception& ex) {
+            result.success() = false;
+            result.error() = ex.what();
+            return result;
+        }
+    }
+    if(index == kNotFound && !in_cold) {
+        result.fail(yp::Status::NotFound);
+        return result;
+    }
+    if(!in_cold) {
+        removeHot(index);
+        return result;
+    }
+    // the tombstone shadows the cold record until demoted over it
+    auto& entry = index == kNotFound ? addHot(name, "") : m_hot_entries[index];
+    m_hot_bytes -= entryBytes(entry);
+    entry.number.clear();
+    entry.referenced = false;
+    entry.dirty      = true;
+    entry.erased     = true;
+    m_hot_bytes += entryBytes(entry);
+    demoteIfNeeded();
+    return result;
+}
+
+size_t TieredPhonebook::residentBytes() {
+    std::lock_guard<thallium::mutex> lock(m_mutex);
+    return m_hot_bytes + m_cold.indexBytes();
+}
+
+std::string TieredPhonebook::getStats() {
+    std::lock_guard<thallium::mutex> lock(m_mutex);
+    uint64_t lookups = m_hot_hits + m_cold_hits + m_misses;
+    json result;
+    result["hot_entries"]      = m_hot_index.size();
+    result["hot_bytes"]        = m_hot_bytes;
+    result["hot_bytes_limit"]  = m_hot_limit;
+    result["cold_runs"]        = m_cold.numRuns();
+    result["cold_records"]     = m_cold.numRecords();
+    result["cold_file_bytes"]  = m_cold.fileBytes();
+    result["cold_index_bytes"] = m_cold.indexBytes();
+    result["hot_hits"]         = m_hot_hits;
+    result["cold_hits"]        = m_cold_hits;
+    result["misses"]           = m_misses;
+    result["hot_hit_rate"]     = lookups == 0 ? 0.0 : static_cast<double>(m_hot_hits) / lookups;
+    result["cold_hit_rate"]    = lookups == 0 ? 0.0 : static_cast<double>(m_cold_hits) / lookups;
+    result["demoted"]          = m_demoted;
+    result["promoted"]         = m_promoted;
+    result["demote_errors"]    = m_demote_errors;
+    return result.dump();
+}
+
+yp::RequestResult<bool> TieredPhonebook::destroy() {
+    yp::RequestResult<bool> result;
+    stopMerges();
+    std::lock_guard<thallium::mutex> lock(m_mutex);
+    m_merges_stopped = false;
+    m_cold.clear();
+    m_hot_index.clear();
+    m_hot_entries.clear();
+    m_free_entries.clear();
+    m_hot_bytes  = 0;
+    m_clock_hand = 0;
+    result.value() = true;
+    return result;
+}
+
+std::unique_ptr<yp::Backend> TieredPhonebook::create(const thallium::engine& engine, const json& config) {
+    return std::unique_ptr<yp::Backend>(new TieredPhonebook(engine, config));
+}
+
+std::unique_ptr<yp::Backend> TieredPhonebook::open(const thallium::engine& engine, const json& config) {
+    return std::unique_ptr<yp::Backend>(new TieredPhonebook(engine, config));
+}
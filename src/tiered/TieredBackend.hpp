@@ -0,0 +1,199 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __TIERED_BACKEND_HPP
+#define __TIERED_BACKEND_HPP
+
+#include <yp/Backend.hpp>
+#include "ColdTier.hpp"
+#include <deque>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using json = nlohmann::json;
+
+/**
+ * Tiered implementation of an yp Backend, for phonebooks with a small
+ * hot working set and a long cold tail. Recently used entries are kept
+ * in an in-memory table whose size is capped by "hot_bytes" (64 MiB by
+ * default). When the cap is exceeded, entries are chosen by the CLOCK
+ * algorithm (an entry used since the clock hand last passed it gets a
+ * second chance) and demoted until the table is back under 90% of the
+ * cap. Demoted entries go to a cold tier of sorted run files named after
+ * "path" (see yp::ColdTier). An entry found in the cold tier is promoted
+ * back into the table; it is only written again if it is modified before
+ * being demoted. Erasing an entry that may be in the cold tier leaves a
+ * tombstone in the table, demoted like any entry. The cold tier is
+ * scratch space: the phonebook is empty when created or opened, and
+ * its files are removed when it is closed or destroyed. All the
+ * operations are serialized by a single mutex, which is held across the
+ * reads of the cold tier and the writing of demoted runs: these go
+ * through the provider's IoEngine and only suspend the calling ULT.
+ * Merges of runs, which may rewrite the whole cold tier, are written by
+ * a ULT of the handler pool that only takes the mutex to pick the runs
+ * and to swap the merged run in. The groups of cold records read by
+ * lookups are kept in the provider's BlockCache.
+ */
+class TieredPhonebook : public yp::Backend {
+
+    struct HotEntry {
+        std::string name;
+        std::string number;
+        bool        used       = false;
+        bool        referenced = false; // used since the clock hand passed
+        bool        dirty      = false; // not (or differently) in the cold tier
+        bool        erased     = false; // tombstone
+    };
+
+    thallium::engine m_engine;
+    json             m_config;
+    size_t           m_hot_limit;
+    thallium::mutex  m_mutex;
+
+    std::deque<HotEntry>                         m_hot_entries; // stable addresses
+    std::vector<size_t>                          m_free_entries;
+    std::unordered_map<std::string_view, size_t> m_hot_index;   // views into m_hot_entries
+    size_t                                       m_hot_bytes  = 0;
+    size_t                                       m_clock_hand = 0;
+    yp::ColdTier                                 m_cold;
+
+    uint64_t m_hot_hits      = 0;
+    uint64_t m_cold_hits     = 0;
+    uint64_t m_misses        = 0;
+    uint64_t m_demoted       = 0;
+    uint64_t m_promoted      = 0;
+    uint64_t m_demote_errors = 0;
+
+    bool                                               m_merging        = false;
+    bool                                               m_merges_stopped = false;
+    std::optional<thallium::managed<thallium::thread>> m_merger; // last ULT that ran mergeRuns
+
+    static size_t entryBytes(const HotEntry& entry);
+
+    size_t findHot(std::string_view name); // index in m_hot_entries, or -1
+
+    HotEntry& addHot(std::string_view name, std::string_view number);
+
+    void removeHot(size_t index);
+
+    void demoteIfNeeded();
+
+    void scheduleMerge();
+
+    void mergeRuns();
+
+    void stopMerges();
+
+    public:
+
+    using yp::Backend::insert;
+    using yp::Backend::lookup;
+    using yp::Backend::erase;
+
+    /**
+     * @brief Constructor.
+     */
+    TieredPhonebook(thallium::engine engine, const json& config);
+
+    /**
+     * @brief Destructor. Waits for the merge in progress, if any, and
+     * removes the files of the cold tier.
+     */
+    virtual ~TieredPhonebook();
+
+    /**
+     * @brief Get the phonebook's configuration as a JSON-formatted string.
+     */
+    std::string getConfig() const override;
+
+    /**
+     * @brief Prints Hello World.
+     */
+    void sayHello() override;
+
+    /**
+     * @brief Compute the sum of two integers.
+     */
+    yp::RequestResult<int32_t> computeSum(int32_t x, int32_t y) override;
+
+    /**
+     * @brief Inserts a name/number pair in the hot tier.
+     */
+    yp::RequestResult<bool> insert(const std::string& name,
+                                   const std::string& number) override;
+
+    /**
+     * @brief Inserts a name/number pair in the hot tier.
+     */
+    yp::RequestResult<bool> insert(std::string_view name,
+                                   std::string_view number) override;
+
+    /**
+     * @brief Looks up a name in the hot tier, then in the cold tier,
+     * promoting the entry if found there.
+     */
+    yp::RequestResult<std::string> lookup(const std::string& name) override;
+
+    /**
+     * @brief Looks up a name in the hot tier, then in the cold tier,
+     * promoting the entry if found there.
+     */
+    yp::RequestResult<std::string> lookup(std::string_view name) override;
+
+    /**
+     * @brief Erases a name from the phonebook.
+     */
+    yp::RequestResult<bool> erase(const std::string& name) override;
+
+    /**
+     * @brief Erases a name from the phonebook.
+     */
+    yp::RequestResult<bool> erase(std::string_view name) override;
+
+    /**
+     * @brief Returns the memory used by the hot tier and by the
+     * sparse indexes of the cold tier.
+     */
+    size_t residentBytes() override;
+
+    /**
+     * @brief Returns the size of each tier and their hit rates,
+     * as a JSON-formatted string.
+     */
+    std::string getStats() override;
+
+    /**
+     * @brief Destroys the underlying phonebook, removing the
+     * files of the cold tier.
+     */
+    yp::RequestResult<bool> destroy() override;
+
+    /**
+     * @brief Static factory function used by the PhonebookFactory to
+     * create a TieredPhonebook.
+     *
+     * @param engine Thallium engine
+     * @param config JSON configuration for the phonebook
+     *
+     * @return a unique_ptr to a phonebook
+     */
+    static std::unique_ptr<yp::Backend> create(const thallium::engine& engine, const json& config);
+
+    /**
+     * @brief Static factory function used by the PhonebookFactory to
+     * open a TieredPhonebook. Since the cold tier is not persistent,
+     * this is the same as creating one.
+     *
+     * @param engine Thallium engine
+     * @param config JSON configuration for the phonebook
+     *
+     * @return a unique_ptr to a phonebook
+     */
+    static std::unique_ptr<yp::Backend> open(const thallium::engine& engine, const json& config);
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include <yp/Provider.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_all.hpp>
+#include <nlohmann/json.hpp>
 
 static const std::string phonebook_type = "dummy";
 static constexpr const char* phonebook_config = "{ \"path\" : \"mydb\" }";
@@ -31,6 +32,14 @@ TEST_CASE("Admin tests", "[admin]") {
 
             yp::UUID bad_id;
             REQUIRE_THROWS_AS(admin.destroyPhonebook(addr, 0, bad_id), yp::Exception);
+            REQUIRE_THROWS_WITH(admin.destroyPhonebook(addr, 0, bad_id), "Phonebook not found");
+        }
+
+        SECTION("Get the load of a provider") {
+            auto load = nlohmann::json::parse(admin.getProviderLoad(addr, 0));
+            REQUIRE(load.contains("rpcs_handled"));
+            REQUIRE(load.contains("utilization"));
+            REQUIRE(load["moved"] == false);
         }
     }
     // Finalize the engine
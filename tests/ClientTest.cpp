@@ -33,6 +33,30 @@ TEST_CASE("Client test", "[client]") {
         REQUIRE_THROWS_AS(client.makePhonebookHandle(addr, 0, bad_id), yp::Exception);
     }
 
+    SECTION("Slot handles") {
+        yp::Client client(engine);
+        std::string addr = engine.self();
+
+        // without a check, the handle is resolved on first use
+        auto unchecked = client.makePhonebookHandle(addr, 0, phonebook_id, false);
+        REQUIRE_NOTHROW(unchecked.insert("Alice", "+15555550100"));
+        std::string number;
+        REQUIRE_NOTHROW(unchecked.lookup("Alice", &number));
+        REQUIRE(number == "+15555550100");
+
+        // handles to a destroyed phonebook are stale and fail to resolve,
+        // even if another phonebook now occupies its slot
+        auto other_id = admin.createPhonebook(addr, 0, phonebook_type, phonebook_config);
+        auto other = client.makePhonebookHandle(addr, 0, other_id);
+        admin.destroyPhonebook(addr, 0, other_id);
+        auto third_id = admin.createPhonebook(addr, 0, phonebook_type, phonebook_config);
+        auto third = client.makePhonebookHandle(addr, 0, third_id);
+        REQUIRE_THROWS_AS(other.lookup("Alice", &number), yp::Exception);
+        REQUIRE_NOTHROW(third.insert("Bob", "+15555550101"));
+        REQUIRE_THROWS_AS(third.lookup("Alice", &number), yp::Exception);
+        admin.destroyPhonebook(addr, 0, third_id);
+    }
+
     admin.destroyPhonebook(addr, 0, phonebook_id);
     engine.finalize();
 }
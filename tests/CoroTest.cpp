@@ -0,0 +1,106 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_all.hpp>
+#include <yp/Client.hpp>
+#include <yp/Provider.hpp>
+#include <yp/Admin.hpp>
+#include <yp/CoroPhonebookHandle.hpp>
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <vector>
+
+static const std::string phonebook_type = "dummy";
+static constexpr const char* phonebook_config = "{ \"path\" : \"mydb\" }";
+
+// coroutine that starts immediately and is not awaited
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+static Detached insertAndLookup(yp::CoroPhonebookHandle phonebook, int i,
+                                std::string* number, int* done) {
+    auto name = "name" + std::to_string(i);
+    co_await phonebook.insert(name, "+1555" + std::to_string(i));
+    *number = co_await phonebook.lookup(name);
+    (*done)++;
+}
+
+static Detached lookupMissing(yp::CoroPhonebookHandle phonebook,
+                              std::string* error, int* done) {
+    try {
+        co_await phonebook.lookup("nobody");
+    } catch(const yp::Exception& ex) {
+        *error = ex.what();
+    }
+    (*done)++;
+}
+
+static Detached sumAndLookupMulti(yp::CoroPhonebookHandle phonebook,
+                                  int32_t* sum, yp::LookupBuffer* results, int* done) {
+    // both RPCs are in flight before the first co_await
+    auto pending_sum = phonebook.computeSum(40, 2);
+    std::vector<std::string> names = { "name1", "nobody", "name2" };
+    auto pending_lookups = phonebook.lookupMulti(names, results);
+    *sum = co_await pending_sum;
+    co_await pending_lookups;
+    (*done)++;
+}
+
+TEST_CASE("Coroutine test", "[coro]") {
+    auto engine = thallium::engine("na+sm", THALLIUM_SERVER_MODE);
+    yp::Admin admin(engine);
+    yp::Provider provider(engine);
+    std::string addr = engine.self();
+    auto phonebook_id = admin.createPhonebook(addr, 0, phonebook_type, phonebook_config);
+
+    SECTION("Await phonebook operations") {
+        yp::Client client(engine);
+        yp::CoroPhonebookHandle phonebook(client.makePhonebookHandle(addr, 0, phonebook_id));
+
+        // the coroutines are resumed by ULTs of the handler pool, which
+        // is the primary pool here, so this thread must yield to them
+        auto waitFor = [](const int& done, int expected) {
+            while(done != expected) thallium::thread::yield();
+        };
+
+        const int n = 1000;
+        std::vector<std::string> numbers(n);
+        int done = 0;
+        for(int i = 0; i < n; i++)
+            insertAndLookup(phonebook, i, &numbers[i], &done);
+        waitFor(done, n);
+        for(int i = 0; i < n; i++)
+            REQUIRE(numbers[i] == "+1555" + std::to_string(i));
+
+        std::string error;
+        done = 0;
+        lookupMissing(phonebook, &error, &done);
+        waitFor(done, 1);
+        REQUIRE(error == "Entry not found");
+
+        int32_t sum = 0;
+        yp::LookupBuffer results;
+        done = 0;
+        sumAndLookupMulti(phonebook, &sum, &results, &done);
+        waitFor(done, 1);
+        REQUIRE(sum == 42);
+        REQUIRE(results.size() == 3);
+        REQUIRE(results.value(0) == "+15551");
+        REQUIRE(!results.found(1));
+        REQUIRE(results.value(2) == "+15552");
+    }
+
+    admin.destroyPhonebook(addr, 0, phonebook_id);
+    engine.finalize();
+}
@@ -0,0 +1,106 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <yp/IoEngine.hpp>
+#include <yp/Exception.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_all.hpp>
+#include <thallium.hpp>
+#include <nlohmann/json.hpp>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+TEST_CASE("IoEngine tests", "[io]") {
+
+    auto engine = thallium::engine("na+sm", THALLIUM_SERVER_MODE);
+    const char* path = "io-engine-test.dat";
+    int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd >= 0);
+
+    for(std::string type : { "io_uring", "blocking" }) {
+        yp::IoEngineOptions options;
+        options.type        = type;
+        options.queue_depth = 64;
+        options.num_buffers = 4;
+        options.buffer_size = 4096;
+        yp::IoEngine io(options);
+        if(type == "blocking") REQUIRE(!io.usesIoUring());
+
+        DYNAMIC_SECTION("Concurrent reads and writes from ULTs (" << type << ")") {
+            // many more ULTs than the queue depth, each on its own block
+            constexpr int kBlocks = 256;
+            auto pool = engine.get_handler_pool();
+            std::vector<thallium::managed<thallium::thread>> ults;
+            std::vector<ssize_t> written(kBlocks), read(kBlocks);
+            std::vector<std::string> blocks(kBlocks);
+            for(int i = 0; i < kBlocks; i++) {
+                ults.push_back(pool.make_thread([&, i]() {
+                    std::string data(1000, static_cast<char>('a' + i % 26));
+                    written[i] = io.pwrite(fd, data.data(), data.size(), i * 1000);
+                }));
+            }
+            for(auto& ult : ults) ult->join();
+            ults.clear();
+            for(int i = 0; i < kBlocks; i++) {
+                ults.push_back(pool.make_thread([&, i]() {
+                    blocks[i].resize(1000);
+                    read[i] = io.pread(fd, &blocks[i][0], 1000, i * 1000);
+                }));
+            }
+            for(auto& ult : ults) ult->join();
+            for(int i = 0; i < kBlocks; i++) {
+                REQUIRE(written[i] == 1000);
+                REQUIRE(read[i] == 1000);
+                REQUIRE(blocks[i] == std::string(1000, static_cast<char>('a' + i % 26)));
+            }
+            auto stats = nlohmann::json::parse(io.getStats());
+            REQUIRE(stats["type"] == (io.usesIoUring() ? "io_uring" : "blocking"));
+            if(io.usesIoUring()) {
+                REQUIRE(stats["submitted"].get<uint64_t>() == 2 * kBlocks);
+                REQUIRE(stats["max_in_flight"].get<unsigned>() <= 64);
+            }
+        }
+
+        DYNAMIC_SECTION("Registered buffers (" << type << ")") {
+            auto buffer = io.acquireBuffer();
+            REQUIRE(buffer.size() == 4096);
+            std::memset(buffer.data(), 'x', buffer.size());
+            REQUIRE(io.pwrite(fd, buffer, 4096, 8192) == 4096);
+            std::memset(buffer.data(), 0, buffer.size());
+            REQUIRE(io.pread(fd, buffer, 4096, 8192) == 4096);
+            REQUIRE(std::string(buffer.data(), 4096) == std::string(4096, 'x'));
+            // reading past the end of the file
+            REQUIRE(io.pread(fd, buffer, 4096, 1 << 20) == 0);
+        }
+
+        DYNAMIC_SECTION("Errors (" << type << ")") {
+            char c;
+            ssize_t ret = io.pread(-1, &c, 1, 0);
+            int error = errno;
+            REQUIRE(ret == -1);
+            REQUIRE(error == EBADF);
+        }
+    }
+
+    SECTION("Invalid options") {
+        yp::IoEngineOptions options;
+        options.type = "blabla";
+        REQUIRE_THROWS_AS(yp::IoEngine(options), yp::Exception);
+        options = yp::IoEngineOptions();
+        options.queue_depth = 0;
+        REQUIRE_THROWS_AS(yp::IoEngine(options), yp::Exception);
+        options = yp::IoEngineOptions();
+        options.buffer_size = 1000;
+        REQUIRE_THROWS_AS(yp::IoEngine(options), yp::Exception);
+    }
+
+    ::close(fd);
+    ::unlink(path);
+    engine.finalize();
+}
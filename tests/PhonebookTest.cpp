@@ -8,10 +8,33 @@
 #include <yp/Client.hpp>
 #include <yp/Provider.hpp>
 #include <yp/Admin.hpp>
+#include <nlohmann/json.hpp>
+#include <thallium/serialization/stl/vector.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <vector>
 
 static const std::string phonebook_type = "dummy";
 static constexpr const char* phonebook_config = "{ \"path\" : \"mydb\" }";
 
+/**
+ * Batched operation of a kind that the provider does not know.
+ */
+struct UnknownBatchOp {
+    template<typename Archive>
+    void save(Archive& a) const {
+        uint8_t kind = 42;
+        a & kind;
+    }
+    template<typename Archive>
+    void load(Archive& a) {
+        uint8_t kind;
+        a & kind;
+    }
+};
+
 TEST_CASE("Phonebook test", "[phonebook]") {
     auto engine = thallium::engine("na+sm", THALLIUM_SERVER_MODE);
     yp::Admin admin(engine);
@@ -40,6 +63,691 @@ TEST_CASE("Phonebook test", "[phonebook]") {
             REQUIRE_NOTHROW(request.wait());
             REQUIRE(result == 94);
         }
+        SECTION("Send a batch with an unknown operation") {
+            // rejected as a whole, before the phonebook handle is checked
+            auto rpc = engine.define("yp_batch");
+            thallium::provider_handle ph(engine.lookup(addr), 0);
+            yp::RequestResult<std::vector<int32_t>> response =
+                rpc.on(ph)(uint32_t(0), std::vector<UnknownBatchOp>(2));
+            REQUIRE(!response.success());
+            REQUIRE(response.error() == "Unknown operation in batch");
+        }
+        SECTION("Send SumMany RPC") {
+            const size_t n = 1000;
+            std::vector<int32_t> x(n), y(n), out(n);
+            for(size_t i = 0; i < n; i++) {
+                x[i] = i;
+                y[i] = 2 * i;
+            }
+            x[3]   = std::numeric_limits<int32_t>::max();
+            y[3]   = 1;
+            x[999] = std::numeric_limits<int32_t>::min();
+            y[999] = -1;
+            std::vector<uint64_t> overflow((n + 63) / 64);
+            REQUIRE_NOTHROW(rh.computeSumMany(x.data(), y.data(), out.data(), n, overflow.data()));
+            REQUIRE(out[0] == 0);
+            REQUIRE(out[500] == 1500);
+            REQUIRE(out[3] == std::numeric_limits<int32_t>::min());
+            REQUIRE(out[999] == std::numeric_limits<int32_t>::max());
+            REQUIRE(overflow[0] == (uint64_t(1) << 3));
+            REQUIRE(overflow[999 / 64] == (uint64_t(1) << (999 % 64)));
+            for(size_t w = 1; w < overflow.size() - 1; w++)
+                REQUIRE(overflow[w] == 0);
+
+            std::vector<int32_t> out2(n);
+            yp::AsyncRequest request;
+            REQUIRE_NOTHROW(rh.computeSumMany(x.data(), y.data(), out2.data(), n, nullptr, &request));
+            REQUIRE_NOTHROW(request.wait());
+            REQUIRE(out2 == out);
+        }
+        SECTION("Insert, lookup and erase") {
+            REQUIRE_NOTHROW(rh.insert("Matthieu", "+15555550101"));
+            REQUIRE_NOTHROW(rh.insert("Rob", "+15555550102"));
+
+            std::string number;
+            REQUIRE_NOTHROW(rh.lookup("Matthieu", &number));
+            REQUIRE(number == "+15555550101");
+
+            yp::AsyncRequest request;
+            REQUIRE_NOTHROW(rh.lookup("Rob", &number, &request));
+            REQUIRE_NOTHROW(request.wait());
+            REQUIRE(number == "+15555550102");
+
+            REQUIRE_NOTHROW(rh.insert("Rob", "+15555550103"));
+            REQUIRE_NOTHROW(rh.lookup("Rob", &number));
+            REQUIRE(number == "+15555550103");
+
+            REQUIRE_NOTHROW(rh.erase("Rob"));
+            REQUIRE_THROWS_AS(rh.lookup("Rob", &number), yp::Exception);
+            REQUIRE_THROWS_AS(rh.erase("Rob"), yp::Exception);
+            REQUIRE_THROWS_WITH(rh.lookup("Rob", &number), "Entry not found");
+        }
+        SECTION("Lookup into a buffer") {
+            REQUIRE_NOTHROW(rh.insert("Matthieu", "+15555550101"));
+            REQUIRE_NOTHROW(rh.insert("Rob", "+15555550102"));
+
+            yp::LookupBuffer results;
+            REQUIRE_NOTHROW(rh.lookup("Rob", &results));
+            REQUIRE(results.size() == 1);
+            REQUIRE(results.found(0));
+            REQUIRE(results.value(0) == "+15555550102");
+            REQUIRE_NOTHROW(rh.lookup("Phil", &results));
+            REQUIRE(results.size() == 1);
+            REQUIRE(results.status(0) == yp::Status::NotFound);
+
+            std::vector<std::string> names = { "Rob", "Phil", "Matthieu", "Rob" };
+            for(int i = 0; i < 2; i++) {
+                yp::AsyncRequest request;
+                if(i == 0) {
+                    REQUIRE_NOTHROW(rh.lookupMulti(names, &results));
+                } else {
+                    REQUIRE_NOTHROW(rh.lookupMulti(names, &results, &request));
+                    REQUIRE_NOTHROW(request.wait());
+                }
+                REQUIRE(results.size() == 4);
+                REQUIRE(results.value(0) == "+15555550102");
+                REQUIRE(!results.found(1));
+                REQUIRE(results.value(1).empty());
+                REQUIRE(results.value(2) == "+15555550101");
+                REQUIRE(results.value(3) == "+15555550102");
+            }
+            REQUIRE_NOTHROW(rh.lookupMulti({}, &results));
+            REQUIRE(results.size() == 0);
+        }
+        SECTION("Coalescing") {
+            rh.enableCoalescing(16, 1000000);
+            const int n = 100;
+            std::vector<yp::AsyncRequest> requests(n);
+            std::vector<int32_t> sums(n);
+            for(int i = 0; i < n; i++)
+                REQUIRE_NOTHROW(rh.computeSum(i, 1, &sums[i], &requests[i]));
+            for(int i = n - 1; i >= 0; i--)
+                REQUIRE_NOTHROW(requests[i].wait());
+            for(int i = 0; i < n; i++)
+                REQUIRE(sums[i] == i + 1);
+
+            // operations of a batch are executed in order
+            yp::AsyncRequest insert1, insert2, lookup, erase, missing;
+            std::string number;
+            REQUIRE_NOTHROW(rh.insert("Matthieu", "+15555550101", &insert1));
+            REQUIRE_NOTHROW(rh.insert("Matthieu", "+15555550102", &insert2));
+            REQUIRE_NOTHROW(rh.lookup("Matthieu", &number, &lookup));
+            REQUIRE_NOTHROW(rh.erase("Matthieu", &erase));
+            REQUIRE_NOTHROW(rh.lookup("Matthieu", &number, &missing));
+            REQUIRE_THROWS_WITH(missing.wait(), "Entry not found");
+            REQUIRE_NOTHROW(lookup.wait());
+            REQUIRE(number == "+15555550102");
+            REQUIRE_NOTHROW(insert1.wait());
+            REQUIRE_NOTHROW(insert2.wait());
+            REQUIRE_NOTHROW(erase.wait());
+
+            rh.disableCoalescing();
+            REQUIRE_NOTHROW(rh.computeSum(1, 2, &sums[0], &requests[0]));
+            REQUIRE_NOTHROW(requests[0].wait());
+            REQUIRE(sums[0] == 3);
+        }
+        SECTION("One-way writes") {
+            const int n = 100;
+            for(int i = 0; i < n; i++)
+                REQUIRE_NOTHROW(rh.insertNoAck("name" + std::to_string(i), "+1555" + std::to_string(i)));
+            for(int i = 0; i < n; i += 2)
+                REQUIRE_NOTHROW(rh.eraseNoAck("name" + std::to_string(i)));
+            REQUIRE_NOTHROW(rh.flush());
+            std::string number;
+            for(int i = 0; i < n; i++) {
+                if(i % 2) {
+                    REQUIRE_NOTHROW(rh.lookup("name" + std::to_string(i), &number));
+                    REQUIRE(number == "+1555" + std::to_string(i));
+                } else {
+                    REQUIRE_THROWS_AS(rh.lookup("name" + std::to_string(i), &number), yp::Exception);
+                }
+            }
+
+            // errors are reported by the next flush only
+            REQUIRE_NOTHROW(rh.eraseNoAck("name0"));
+            REQUIRE_NOTHROW(rh.eraseNoAck("name1"));
+            REQUIRE_NOTHROW(rh.eraseNoAck("name2"));
+            std::vector<std::string> errors;
+            REQUIRE_NOTHROW(rh.flush(&errors));
+            REQUIRE(errors.size() == 2);
+            REQUIRE(errors[0] == "erase: Entry not found");
+            REQUIRE_NOTHROW(rh.flush(&errors));
+            REQUIRE(errors.empty());
+            REQUIRE_NOTHROW(rh.eraseNoAck("name0"));
+            REQUIRE_THROWS_AS(rh.flush(), yp::Exception);
+        }
+        SECTION("Broadcast") {
+            std::vector<yp::UUID> ids;
+            std::vector<yp::PhonebookHandle> handles;
+            for(int i = 0; i < 4; i++) {
+                ids.push_back(admin.createPhonebook(addr, 0, phonebook_type, phonebook_config));
+                handles.push_back(client.makePhonebookHandle(addr, 0, ids.back()));
+                handles.back().insert("name" + std::to_string(i), "+1555" + std::to_string(i));
+            }
+
+            // the name is held by a single phonebook, the others report an error
+            std::vector<std::pair<size_t, std::string>> errors;
+            std::string number;
+            size_t hits = client.broadcast<std::string>(handles,
+                [](const yp::PhonebookHandle& h, std::string* result, yp::AsyncRequest* req) {
+                    h.lookup("name2", result, req);
+                },
+                [&number](size_t, std::string&& result) { number = std::move(result); },
+                yp::BroadcastOptions(), &errors);
+            REQUIRE(hits == 1);
+            REQUIRE(number == "+15552");
+            REQUIRE(errors.size() == 3);
+            for(auto& error : errors) {
+                REQUIRE(error.first != 2);
+                REQUIRE(error.second == "Entry not found");
+            }
+
+            yp::BroadcastOptions first_hit;
+            first_hit.stop_on_first_hit = true;
+            first_hit.timeout_ms = 10000;
+            int32_t total = 0;
+            hits = client.broadcast<int32_t>(handles,
+                [](const yp::PhonebookHandle& h, int32_t* result, yp::AsyncRequest* req) {
+                    h.computeSum(20, 1, result, req);
+                },
+                [&total](size_t, int32_t result) { total += result; },
+                first_hit);
+            REQUIRE(hits == 1);
+            REQUIRE(total == 21);
+
+            total = 0;
+            hits = client.broadcast<int32_t>(handles,
+                [](const yp::PhonebookHandle& h, int32_t* result, yp::AsyncRequest* req) {
+                    h.computeSum(20, 1, result, req);
+                },
+                [&total](size_t, int32_t result) { total += result; });
+            REQUIRE(hits == 4);
+            REQUIRE(total == 84);
+
+            for(auto& id : ids) admin.destroyPhonebook(addr, 0, id);
+        }
+        SECTION("Lookup filter") {
+            REQUIRE_THROWS_AS(rh.enableLookupFilter(1000), yp::Exception);
+
+            auto filtered_id = admin.createPhonebook(addr, 0, phonebook_type,
+                    "{ \"name_filter\" : true }");
+            auto fh = client.makePhonebookHandle(addr, 0, filtered_id);
+            for(int i = 0; i < 2000; i++)
+                fh.insert("name" + std::to_string(i), "+1555" + std::to_string(i));
+            REQUIRE_NOTHROW(fh.enableLookupFilter(1000000));
+
+            std::string number;
+            REQUIRE_NOTHROW(fh.lookup("name42", &number));
+            REQUIRE(number == "+155542");
+            REQUIRE_THROWS_WITH(fh.lookup("nobody", &number), "Entry not found");
+            yp::AsyncRequest request;
+            REQUIRE_NOTHROW(fh.lookup("nobody", &number, &request));
+            REQUIRE(request.completed());
+            REQUIRE_THROWS_WITH(request.wait(), "Entry not found");
+            yp::LookupBuffer results;
+            REQUIRE_NOTHROW(fh.lookup("nobody", &results));
+            REQUIRE(results.size() == 1);
+            REQUIRE(!results.found(0));
+
+            // names inserted through the handle are found right away
+            REQUIRE_NOTHROW(fh.insert("newcomer", "+15550000"));
+            REQUIRE_NOTHROW(fh.lookup("newcomer", &number));
+            REQUIRE(number == "+15550000");
+
+            // names inserted elsewhere are found once the filter is refreshed
+            auto other = client.makePhonebookHandle(addr, 0, filtered_id);
+            for(int i = 2000; i < 4000; i++)
+                other.insert("name" + std::to_string(i), "+1555" + std::to_string(i));
+            REQUIRE_NOTHROW(fh.enableLookupFilter(0));
+            for(int i = 0; i < 4000; i += 100) {
+                REQUIRE_NOTHROW(fh.lookup("name" + std::to_string(i), &number));
+                REQUIRE(number == "+1555" + std::to_string(i));
+            }
+            fh.disableLookupFilter();
+            admin.destroyPhonebook(addr, 0, filtered_id);
+        }
+        SECTION("Search") {
+            auto indexed_id = admin.createPhonebook(addr, 0, phonebook_type,
+                    "{ \"trigram_index\" : true, \"num_shards\" : 4 }");
+            auto ih = client.makePhonebookHandle(addr, 0, indexed_id);
+            for(auto handle : { rh, ih }) {
+                handle.insert("John Johnson", "+15555550100");
+                handle.insert("Jane Johnston", "+15555550101");
+                handle.insert("Bob Smith", "+15555550102");
+                handle.insert("Robert Smyth", "+15555550103");
+                handle.insert("Al", "+15555550104");
+                handle.erase("Bob Smith");
+                handle.insert("Bob Smith", "+15555550105");
+
+                std::vector<std::pair<std::string, std::string>> results;
+                REQUIRE_NOTHROW(handle.search("ohns", 0, 10, &results));
+                REQUIRE(results.size() == 2);
+                REQUIRE(results[0].first == "Jane Johnston");
+                REQUIRE(results[1].first == "John Johnson");
+
+                REQUIRE_NOTHROW(handle.search("SMITH", 0, 10, &results));
+                REQUIRE(results.size() == 1);
+                REQUIRE(results[0].second == "+15555550105");
+
+                REQUIRE_NOTHROW(handle.search("smith", 1, 10, &results));
+                REQUIRE(results.size() == 2);
+                REQUIRE(results[0].first == "Bob Smith");
+                REQUIRE(results[1].first == "Robert Smyth");
+
+                REQUIRE_NOTHROW(handle.search("johnson", 1, 1, &results));
+                REQUIRE(results.size() == 1);
+                REQUIRE(results[0].first == "John Johnson");
+
+                handle.erase("John Johnson");
+                yp::AsyncRequest request;
+                REQUIRE_NOTHROW(handle.search("ohns", 0, 10, &results, &request));
+                REQUIRE_NOTHROW(request.wait());
+                REQUIRE(results.size() == 1);
+
+                REQUIRE_NOTHROW(handle.search("l", 0, 0, &results));
+                REQUIRE(results.size() == 1);
+                REQUIRE(results[0].first == "Al");
+            }
+            auto stats = nlohmann::json::parse(ih.getStats());
+            REQUIRE(stats["trigram_index_bytes"].get<size_t>() > 0);
+            admin.destroyPhonebook(addr, 0, indexed_id);
+        }
+        SECTION("Reverse lookup") {
+            auto indexed_id = admin.createPhonebook(addr, 0, phonebook_type,
+                    "{ \"reverse_index\" : true, \"num_shards\" : 4 }");
+            auto ih = client.makePhonebookHandle(addr, 0, indexed_id);
+            for(auto handle : { rh, ih }) {
+                handle.insert("Alice", "+15555550100");
+                handle.insert("Bob", "+15555550101");
+                handle.insert("Carol", "+15555550101");
+                handle.insert("Dave", "+15555550102");
+                handle.insert("Dave", "+15555550103");
+
+                std::vector<std::string> names;
+                REQUIRE_NOTHROW(handle.reverseLookup("+15555550101", &names));
+                REQUIRE(names == std::vector<std::string>{ "Bob", "Carol" });
+                REQUIRE_THROWS_AS(handle.reverseLookup("+15555550102", &names), yp::Exception);
+                REQUIRE_NOTHROW(handle.reverseLookup("+15555550103", &names));
+                REQUIRE(names == std::vector<std::string>{ "Dave" });
+
+                handle.erase("Bob");
+                yp::AsyncRequest request;
+                REQUIRE_NOTHROW(handle.reverseLookup("+15555550101", &names, &request));
+                REQUIRE_NOTHROW(request.wait());
+                REQUIRE(names == std::vector<std::string>{ "Carol" });
+
+                std::vector<std::vector<std::string>> multi;
+                REQUIRE_NOTHROW(handle.reverseLookupMulti(
+                    { "+15555550100", "+15555550199", "+15555550101", "+15555550100" }, &multi));
+                REQUIRE(multi.size() == 4);
+                REQUIRE(multi[0] == std::vector<std::string>{ "Alice" });
+                REQUIRE(multi[1].empty());
+                REQUIRE(multi[2] == std::vector<std::string>{ "Carol" });
+                REQUIRE(multi[3] == std::vector<std::string>{ "Alice" });
+            }
+            auto stats = nlohmann::json::parse(ih.getStats());
+            REQUIRE(stats["reverse_index_bytes"].get<size_t>() > 0);
+            admin.destroyPhonebook(addr, 0, indexed_id);
+        }
+        SECTION("Scan") {
+            using Q = yp::ScanQuery;
+            rh.insert("Alice", "+13125550100");
+            rh.insert("Albert", "+13125550101");
+            rh.insert("Bob", "+17735550102");
+            rh.insert("Carol", "+16305550103");
+            rh.insert("Carl", "+16305550103");
+
+            yp::ScanResult result;
+            REQUIRE_NOTHROW(rh.scan(Q().where(Q::Field::Name, Q::Op::Prefix, "Al").count(), &result));
+            REQUIRE(result.count == 2);
+            REQUIRE(result.entries.empty());
+
+            REQUIRE_NOTHROW(rh.scan(Q().groupByCount(Q::Field::Number, 2, 3), &result));
+            REQUIRE(result.count == 5);
+            using Groups = std::vector<std::pair<std::string, uint64_t>>;
+            REQUIRE(result.groups == Groups{ { "312", 2 }, { "630", 2 }, { "773", 1 } });
+
+            REQUIRE_NOTHROW(rh.scan(Q().where(Q::Field::Name, Q::Op::Regex, "^Car")
+                                       .countDistinct(Q::Field::Number), &result));
+            REQUIRE(result.count == 2);
+            REQUIRE(result.distinct == 1);
+
+            yp::AsyncRequest request;
+            REQUIRE_NOTHROW(rh.scan(Q().where(Q::Field::Number, Q::Op::GreaterEqual, "+16")
+                                       .where(Q::Field::Name, Q::Op::NotEqual, "Carl")
+                                       .entries(1), &result, &request));
+            REQUIRE_NOTHROW(request.wait());
+            REQUIRE(result.count == 2);
+            REQUIRE(result.entries.size() == 1);
+            REQUIRE(result.entries[0].first == "Bob");
+
+            REQUIRE_THROWS_AS(rh.scan(Q().where(Q::Field::Name, Q::Op::Regex, "(").count(), &result),
+                              yp::Exception);
+            REQUIRE_THROWS_AS(rh.scan(Q().where(Q::Field::Name, Q::Op::Regex, "((a?){100}){100}").count(), &result),
+                              yp::Exception);
+            REQUIRE_THROWS_AS(rh.scan(Q().where(Q::Field::Name, Q::Op::Regex, std::string(1000, 'a')).count(), &result),
+                              yp::Exception);
+        }
+        SECTION("Snapshot and restore") {
+            const std::string path = "yp-phonebook-test.snapshot";
+            for(int i = 0; i < 1000; i++)
+                rh.insert("name" + std::to_string(i), "+1555" + std::to_string(i));
+            REQUIRE_NOTHROW(admin.snapshotPhonebook(addr, 0, phonebook_id, path));
+
+            rh.erase("name42");
+            rh.insert("someone else", "+15555550000");
+            REQUIRE_NOTHROW(admin.restorePhonebook(addr, 0, phonebook_id, path));
+
+            std::string number;
+            REQUIRE_NOTHROW(rh.lookup("name42", &number));
+            REQUIRE(number == "+155542");
+            REQUIRE_NOTHROW(rh.lookup("name999", &number));
+            REQUIRE(number == "+1555999");
+            REQUIRE_THROWS_AS(rh.lookup("someone else", &number), yp::Exception);
+
+            REQUIRE_THROWS_AS(admin.restorePhonebook(addr, 0, phonebook_id, "does-not-exist"),
+                              yp::Exception);
+            REQUIRE_NOTHROW(rh.lookup("name42", &number));
+            std::remove(path.c_str());
+        }
+        SECTION("Incremental checkpoints") {
+            const std::string directory = "yp-phonebook-test.checkpoint";
+            for(int i = 0; i < 1000; i++)
+                rh.insert("name" + std::to_string(i), "+1555" + std::to_string(i));
+            REQUIRE_NOTHROW(admin.checkpointPhonebook(addr, 0, phonebook_id, directory));
+            rh.erase("name42");
+            rh.insert("name7", "+15550000");
+            REQUIRE_NOTHROW(admin.checkpointPhonebook(addr, 0, phonebook_id, directory));
+            rh.insert("someone else", "+15555550000");
+            REQUIRE_NOTHROW(admin.restorePhonebook(addr, 0, phonebook_id, directory));
+
+            std::string number;
+            REQUIRE_THROWS_AS(rh.lookup("name42", &number), yp::Exception);
+            REQUIRE_THROWS_AS(rh.lookup("someone else", &number), yp::Exception);
+            REQUIRE_NOTHROW(rh.lookup("name7", &number));
+            REQUIRE(number == "+15550000");
+            REQUIRE_NOTHROW(rh.lookup("name999", &number));
+            REQUIRE(number == "+1555999");
+            std::system(("rm -rf " + directory).c_str());
+        }
+        SECTION("Checkpoints into several directories") {
+            const std::string first  = "yp-phonebook-test.checkpoint1";
+            const std::string second = "yp-phonebook-test.checkpoint2";
+            rh.insert("alice", "+15550001");
+            REQUIRE_NOTHROW(admin.checkpointPhonebook(addr, 0, phonebook_id, first));
+            rh.insert("bob", "+15550002");
+            REQUIRE_NOTHROW(admin.checkpointPhonebook(addr, 0, phonebook_id, second));
+            rh.insert("carol", "+15550003");
+            REQUIRE_NOTHROW(admin.checkpointPhonebook(addr, 0, phonebook_id, first));
+            rh.erase("alice");
+            REQUIRE_NOTHROW(admin.restorePhonebook(addr, 0, phonebook_id, first));
+
+            std::string number;
+            REQUIRE_NOTHROW(rh.lookup("alice", &number));
+            REQUIRE_NOTHROW(rh.lookup("bob", &number));
+            REQUIRE(number == "+15550002");
+            REQUIRE_NOTHROW(rh.lookup("carol", &number));
+            std::system(("rm -rf " + first + " " + second).c_str());
+        }
+        SECTION("Compact storage and stats") {
+            auto compact_id = admin.createPhonebook(addr, 0, phonebook_type,
+                    "{ \"storage\" : \"compact\", \"num_shards\" : 4 }");
+            auto ch = client.makePhonebookHandle(addr, 0, compact_id);
+            for(int i = 0; i < 1000; i++)
+                ch.insert("Smith, John " + std::to_string(i), "+1555" + std::to_string(i));
+            REQUIRE_NOTHROW(ch.insert("Rob", "not a number"));
+            REQUIRE_NOTHROW(ch.insert("Matthieu", "+0015555550101"));
+            REQUIRE_NOTHROW(ch.erase("Smith, John 42"));
+
+            std::string number;
+            REQUIRE_NOTHROW(ch.lookup("Smith, John 7", &number));
+            REQUIRE(number == "+15557");
+            REQUIRE_NOTHROW(ch.lookup("Rob", &number));
+            REQUIRE(number == "not a number");
+            REQUIRE_NOTHROW(ch.lookup("Matthieu", &number));
+            REQUIRE(number == "+0015555550101");
+            REQUIRE_THROWS_AS(ch.lookup("Smith, John 42", &number), yp::Exception);
+
+            auto stats = nlohmann::json::parse(ch.getStats());
+            REQUIRE(stats["storage"] == "compact");
+            REQUIRE(stats["num_entries"] == 1001);
+            REQUIRE(stats["packed_numbers"] == 1000);
+            REQUIRE(stats["bytes_per_entry"].get<double>() > 0.0);
+            REQUIRE(stats["fragmentation"].get<double>() >= 0.0);
+            REQUIRE(stats["fragmentation"].get<double>() <= 1.0);
+
+            for(int i = 0; i < 1000; i += 2)
+                if(i != 42) ch.erase("Smith, John " + std::to_string(i));
+            REQUIRE_NOTHROW(ch.lookup("Smith, John 999", &number));
+            REQUIRE(number == "+1555999");
+            stats = nlohmann::json::parse(ch.getStats());
+            REQUIRE(stats["num_entries"] == 502);
+            REQUIRE(nlohmann::json::parse(rh.getStats())["storage"] == "map");
+            admin.destroyPhonebook(addr, 0, compact_id);
+        }
+        SECTION("Tiered backend") {
+            auto tiered_id = admin.createPhonebook(addr, 0, "tiered",
+                    "{ \"path\" : \"tiered-test\", \"hot_bytes\" : 16384 }");
+            auto th = client.makePhonebookHandle(addr, 0, tiered_id);
+            for(int i = 0; i < 1000; i++)
+                th.insert("name" + std::to_string(i), "+1555" + std::to_string(i));
+            for(int i = 0; i < 1000; i += 3)
+                th.erase("name" + std::to_string(i));
+            std::string number;
+            for(int i = 0; i < 1000; i++) {
+                if(i % 3) {
+                    REQUIRE_NOTHROW(th.lookup("name" + std::to_string(i), &number));
+                    REQUIRE(number == "+1555" + std::to_string(i));
+                } else {
+                    REQUIRE_THROWS_WITH(th.lookup("name" + std::to_string(i), &number),
+                                        "Entry not found");
+                }
+            }
+            // the hot tier now holds the most recently looked up names
+            REQUIRE_NOTHROW(th.lookup("name998", &number));
+            auto stats = nlohmann::json::parse(th.getStats());
+            REQUIRE(stats["hot_bytes"].get<size_t>() <= 16384);
+            REQUIRE(stats["cold_runs"].get<size_t>() > 0);
+            REQUIRE(stats["cold_hits"].get<size_t>() > 0);
+            REQUIRE(stats["hot_hits"].get<size_t>() > 0);
+            REQUIRE(stats["cold_hit_rate"].get<double>() > 0.0);
+            // names of a group read once from the cold tier come from the block cache
+            auto& cache = stats["block_cache"];
+            REQUIRE(cache["hits"].get<uint64_t>() > 0);
+            REQUIRE(cache["hit_rate"].get<double>() > 0.0);
+            REQUIRE(cache["bytes"].get<size_t>() > 0);
+            REQUIRE(cache["bytes"].get<size_t>() <= cache["provider_bytes"].get<size_t>());
+            REQUIRE(cache["provider_bytes"].get<size_t>() <= cache["capacity"].get<size_t>());
+            admin.destroyPhonebook(addr, 0, tiered_id);
+        }
+        SECTION("Memory quotas") {
+            yp::Provider limited(engine, 2,
+                    "{ \"quotas\" : { \"provider_bytes\" : 65536, \"phonebook_bytes\" : 16384,"
+                    "                 \"refresh_interval_ms\" : 0 } }");
+            auto small_id = admin.createPhonebook(addr, 2, phonebook_type, "{ \"num_shards\" : 4 }");
+            auto sh = client.makePhonebookHandle(addr, 2, small_id);
+            int inserted = 0;
+            for(; inserted < 10000; inserted++) {
+                try {
+                    sh.insert("name" + std::to_string(inserted), "+1555" + std::to_string(inserted));
+                } catch(const yp::Exception& ex) {
+                    REQUIRE(std::string(ex.what()) == "Memory quota exceeded");
+                    break;
+                }
+            }
+            REQUIRE(inserted > 0);
+            REQUIRE(inserted < 10000);
+            auto stats = nlohmann::json::parse(sh.getStats());
+            REQUIRE(stats["memory"]["quota_bytes"] == 16384);
+            REQUIRE(stats["memory"]["resident_bytes"].get<size_t>() >= 16384);
+            // reads and erases are still served, and free room for new writes
+            std::string number;
+            REQUIRE_NOTHROW(sh.lookup("name0", &number));
+            REQUIRE(number == "+15550");
+            for(int i = 0; i < inserted; i++)
+                REQUIRE_NOTHROW(sh.erase("name" + std::to_string(i)));
+            REQUIRE_NOTHROW(sh.insert("Matthieu", "+15555550101"));
+            // a larger per-phonebook quota fills up the provider's quota
+            auto big_id = admin.createPhonebook(addr, 2, phonebook_type,
+                    "{ \"num_shards\" : 4, \"quota_bytes\" : 1048576 }");
+            auto bh = client.makePhonebookHandle(addr, 2, big_id);
+            REQUIRE_THROWS_WITH(
+                [&]() { for(int i = 0; i < 100000; i++)
+                            bh.insert("name" + std::to_string(i), "+1555" + std::to_string(i)); }(),
+                "Memory quota exceeded");
+            REQUIRE_THROWS_WITH(admin.createPhonebook(addr, 2, phonebook_type, "{}"),
+                                "Memory quota exceeded");
+            admin.destroyPhonebook(addr, 2, big_id);
+            REQUIRE_NOTHROW(admin.destroyPhonebook(addr, 2,
+                    admin.createPhonebook(addr, 2, phonebook_type, "{}")));
+            admin.destroyPhonebook(addr, 2, small_id);
+        }
+        SECTION("Lazy phonebooks") {
+            auto lazy_id = yp::UUID::generate();
+            nlohmann::json config;
+            config["phonebooks"] = {
+                { { "__id__", lazy_id.to_string() }, { "type", "dummy" }, { "lazy", true } },
+                { { "type", "dummy" } },
+                { { "type", "dummy" } }
+            };
+            yp::Provider loaded(engine, 3, config.dump());
+            auto phonebooks = nlohmann::json::parse(loaded.getConfig())["phonebooks"];
+            REQUIRE(phonebooks.size() == 3);
+            size_t lazy = 0;
+            for(auto& phonebook : phonebooks) {
+                if(!phonebook.value("lazy", false)) continue;
+                REQUIRE(phonebook["__id__"] == lazy_id.to_string());
+                lazy += 1;
+            }
+            REQUIRE(lazy == 1);
+            // the first request loads the phonebook
+            auto lh = client.makePhonebookHandle(addr, 3, lazy_id);
+            REQUIRE_NOTHROW(lh.insert("Matthieu", "+15555550101"));
+            std::string number;
+            REQUIRE_NOTHROW(lh.lookup("Matthieu", &number));
+            REQUIRE(number == "+15555550101");
+            for(auto& phonebook : nlohmann::json::parse(loaded.getConfig())["phonebooks"])
+                REQUIRE(!phonebook.value("lazy", false));
+            REQUIRE_THROWS_WITH(client.makePhonebookHandle(addr, 3, yp::UUID::generate()),
+                                "Phonebook not found");
+            // an invalid lazy phonebook is registered all the same, and
+            // the error only surfaces when a request tries to load it
+            auto broken_id = yp::UUID::generate();
+            config["phonebooks"] = {
+                { { "__id__", lazy_id.to_string() }, { "type", "blabla" }, { "lazy", true } },
+                { { "__id__", broken_id.to_string() }, { "type", "blabla" }, { "lazy", true } }
+            };
+            yp::Provider broken(engine, 4, config.dump());
+            REQUIRE_THROWS_WITH(client.makePhonebookHandle(addr, 4, lazy_id),
+                                "Unknown phonebook type blabla");
+            REQUIRE_NOTHROW(admin.closePhonebook(addr, 4, lazy_id));
+            REQUIRE_THROWS_WITH(client.makePhonebookHandle(addr, 4, lazy_id),
+                                "Phonebook not found");
+            // destroying it reports the load error, and forgets it
+            REQUIRE_THROWS_WITH(admin.destroyPhonebook(addr, 4, broken_id),
+                                "Phonebook was removed from the provider but its data "
+                                "could not be destroyed: Unknown phonebook type blabla");
+            REQUIRE_THROWS_WITH(client.makePhonebookHandle(addr, 4, broken_id),
+                                "Phonebook not found");
+        }
+        SECTION("Idle eviction") {
+            auto evicting = std::make_unique<yp::Provider>(engine, 5,
+                    "{ \"eviction\" : { \"idle_ttl_ms\" : 50, \"check_interval_ms\" : 10,"
+                    "                   \"directory\" : \".\" } }");
+            auto idle_id = admin.createPhonebook(addr, 5, phonebook_type, "{}");
+            auto ih = client.makePhonebookHandle(addr, 5, idle_id);
+            for(int i = 0; i < 100; i++)
+                REQUIRE_NOTHROW(ih.insert("name" + std::to_string(i), "+1555" + std::to_string(i)));
+            thallium::thread::sleep(engine, 500);
+            auto load = nlohmann::json::parse(evicting->getLoad());
+            REQUIRE(load["evictions"].get<uint64_t>() >= 1);
+            auto phonebooks = nlohmann::json::parse(evicting->getConfig())["phonebooks"];
+            REQUIRE(phonebooks.size() == 1);
+            REQUIRE(phonebooks[0]["__id__"] == idle_id.to_string());
+            REQUIRE(phonebooks[0]["lazy"] == true);
+            // the next request reopens the phonebook through the same handle
+            std::string number;
+            for(int i = 0; i < 100; i++) {
+                REQUIRE_NOTHROW(ih.lookup("name" + std::to_string(i), &number));
+                REQUIRE(number == "+1555" + std::to_string(i));
+            }
+            load = nlohmann::json::parse(evicting->getLoad());
+            REQUIRE(load["loads"].get<uint64_t>() >= 1);
+            // one-way writes, which do not resolve stale handles, reopen it too
+            thallium::thread::sleep(engine, 500);
+            REQUIRE_NOTHROW(ih.insertNoAck("Matthieu", "+15555550101"));
+            std::vector<std::string> errors;
+            REQUIRE_NOTHROW(ih.flush(&errors));
+            REQUIRE(errors.empty());
+            REQUIRE_NOTHROW(ih.lookup("Matthieu", &number));
+            REQUIRE(number == "+15555550101");
+            // the snapshot outlives the provider, and a provider created
+            // with its configuration restores the phonebook from it
+            thallium::thread::sleep(engine, 500);
+            auto config = nlohmann::json::parse(evicting->getConfig());
+            REQUIRE(config["phonebooks"][0].contains("snapshot"));
+            config.erase("eviction");
+            evicting.reset();
+            yp::Provider restarted(engine, 5, config.dump());
+            REQUIRE_NOTHROW(ih.lookup("Matthieu", &number));
+            REQUIRE(number == "+15555550101");
+            admin.destroyPhonebook(addr, 5, idle_id);
+        }
+        SECTION("Long names and numbers") {
+            // past the small string optimization, and past the eager
+            // buffer of the request for the longest ones
+            std::vector<std::string> names;
+            for(size_t length : { 16, 64, 4096, 1 << 16 })
+                names.push_back(std::string(length, 'a') + std::to_string(length));
+            auto roundTrip = [&]() {
+                std::string number;
+                for(auto& name : names) {
+                    REQUIRE_NOTHROW(rh.insert(name, "+1555" + name));
+                    REQUIRE_NOTHROW(rh.lookup(name, &number));
+                    REQUIRE(number == "+1555" + name);
+                }
+                yp::LookupBuffer results;
+                REQUIRE_NOTHROW(rh.lookupMulti(names, &results));
+                for(size_t i = 0; i < names.size(); i++)
+                    REQUIRE(results.value(i) == "+1555" + names[i]);
+                for(auto& name : names) {
+                    REQUIRE_NOTHROW(rh.erase(name));
+                    REQUIRE_THROWS_WITH(rh.lookup(name, &number), "Entry not found");
+                }
+            };
+            roundTrip();
+            // handlers spawned in another pool get copies of the arguments
+            auto pool    = thallium::pool::create(thallium::pool::access::mpmc);
+            auto xstream = thallium::xstream::create(thallium::scheduler::predef::basic_wait, *pool);
+            provider.setPool(*pool);
+            roundTrip();
+            provider.setPool(thallium::pool());
+            xstream->join();
+        }
+        SECTION("Move to another pool") {
+            auto pool    = thallium::pool::create(thallium::pool::access::mpmc);
+            auto xstream = thallium::xstream::create(thallium::scheduler::predef::basic_wait, *pool);
+            provider.setPool(*pool);
+            std::string number;
+            REQUIRE_NOTHROW(rh.insert("Matthieu", "+15555550101"));
+            REQUIRE_NOTHROW(rh.lookup("Matthieu", &number));
+            REQUIRE(number == "+15555550101");
+            // arguments decoded in place must outlive the original handler
+            yp::LookupBuffer results;
+            REQUIRE_NOTHROW(rh.lookupMulti({ "Matthieu", "Rob" }, &results));
+            REQUIRE(results.value(0) == "+15555550101");
+            REQUIRE(!results.found(1));
+            auto load = nlohmann::json::parse(provider.getLoad());
+            REQUIRE(load["moved"] == true);
+            REQUIRE(load["rpcs_forwarded"].get<uint64_t>() >= 3);
+            REQUIRE(load["rpcs_handled"].get<uint64_t>() >= 3);
+            REQUIRE(load["busy_seconds"].get<double>() > 0.0);
+            provider.setPool(thallium::pool());
+            REQUIRE_NOTHROW(rh.erase("Matthieu"));
+            load = nlohmann::json::parse(provider.getLoad());
+            REQUIRE(load["moved"] == false);
+            xstream->join();
+        }
 
         auto bad_id = yp::UUID::generate();
         REQUIRE_THROWS_AS(client.makePhonebookHandle(addr, 0, bad_id),
@@ -0,0 +1,54 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "SumKernels.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+TEST_CASE("Sum kernels", "[sum]") {
+
+    auto kernels = yp::sumInt32Kernels();
+    REQUIRE(!kernels.empty());
+    REQUIRE(std::string(kernels[0].name) == "scalar");
+
+    // sizes around the 64-element blocks and the vector widths
+    for(size_t n : { 1, 7, 8, 15, 16, 63, 64, 65, 127, 128, 1000, 4096 + 17 }) {
+        std::vector<int32_t> x(n), y(n);
+        std::mt19937 rng(static_cast<unsigned>(n));
+        std::uniform_int_distribution<int32_t> any(std::numeric_limits<int32_t>::min(),
+                                                   std::numeric_limits<int32_t>::max());
+        for(size_t i = 0; i < n; i++) {
+            // mix small values with values that overflow both ways
+            x[i] = i % 3 == 0 ? static_cast<int32_t>(i) : any(rng);
+            y[i] = i % 3 == 0 ? -static_cast<int32_t>(i / 2) : any(rng);
+        }
+        if(n > 5) {
+            x[5] = std::numeric_limits<int32_t>::max(); y[5] = 1;
+        }
+        std::vector<int32_t> expected(n);
+        std::vector<uint64_t> expected_overflow((n + 63) / 64, ~uint64_t(0));
+        kernels[0].fn(x.data(), y.data(), expected.data(), expected_overflow.data(), n);
+        for(size_t i = 0; i < n; i++) {
+            int64_t sum = int64_t(x[i]) + int64_t(y[i]);
+            bool overflowed = sum > std::numeric_limits<int32_t>::max()
+                           || sum < std::numeric_limits<int32_t>::min();
+            REQUIRE(bool((expected_overflow[i / 64] >> (i % 64)) & 1) == overflowed);
+            REQUIRE(expected[i] == static_cast<int32_t>(static_cast<uint32_t>(x[i]) + static_cast<uint32_t>(y[i])));
+        }
+        for(auto& kernel : kernels) {
+            DYNAMIC_SECTION(kernel.name << " kernel, n = " << n) {
+                std::vector<int32_t> out(n);
+                std::vector<uint64_t> overflow((n + 63) / 64, ~uint64_t(0));
+                kernel.fn(x.data(), y.data(), out.data(), overflow.data(), n);
+                REQUIRE(out == expected);
+                REQUIRE(overflow == expected_overflow);
+            }
+        }
+    }
+}